@@ -266,9 +266,9 @@ void Application::ToggleChatState() {
 
     if (device_state_ == kDeviceStateIdle) {
         Schedule([this]() {
-            if (!protocol_->IsAudioChannelOpened()) {
+            if (!channel_warmer_.Claim()) {
                 SetDeviceState(kDeviceStateConnecting);
-                if (!protocol_->OpenAudioChannel()) {
+                if (!channel_warmer_.Open()) {
                     return;
                 }
             }
@@ -278,7 +278,7 @@ void Application::ToggleChatState() {
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
             AbortSpeaking(kAbortReasonNone);
-        });
+        }, kMainTaskPriorityHigh);
     } else if (device_state_ == kDeviceStateListening) {
         Schedule([this]() {
             protocol_->CloseAudioChannel();
@@ -303,9 +303,9 @@ void Application::StartListening() {
     
     if (device_state_ == kDeviceStateIdle) {
         Schedule([this]() {
-            if (!protocol_->IsAudioChannelOpened()) {
+            if (!channel_warmer_.Claim()) {
                 SetDeviceState(kDeviceStateConnecting);
-                if (!protocol_->OpenAudioChannel()) {
+                if (!channel_warmer_.Open()) {
                     return;
                 }
             }
@@ -316,7 +316,7 @@ void Application::StartListening() {
         Schedule([this]() {
             AbortSpeaking(kAbortReasonNone);
             SetListeningMode(kListeningModeManualStop);
-        });
+        }, kMainTaskPriorityHigh);
     }
 }
 
@@ -359,6 +359,11 @@ void Application::Start() {
     auto codec = board.GetAudioCodec();
     audio_service_.Initialize(codec);
     audio_service_.Start();
+    // The wake-up and notification sounds are the shortest, keep them decoded
+    audio_service_.PreloadSound(Lang::Sounds::OGG_POPUP, true);
+    audio_service_.PreloadSound(Lang::Sounds::OGG_VIBRATION, true);
+    audio_service_.PreloadSound(Lang::Sounds::OGG_SUCCESS, false);
+    audio_service_.PreloadSound(Lang::Sounds::OGG_EXCLAMATION, false);
 
     AudioServiceCallbacks callbacks;
     callbacks.on_send_queue_available = [this]() {
@@ -370,6 +375,15 @@ void Application::Start() {
     callbacks.on_vad_change = [this](bool speaking) {
         xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
     };
+#if CONFIG_AUDIO_CHANNEL_PRECONNECT
+    callbacks.on_speech_onset = [this]() {
+        Schedule([this]() {
+            if (device_state_ == kDeviceStateIdle) {
+                channel_warmer_.Warm("speech onset");
+            }
+        });
+    };
+#endif
     audio_service_.SetCallbacks(callbacks);
 
     // Start the main event loop task with priority 3
@@ -416,19 +430,36 @@ void Application::Start() {
     });
 
     protocol_->OnNetworkError([this](const std::string& message) {
+        if (channel_warmer_.InWarmTask()) {
+            // Nobody is waiting for this connect yet, the conversation will retry on its own
+            ESP_LOGW(TAG, "Warm-up failed: %s", message.c_str());
+            return;
+        }
         last_error_message_ = message;
         xEventGroupSetBits(event_group_, MAIN_EVENT_ERROR);
     });
-    protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
+    protocol_->OnIncomingAudio([this](AudioStreamPacketPtr packet) {
         if (device_state_ == kDeviceStateSpeaking) {
             audio_service_.PushPacketToDecodeQueue(std::move(packet));
         }
     });
     protocol_->OnAudioChannelOpened([this, codec, &board]() {
-        board.SetPowerSaveMode(false);
-        if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
-            ESP_LOGW(TAG, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
-                protocol_->server_sample_rate(), codec->output_sample_rate());
+        auto on_opened = [this, codec, &board]() {
+            // A warm channel may already be closed again when this runs
+            if (!protocol_->IsAudioChannelOpened()) {
+                return;
+            }
+            board.SetPowerSaveMode(false);
+            if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
+                ESP_LOGW(TAG, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
+                    protocol_->server_sample_rate(), codec->output_sample_rate());
+            }
+        };
+        // The warm-up task opens the channel off the main loop
+        if (xTaskGetCurrentTaskHandle() == main_event_loop_task_handle_) {
+            on_opened();
+        } else {
+            Schedule(on_opened, kMainTaskPriorityHigh);
         }
     });
     protocol_->OnAudioChannelClosed([this, &board]() {
@@ -439,52 +470,25 @@ void Application::Start() {
             SetDeviceState(kDeviceStateIdle);
         });
     });
+    protocol_->OnIncomingControl([this](const ControlMessage& message) {
+        HandleControlMessage(message);
+    });
     protocol_->OnIncomingJson([this, display](const cJSON* root) {
         // Parse JSON data
         auto type = cJSON_GetObjectItem(root, "type");
-        if (strcmp(type->valuestring, "tts") == 0) {
-            auto state = cJSON_GetObjectItem(root, "state");
-            if (strcmp(state->valuestring, "start") == 0) {
-                Schedule([this]() {
-                    aborted_ = false;
-                    if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
-                        SetDeviceState(kDeviceStateSpeaking);
-                    }
-                });
-            } else if (strcmp(state->valuestring, "stop") == 0) {
-                Schedule([this]() {
-                    if (device_state_ == kDeviceStateSpeaking) {
-                        if (listening_mode_ == kListeningModeManualStop) {
-                            SetDeviceState(kDeviceStateIdle);
-                        } else {
-                            SetDeviceState(kDeviceStateListening);
-                        }
-                    }
-                });
-            } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-                auto text = cJSON_GetObjectItem(root, "text");
-                if (cJSON_IsString(text)) {
-                    ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([this, display, message = std::string(text->valuestring)]() {
-                        display->SetChatMessage("assistant", message.c_str());
-                    });
-                }
-            }
-        } else if (strcmp(type->valuestring, "stt") == 0) {
-            auto text = cJSON_GetObjectItem(root, "text");
-            if (cJSON_IsString(text)) {
-                ESP_LOGI(TAG, ">> %s", text->valuestring);
-                Schedule([this, display, message = std::string(text->valuestring)]() {
-                    display->SetChatMessage("user", message.c_str());
-                });
-            }
-        } else if (strcmp(type->valuestring, "llm") == 0) {
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(emotion)) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
-                    display->SetEmotion(emotion_str.c_str());
-                });
-            }
+        if (strcmp(type->valuestring, "tts") == 0 || strcmp(type->valuestring, "stt") == 0 ||
+            strcmp(type->valuestring, "llm") == 0) {
+            // Messages the protocol could not scan itself, e.g. with extra nested fields
+            auto field = [root](const char* name) {
+                auto item = cJSON_GetObjectItem(root, name);
+                return cJSON_IsString(item) ? std::string_view(item->valuestring) : std::string_view();
+            };
+            ControlMessage message;
+            message.type = type->valuestring;
+            message.state = field("state");
+            message.text = field("text");
+            message.emotion = field("emotion");
+            HandleControlMessage(message);
         } else if (strcmp(type->valuestring, "mcp") == 0) {
             auto payload = cJSON_GetObjectItem(root, "payload");
             if (cJSON_IsObject(payload)) {
@@ -529,6 +533,18 @@ void Application::Start() {
         }
     });
     bool protocol_started = protocol_->Start();
+    channel_warmer_.OnDone([this]() {
+        // Runs what the main loop held back, then the audio that queued up meanwhile
+        Schedule([this]() {
+            while (!after_warm_up_tasks_.empty() && !channel_warmer_.speculating()) {
+                auto task = std::move(after_warm_up_tasks_.front());
+                after_warm_up_tasks_.pop_front();
+                task();
+            }
+        }, kMainTaskPriorityHigh);
+        xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
+    });
+    channel_warmer_.SetProtocol(protocol_.get());
 
     SystemInfo::PrintHeapStats();
     SetDeviceState(kDeviceStateIdle);
@@ -543,15 +559,89 @@ void Application::Start() {
     }
 }
 
-// Add a async task to MainLoop
-void Application::Schedule(std::function<void()> callback) {
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        main_tasks_.push_back(std::move(callback));
+void Application::HandleControlMessage(const ControlMessage& message) {
+    auto display = Board::GetInstance().GetDisplay();
+    if (message.type == "tts") {
+        if (message.state == "start") {
+            // Incoming audio is dropped until the state changes, so this must not wait
+            tts_starts_.fetch_add(1, std::memory_order_relaxed);
+            Schedule([this]() {
+                aborted_ = false;
+                if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
+                    SetDeviceState(kDeviceStateSpeaking);
+                }
+            }, kMainTaskPriorityHigh);
+        } else if (message.state == "stop") {
+            // Normal like the text and emotion updates, so it stays behind the text sent before it.
+            // The next "tts start" may pass it, then it belongs to a reply that is already over.
+            Schedule([this, starts = tts_starts_.load(std::memory_order_relaxed)]() {
+                if (starts == tts_starts_.load(std::memory_order_relaxed) && device_state_ == kDeviceStateSpeaking) {
+                    if (listening_mode_ == kListeningModeManualStop) {
+                        SetDeviceState(kDeviceStateIdle);
+                    } else {
+                        SetDeviceState(kDeviceStateListening);
+                    }
+                }
+            });
+        } else if (message.state == "sentence_start") {
+            if (!message.text.empty()) {
+                std::string text(message.text);
+                ESP_LOGI(TAG, "<< %s", text.c_str());
+                Schedule([this, display, message = std::move(text)]() {
+                    display->SetChatMessage("assistant", message.c_str());
+                });
+            }
+        }
+    } else if (message.type == "stt") {
+        if (!message.text.empty()) {
+            std::string text(message.text);
+            ESP_LOGI(TAG, ">> %s", text.c_str());
+            Schedule([this, display, message = std::move(text)]() {
+                display->SetChatMessage("user", message.c_str());
+            });
+        }
+    } else if (message.type == "llm") {
+        if (!message.emotion.empty()) {
+            Schedule([this, display, emotion_str = std::string(message.emotion)]() {
+                display->SetEmotion(emotion_str.c_str());
+            });
+        }
     }
+}
+
+// Add a async task to MainLoop
+void Application::ScheduleTask(MainTask&& task, MainTaskPriority priority) {
+    main_tasks_.Push(std::move(task), priority);
     xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
 }
 
+// Runs the task now, or once the warm-up task no longer owns the protocol's connection.
+// Main loop only.
+void Application::RunAfterWarmUp(MainTask&& task) {
+    if (channel_warmer_.speculating() || !after_warm_up_tasks_.empty()) {
+        after_warm_up_tasks_.push_back(std::move(task));
+        return;
+    }
+    task();
+}
+
+void Application::SendQueuedAudio() {
+    // Sent when the warm-up is done, see OnDone()
+    if (channel_warmer_.speculating()) {
+        return;
+    }
+    while (auto packet = audio_service_.PopPacketFromSendQueue()) {
+        if (!protocol_) {
+            continue;
+        }
+        auto trace = packet->trace;
+        if (!protocol_->SendAudio(std::move(packet))) {
+            break;
+        }
+        audio_service_.GetLatencyTracer().RecordUplink(trace, esp_timer_get_time());
+    }
+}
+
 // The Main Event Loop controls the chat state and websocket connection
 // If other tasks need to access the websocket or chat state,
 // they should use Schedule to call this function
@@ -570,11 +660,7 @@ void Application::MainEventLoop() {
         }
 
         if (bits & MAIN_EVENT_SEND_AUDIO) {
-            while (auto packet = audio_service_.PopPacketFromSendQueue()) {
-                if (protocol_ && !protocol_->SendAudio(std::move(packet))) {
-                    break;
-                }
-            }
+            SendQueuedAudio();
         }
 
         if (bits & MAIN_EVENT_WAKE_WORD_DETECTED) {
@@ -589,11 +675,17 @@ void Application::MainEventLoop() {
         }
 
         if (bits & MAIN_EVENT_SCHEDULE) {
-            std::unique_lock<std::mutex> lock(mutex_);
-            auto tasks = std::move(main_tasks_);
-            lock.unlock();
-            for (auto& task : tasks) {
+            // Only run what is queued now, tasks scheduled meanwhile set the event again
+            for (size_t pending = main_tasks_.Size(); pending > 0; pending--) {
+                MainTask task;
+                if (!main_tasks_.Pop(task)) {
+                    break;
+                }
                 task();
+                // Do not let a run of UI updates hold back the uplink
+                if (xEventGroupClearBits(event_group_, MAIN_EVENT_SEND_AUDIO) & MAIN_EVENT_SEND_AUDIO) {
+                    SendQueuedAudio();
+                }
             }
         }
 
@@ -601,12 +693,19 @@ void Application::MainEventLoop() {
             clock_ticks_++;
             auto display = Board::GetInstance().GetDisplay();
             display->UpdateStatusBar();
+            channel_warmer_.OnClockTick(device_state_ == kDeviceStateIdle);
+            if (protocol_ && !channel_warmer_.speculating()) {
+                protocol_->KeepAlive();
+            }
         
             // Print the debug info every 10 seconds
             if (clock_ticks_ % 10 == 0) {
                 // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
                 // SystemInfo::PrintTaskList();
                 SystemInfo::PrintHeapStats();
+                auto stats = main_tasks_.TakeStatistics();
+                ESP_LOGI(TAG, "Main tasks: depth=%lu max_depth=%lu max_latency=%luus heap=%lu overflow=%lu",
+                    stats.depth, stats.max_depth, stats.max_latency_us, stats.heap_tasks, stats.overflow_tasks);
             }
         }
     }
@@ -620,9 +719,9 @@ void Application::OnWakeWordDetected() {
     if (device_state_ == kDeviceStateIdle) {
         audio_service_.EncodeWakeWord();
 
-        if (!protocol_->IsAudioChannelOpened()) {
+        if (!channel_warmer_.Claim()) {
             SetDeviceState(kDeviceStateConnecting);
-            if (!protocol_->OpenAudioChannel()) {
+            if (!channel_warmer_.Open()) {
                 audio_service_.EnableWakeWordDetection(true);
                 return;
             }
@@ -687,6 +786,8 @@ void Application::SetDeviceState(DeviceState state) {
             display->SetEmotion("neutral");
             audio_service_.EnableVoiceProcessing(false);
             audio_service_.EnableWakeWordDetection(true);
+            channel_warmer_.LogStats();
+            audio_service_.GetLatencyTracer().LogStats();
             break;
         case kDeviceStateConnecting:
             display->SetStatus(Lang::Strings::CONNECTING);
@@ -723,11 +824,13 @@ void Application::SetDeviceState(DeviceState state) {
 
 void Application::Reboot() {
     ESP_LOGI(TAG, "Rebooting...");
-    // Disconnect the audio channel
-    if (protocol_ && protocol_->IsAudioChannelOpened()) {
-        protocol_->CloseAudioChannel();
+    // Disconnect the audio channel, unless the warm-up task is still using the protocol
+    if (channel_warmer_.Wait(pdMS_TO_TICKS(AUDIO_CHANNEL_WARMER_SHUTDOWN_WAIT_MS))) {
+        if (protocol_ && protocol_->IsAudioChannelOpened()) {
+            protocol_->CloseAudioChannel();
+        }
+        protocol_.reset();
     }
-    protocol_.reset();
     audio_service_.Stop();
 
     vTaskDelay(pdMS_TO_TICKS(1000));
@@ -743,6 +846,10 @@ bool Application::UpgradeFirmware(Ota& ota, const std::string& url) {
     std::string version_info = url.empty() ? ota.GetFirmwareVersion() : "(Manual upgrade)";
     
     // Close audio channel if it's open
+    if (!channel_warmer_.Wait(pdMS_TO_TICKS(AUDIO_CHANNEL_WARMER_SHUTDOWN_WAIT_MS))) {
+        ESP_LOGE(TAG, "The audio channel is still warming up, not upgrading now");
+        return false;
+    }
     if (protocol_ && protocol_->IsAudioChannelOpened()) {
         ESP_LOGI(TAG, "Closing audio channel before firmware upgrade");
         protocol_->CloseAudioChannel();
@@ -795,9 +902,9 @@ void Application::WakeWordInvoke(const std::string& wake_word) {
     if (device_state_ == kDeviceStateIdle) {
         audio_service_.EncodeWakeWord();
 
-        if (!protocol_->IsAudioChannelOpened()) {
+        if (!channel_warmer_.Claim()) {
             SetDeviceState(kDeviceStateConnecting);
-            if (!protocol_->OpenAudioChannel()) {
+            if (!channel_warmer_.Open()) {
                 audio_service_.EnableWakeWordDetection(true);
                 return;
             }
@@ -820,7 +927,7 @@ void Application::WakeWordInvoke(const std::string& wake_word) {
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
             AbortSpeaking(kAbortReasonNone);
-        });
+        }, kMainTaskPriorityHigh);
     } else if (device_state_ == kDeviceStateListening) {   
         Schedule([this]() {
             if (protocol_) {
@@ -835,7 +942,7 @@ bool Application::CanEnterSleepMode() {
         return false;
     }
 
-    if (protocol_ && protocol_->IsAudioChannelOpened()) {
+    if (channel_warmer_.speculating() || (protocol_ && protocol_->IsAudioChannelOpened())) {
         return false;
     }
 
@@ -854,11 +961,15 @@ void Application::SendMcpMessage(const std::string& payload) {
 
     // Make sure you are using main thread to send MCP message
     if (xTaskGetCurrentTaskHandle() == main_event_loop_task_handle_) {
-        protocol_->SendMcpMessage(payload);
-    } else {
-        Schedule([this, payload = std::move(payload)]() {
+        RunAfterWarmUp([this, payload]() {
             protocol_->SendMcpMessage(payload);
         });
+    } else {
+        Schedule([this, payload = std::move(payload)]() mutable {
+            RunAfterWarmUp([this, payload = std::move(payload)]() {
+                protocol_->SendMcpMessage(payload);
+            });
+        });
     }
 }
 
@@ -883,9 +994,11 @@ void Application::SetAecMode(AecMode mode) {
         }
 
         // If the AEC mode is changed, close the audio channel
-        if (protocol_ && protocol_->IsAudioChannelOpened()) {
-            protocol_->CloseAudioChannel();
-        }
+        RunAfterWarmUp([this]() {
+            if (protocol_ && protocol_->IsAudioChannelOpened()) {
+                protocol_->CloseAudioChannel();
+            }
+        });
     });
 }
 
@@ -6,6 +6,7 @@
 #include <freertos/task.h>
 #include <esp_timer.h>
 
+#include <atomic>
 #include <string>
 #include <mutex>
 #include <deque>
@@ -15,6 +16,8 @@
 #include "ota.h"
 #include "audio_service.h"
 #include "device_state_event.h"
+#include "main_task_queue.h"
+#include "audio_channel_warmer.h"
 
 
 #define MAIN_EVENT_SCHEDULE (1 << 0)
@@ -46,7 +49,11 @@ public:
     void MainEventLoop();
     DeviceState GetDeviceState() const { return device_state_; }
     bool IsVoiceDetected() const { return audio_service_.IsVoiceDetected(); }
-    void Schedule(std::function<void()> callback);
+    // Runs the callback on the main event loop. Captures are stored inline, see MainTask.
+    template <typename F>
+    void Schedule(F&& callback, MainTaskPriority priority = kMainTaskPriorityNormal) {
+        ScheduleTask(MainTask(std::forward<F>(callback)), priority);
+    }
     void SetDeviceState(DeviceState state);
     void Alert(const char* status, const char* message, const char* emotion = "", const std::string_view& sound = "");
     void DismissAlert();
@@ -63,14 +70,15 @@ public:
     AecMode GetAecMode() const { return aec_mode_; }
     void PlaySound(const std::string_view& sound);
     AudioService& GetAudioService() { return audio_service_; }
+    AudioChannelWarmer& GetAudioChannelWarmer() { return channel_warmer_; }
 
 private:
     Application();
     ~Application();
 
-    std::mutex mutex_;
-    std::deque<std::function<void()>> main_tasks_;
+    MainTaskQueue main_tasks_;
     std::unique_ptr<Protocol> protocol_;
+    AudioChannelWarmer channel_warmer_;
     EventGroupHandle_t event_group_ = nullptr;
     esp_timer_handle_t clock_timer_handle_ = nullptr;
     volatile DeviceState device_state_ = kDeviceStateUnknown;
@@ -81,11 +89,19 @@ private:
 
     bool has_server_time_ = false;
     bool aborted_ = false;
+    // "tts start" messages received, a "tts stop" received before the latest one is stale
+    std::atomic<uint32_t> tts_starts_{0};
     int clock_ticks_ = 0;
+    // Main loop calls into the protocol held back while the warm-up task is opening the channel
+    std::deque<MainTask> after_warm_up_tasks_;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
     TaskHandle_t main_event_loop_task_handle_ = nullptr;
 
+    void ScheduleTask(MainTask&& task, MainTaskPriority priority);
+    void RunAfterWarmUp(MainTask&& task);
+    void SendQueuedAudio();
     void OnWakeWordDetected();
+    void HandleControlMessage(const ControlMessage& message);
     void CheckNewVersion(Ota& ota);
     void CheckAssetsVersion();
     void ShowActivationCode(const std::string& code, const std::string& message);
@@ -1,5 +1,7 @@
 #include "assets.h"
+#include "assets_updater.h"
 #include "board.h"
+#include "settings.h"
 #include "display.h"
 #include "application.h"
 #include "lvgl_theme.h"
@@ -8,19 +10,14 @@
 #include <esp_log.h>
 #include <spi_flash_mmap.h>
 #include <esp_timer.h>
+#include <mbedtls/sha256.h>
 #include <cbin_font.h>
 
+#include <algorithm>
+#include <cstring>
 
-#define TAG "Assets"
-
-struct mmap_assets_table {
-    char asset_name[32];          /*!< Name of the asset */
-    uint32_t asset_size;          /*!< Size of the asset */
-    uint32_t asset_offset;        /*!< Offset of the asset */
-    uint16_t asset_width;         /*!< Width of the asset */
-    uint16_t asset_height;        /*!< Height of the asset */
-};
 
+#define TAG "Assets"
 
 Assets::Assets() {
     // Initialize the partition
@@ -33,10 +30,41 @@ Assets::~Assets() {
     }
 }
 
+// Identifies the image at the start of the partition by its header
+static std::string HeaderSignature(const char* image) {
+    char signature[32];
+    snprintf(signature, sizeof(signature), "%08lx%08lx%08lx", *(uint32_t*)(image + 0), *(uint32_t*)(image + 4), *(uint32_t*)(image + 8));
+    return signature;
+}
+
+// The byte sum of the packer, a word at a time: the even and odd bytes of each word are added
+// into two 16-bit lanes, which are folded into the sum before they can overflow
 uint32_t Assets::CalculateChecksum(const char* data, uint32_t length) {
+    auto bytes = (const uint8_t*)data;
     uint32_t checksum = 0;
-    for (uint32_t i = 0; i < length; i++) {
-        checksum += data[i];
+    while (length > 0 && ((uintptr_t)bytes & 3) != 0) {
+        checksum += *bytes++;
+        length--;
+    }
+
+    auto words = (const uint32_t*)bytes;
+    uint32_t word_count = length / 4;
+    while (word_count > 0) {
+        // A word adds at most 2 * 255 to a lane, so 128 words fit
+        uint32_t block = std::min<uint32_t>(word_count, 128);
+        uint32_t lanes = 0;
+        for (uint32_t i = 0; i < block; i++) {
+            uint32_t word = words[i];
+            lanes += (word & 0x00FF00FF) + ((word >> 8) & 0x00FF00FF);
+        }
+        checksum += (lanes & 0xFFFF) + (lanes >> 16);
+        words += block;
+        word_count -= block;
+    }
+
+    bytes = (const uint8_t*)words;
+    for (uint32_t i = 0; i < (length & 3); i++) {
+        checksum += bytes[i];
     }
     return checksum & 0xFFFF;
 }
@@ -69,36 +97,103 @@ bool Assets::InitializePartition() {
 
     partition_valid_ = true;
 
-    uint32_t stored_files = *(uint32_t*)(mmap_root_ + 0);
-    uint32_t stored_chksum = *(uint32_t*)(mmap_root_ + 4);
-    uint32_t stored_len = *(uint32_t*)(mmap_root_ + 8);
+    // An incremental download may have moved the active image, see DownloadChanges(). A complete
+    // image written to the start of the partition after that, e.g. by flashing, takes over again.
+    Settings settings("assets");
+    image_offset_ = settings.GetInt("offset", 0);
+    if (image_offset_ != 0) {
+        auto signature = HeaderSignature(mmap_root_);
+        if (image_offset_ > partition_->size - 12 ||
+            (signature != settings.GetString("base") && signature != std::string(24, 'f'))) {
+            image_offset_ = 0;
+        }
+    }
+    const char* image = mmap_root_ + image_offset_;
+
+    uint32_t stored_files = *(uint32_t*)(image + 0);
+    uint32_t stored_chksum = *(uint32_t*)(image + 4);
+    uint32_t stored_len = *(uint32_t*)(image + 8);
 
-    if (stored_len > partition_->size - 12) {
+    if (stored_len > partition_->size - image_offset_ - 12 || stored_files > stored_len / sizeof(mmap_assets_table)) {
         ESP_LOGD(TAG, "The stored_len (0x%lx) is greater than the partition size (0x%lx) - 12", stored_len, partition_->size);
         return false;
     }
+    image_size_ = 12 + stored_len;
+
+    size_t data_start = image_offset_ + 12 + sizeof(mmap_assets_table) * stored_files;
+    assets_.reserve(stored_files);
+    for (uint32_t i = 0; i < stored_files; i++) {
+        auto item = (const mmap_assets_table*)(image + 12 + i * sizeof(mmap_assets_table));
+        auto asset = Asset{
+            .name = std::string_view(item->asset_name, strnlen(item->asset_name, sizeof(item->asset_name))),
+            .size = static_cast<size_t>(item->asset_size),
+            .offset = static_cast<size_t>(data_start + item->asset_offset)
+        };
+        if (item->asset_size > stored_len || asset.offset + 2 + asset.size > image_offset_ + image_size_) {
+            ESP_LOGE(TAG, "The asset %.32s is out of the image", item->asset_name);
+            assets_.clear();
+            return false;
+        }
+        assets_.push_back(asset);
+    }
+    std::sort(assets_.begin(), assets_.end(), [](const Asset& a, const Asset& b) {
+        return a.name < b.name;
+    });
+
+    // With a manifest each asset is checked when it is first used, instead of the whole image here
+    auto manifest = FindAsset(ASSETS_MANIFEST_NAME);
+    if (manifest != nullptr && manifest->size % ASSETS_MANIFEST_ENTRY_SIZE == 0) {
+        auto entries = (const uint8_t*)mmap_root_ + manifest->offset + 2;
+        for (size_t pos = 0; pos < manifest->size; pos += ASSETS_MANIFEST_ENTRY_SIZE) {
+            auto name = (const char*)entries + pos;
+            auto asset = FindAsset(std::string_view(name, strnlen(name, 32)));
+            if (asset != nullptr) {
+                asset->sha256 = entries + pos + 32;
+            }
+        }
+        ESP_LOGI(TAG, "%lu assets at 0x%x, checked on first use", stored_files, image_offset_);
+        checksum_valid_ = true;
+        return true;
+    }
+
+    // Without one the image is checked once, later boots recognize it by its place and header
+    std::string generation = std::to_string(image_offset_) + ":" + HeaderSignature(image);
+    if (settings.GetString("verified") == generation) {
+        ESP_LOGI(TAG, "%lu assets at 0x%x, verified on an earlier boot", stored_files, image_offset_);
+        checksum_valid_ = true;
+        return true;
+    }
 
     auto start_time = esp_timer_get_time();
-    uint32_t calculated_checksum = CalculateChecksum(mmap_root_ + 12, stored_len);
+    uint32_t calculated_checksum = CalculateChecksum(image + 12, stored_len);
     auto end_time = esp_timer_get_time();
-    ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((end_time - start_time) / 1000));
+    ESP_LOGI(TAG, "The checksum calculation time is %d ms for %lu KB (%lu KB/s)", int((end_time - start_time) / 1000),
+        stored_len / 1024, (uint32_t)(stored_len * 1000LL / std::max<int64_t>(end_time - start_time, 1)));
 
     if (calculated_checksum != stored_chksum) {
         ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_chksum);
+        assets_.clear();
         return false;
     }
 
+    Settings write_settings("assets", true);
+    write_settings.SetString("verified", generation);
     checksum_valid_ = true;
+    return checksum_valid_;
+}
 
-    for (uint32_t i = 0; i < stored_files; i++) {
-        auto item = (const mmap_assets_table*)(mmap_root_ + 12 + i * sizeof(mmap_assets_table));
-        auto asset = Asset{
-            .size = static_cast<size_t>(item->asset_size),
-            .offset = static_cast<size_t>(12 + sizeof(mmap_assets_table) * stored_files + item->asset_offset)
-        };
-        assets_[item->asset_name] = asset;
+bool Assets::VerifyAsset(Asset& asset) {
+    uint8_t digest[32];
+    auto start_time = esp_timer_get_time();
+    mbedtls_sha256((const uint8_t*)mmap_root_ + asset.offset + 2, asset.size, digest, 0);
+    if (memcmp(digest, asset.sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "The asset %.*s does not match its hash", (int)asset.name.size(), asset.name.data());
+        return false;
     }
-    return checksum_valid_;
+    ESP_LOGD(TAG, "The asset %.*s (%u bytes) is checked in %d ms", (int)asset.name.size(), asset.name.data(), asset.size,
+        int((esp_timer_get_time() - start_time) / 1000));
+    asset.verified = true;
+    return true;
 }
 
 bool Assets::Apply() {
@@ -125,8 +220,7 @@ bool Assets::Apply() {
     
     cJSON* srmodels = cJSON_GetObjectItem(root, "srmodels");
     if (cJSON_IsString(srmodels)) {
-        std::string srmodels_file = srmodels->valuestring;
-        if (GetAssetData(srmodels_file, ptr, size)) {
+        if (GetAssetData(srmodels->valuestring, ptr, size)) {
             if (models_list_ != nullptr) {
                 esp_srmodel_deinit(models_list_);
                 models_list_ = nullptr;
@@ -139,7 +233,7 @@ bool Assets::Apply() {
                 ESP_LOGE(TAG, "Failed to load srmodels.bin");
             }
         } else {
-            ESP_LOGE(TAG, "The srmodels file %s is not found", srmodels_file.c_str());
+            ESP_LOGE(TAG, "The srmodels file %s is not found", srmodels->valuestring);
         }
     }
 
@@ -150,8 +244,7 @@ bool Assets::Apply() {
 
     cJSON* font = cJSON_GetObjectItem(root, "text_font");
     if (cJSON_IsString(font)) {
-        std::string fonts_text_file = font->valuestring;
-        if (GetAssetData(fonts_text_file, ptr, size)) {
+        if (GetAssetData(font->valuestring, ptr, size)) {
             auto text_font = std::make_shared<LvglCBinFont>(ptr);
             if (text_font->font() == nullptr) {
                 ESP_LOGE(TAG, "Failed to load fonts.bin");
@@ -164,7 +257,7 @@ bool Assets::Apply() {
                 dark_theme->set_text_font(text_font);
             }
         } else {
-            ESP_LOGE(TAG, "The font file %s is not found", fonts_text_file.c_str());
+            ESP_LOGE(TAG, "The font file %s is not found", font->valuestring);
         }
     }
 
@@ -255,8 +348,7 @@ bool Assets::Apply() {
 
     cJSON* font = cJSON_GetObjectItem(root, "text_font");
     if (cJSON_IsString(font)) {
-        std::string fonts_text_file = font->valuestring;
-        if (GetAssetData(fonts_text_file, ptr, size)) {
+        if (GetAssetData(font->valuestring, ptr, size)) {
             auto text_font = std::make_shared<LvglCBinFont>(ptr);
             if (text_font->font() == nullptr) {
                 ESP_LOGE(TAG, "Failed to load fonts.bin");
@@ -267,7 +359,7 @@ bool Assets::Apply() {
                 emote_display->AddTextFont(text_font);
             }
         } else {
-            ESP_LOGE(TAG, "The font file %s is not found", fonts_text_file.c_str());
+            ESP_LOGE(TAG, "The font file %s is not found", font->valuestring);
         }
     }
 
@@ -369,7 +461,18 @@ bool Assets::Apply() {
 
 bool Assets::Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback) {
     ESP_LOGI(TAG, "Downloading new version of assets from %s", url.c_str());
+
+    // Only the changed files if the server serves ranges and the image has a manifest
+    if (DownloadChanges(url, progress_callback)) {
+        return true;
+    }
     
+    // The image is rewritten in place, it has to be checked again even if the header stays the same
+    {
+        Settings settings("assets", true);
+        settings.EraseKey("verified");
+    }
+
     // 取消当前资源分区的内存映射
     if (mmap_handle_ != 0) {
         esp_partition_munmap(mmap_handle_);
@@ -491,6 +594,12 @@ bool Assets::Download(std::string url, std::function<void(int progress, size_t s
     ESP_LOGI(TAG, "Assets download completed, total written: %u bytes, total sectors erased: %u", 
              total_written, current_sector);
 
+    // The full image is always at the start of the partition
+    {
+        Settings settings("assets", true);
+        settings.EraseKey("offset");
+    }
+
     // 重新初始化资源分区
     if (!InitializePartition()) {
         ESP_LOGE(TAG, "Failed to re-initialize assets partition");
@@ -500,18 +609,71 @@ bool Assets::Download(std::string url, std::function<void(int progress, size_t s
     return true;
 }
 
-bool Assets::GetAssetData(const std::string& name, void*& ptr, size_t& size) {
-    auto asset = assets_.find(name);
-    if (asset == assets_.end()) {
+// Rebuilds the new image next to the active one, see AssetsUpdater, then switches to it
+bool Assets::DownloadChanges(const std::string& url, std::function<void(int progress, size_t speed)> progress_callback) {
+    // Unchanged files are copied from the active image
+    if (!checksum_valid_) {
         return false;
     }
-    auto data = (const char*)(mmap_root_ + asset->second.offset);
+    std::vector<AssetsUpdater::LocalFile> local_files;
+    local_files.reserve(assets_.size());
+    for (auto& asset : assets_) {
+        local_files.push_back({(const uint8_t*)mmap_root_ + asset.offset + 2, asset.size, asset.sha256});
+    }
+
+    AssetsUpdater updater(partition_, image_offset_, image_size_, std::move(local_files));
+    if (!updater.Update(url, progress_callback)) {
+        ESP_LOGW(TAG, "Incremental assets download not possible, downloading the full image");
+        return false;
+    }
+
+    // The switch to the new image is this NVS update, the old image stays valid until then
+    {
+        Settings settings("assets", true);
+        if (updater.offset() == 0) {
+            settings.EraseKey("offset");
+        } else {
+            settings.SetString("base", HeaderSignature(mmap_root_));
+            settings.SetInt("offset", updater.offset());
+        }
+    }
+    esp_partition_munmap(mmap_handle_);
+    mmap_handle_ = 0;
+    mmap_root_ = nullptr;
+    checksum_valid_ = false;
+    assets_.clear();
+    if (!InitializePartition()) {
+        ESP_LOGE(TAG, "Failed to re-initialize assets partition");
+        return false;
+    }
+    return true;
+}
+
+Asset* Assets::FindAsset(std::string_view name) {
+    auto asset = std::lower_bound(assets_.begin(), assets_.end(), name, [](const Asset& a, std::string_view b) {
+        return a.name < b;
+    });
+    if (asset == assets_.end() || asset->name != name) {
+        return nullptr;
+    }
+    return &*asset;
+}
+
+bool Assets::GetAssetData(std::string_view name, void*& ptr, size_t& size) {
+    auto asset = FindAsset(name);
+    if (asset == nullptr) {
+        return false;
+    }
+    auto data = (const char*)(mmap_root_ + asset->offset);
     if (data[0] != 'Z' || data[1] != 'Z') {
-        ESP_LOGE(TAG, "The asset %s is not valid with magic %02x%02x", name.c_str(), data[0], data[1]);
+        ESP_LOGE(TAG, "The asset %.*s is not valid with magic %02x%02x", (int)name.size(), name.data(), data[0], data[1]);
+        return false;
+    }
+    if (asset->sha256 != nullptr && !asset->verified && !VerifyAsset(*asset)) {
         return false;
     }
 
     ptr = static_cast<void*>(const_cast<char*>(data + 2));
-    size = asset->second.size;
+    size = asset->size;
     return true;
 }
@@ -1,8 +1,9 @@
 #ifndef ASSETS_H
 #define ASSETS_H
 
-#include <map>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <functional>
 
 #include <cJSON.h>
@@ -10,9 +11,27 @@
 #include <model_path.h>
 
 
+// Per-file SHA-256 packed as an asset by scripts/build_default_assets.py: entries of name[32], sha256[32]
+#define ASSETS_MANIFEST_NAME "assets.sha256"
+#define ASSETS_MANIFEST_ENTRY_SIZE 64
+
+// The assets image: u32 files, u32 checksum, u32 length, then this table and the file data
+struct mmap_assets_table {
+    char asset_name[32];          /*!< Name of the asset */
+    uint32_t asset_size;          /*!< Size of the asset */
+    uint32_t asset_offset;        /*!< Offset of the asset */
+    uint16_t asset_width;         /*!< Width of the asset */
+    uint16_t asset_height;        /*!< Height of the asset */
+};
+
 struct Asset {
+    // Points into the mapped table, valid while the partition is mapped
+    std::string_view name;
     size_t size;
     size_t offset;
+    // From the manifest, the asset is checked against it when it is first used
+    const uint8_t* sha256 = nullptr;
+    bool verified = false;
 };
 
 class Assets {
@@ -25,7 +44,7 @@ public:
 
     bool Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback);
     bool Apply();
-    bool GetAssetData(const std::string& name, void*& ptr, size_t& size);
+    bool GetAssetData(std::string_view name, void*& ptr, size_t& size);
 
     inline bool partition_valid() const { return partition_valid_; }
     inline bool checksum_valid() const { return checksum_valid_; }
@@ -37,16 +56,23 @@ private:
     Assets& operator=(const Assets&) = delete;
 
     bool InitializePartition();
+    Asset* FindAsset(std::string_view name);
+    bool DownloadChanges(const std::string& url, std::function<void(int progress, size_t speed)> progress_callback);
     uint32_t CalculateChecksum(const char* data, uint32_t length);
+    bool VerifyAsset(Asset& asset);
 
     const esp_partition_t* partition_ = nullptr;
     esp_partition_mmap_handle_t mmap_handle_ = 0;
     const char* mmap_root_ = nullptr;
+    // The active image starts at image_offset_ in the partition, see DownloadChanges()
+    size_t image_offset_ = 0;
+    size_t image_size_ = 0;
     bool partition_valid_ = false;
     bool checksum_valid_ = false;
     std::string default_assets_url_;
     srmodel_list_t* models_list_ = nullptr;
-    std::map<std::string, Asset> assets_;
+    // Sorted by name, looked up without copying the name
+    std::vector<Asset> assets_;
 };
 
 #endif
@@ -0,0 +1,349 @@
+#include "assets_updater.h"
+#include "board.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <mbedtls/sha256.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <numeric>
+
+#define TAG "AssetsUpdater"
+
+static uint32_t ReadU32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static std::string AssetName(const char* name) {
+    return std::string(name, strnlen(name, 32));
+}
+
+AssetsUpdater::AssetsUpdater(const esp_partition_t* partition, size_t active_offset, size_t active_size, std::vector<LocalFile> local_files)
+    : partition_(partition), active_offset_(active_offset), active_size_(active_size), local_files_(std::move(local_files)) {
+    local_hashes_.resize(local_files_.size());
+    buffer_ = (uint8_t*)heap_caps_malloc(ASSETS_UPDATE_BUFFER_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+AssetsUpdater::~AssetsUpdater() {
+    if (buffer_ != nullptr) {
+        heap_caps_free(buffer_);
+    }
+}
+
+bool AssetsUpdater::ReadRange(const std::string& url, size_t offset, size_t length, const std::function<bool(const uint8_t* data, size_t size)>& handler) {
+    auto http = Board::GetInstance().GetNetwork()->CreateHttp(0);
+    http->SetHeader("Range", "bytes=" + std::to_string(offset) + "-" + std::to_string(offset + length - 1));
+    if (!http->Open("GET", url)) {
+        ESP_LOGE(TAG, "Failed to open HTTP connection");
+        return false;
+    }
+    // A server without range support sends the whole image, that is left to the full download
+    if (http->GetStatusCode() != 206 || http->GetBodyLength() != length) {
+        ESP_LOGW(TAG, "Range %u+%u not served, status code: %d", offset, length, http->GetStatusCode());
+        http->Close();
+        return false;
+    }
+
+    size_t received = 0;
+    while (received < length) {
+        int ret = http->Read((char*)buffer_, std::min<size_t>(ASSETS_UPDATE_BUFFER_SIZE, length - received));
+        if (ret <= 0) {
+            ESP_LOGE(TAG, "Failed to read HTTP data at %u/%u: %d", received, length, ret);
+            http->Close();
+            return false;
+        }
+        if (!handler(buffer_, ret)) {
+            http->Close();
+            return false;
+        }
+        received += ret;
+        fetched_ += ret;
+    }
+    http->Close();
+    return true;
+}
+
+bool AssetsUpdater::ReadRange(const std::string& url, size_t offset, size_t length, uint8_t* output) {
+    return ReadRange(url, offset, length, [&output](const uint8_t* data, size_t size) {
+        memcpy(output, data, size);
+        output += size;
+        return true;
+    });
+}
+
+bool AssetsUpdater::Write(const uint8_t* data, size_t size) {
+    if (written_ + size > image_size_) {
+        ESP_LOGE(TAG, "Write past the end of the image");
+        return false;
+    }
+    // Erase as the writes reach the next sector
+    while (erased_ < written_ + size) {
+        esp_err_t err = esp_partition_erase_range(partition_, offset_ + erased_, sector_size_);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to erase sector at offset %u: %s", offset_ + erased_, esp_err_to_name(err));
+            return false;
+        }
+        erased_ += sector_size_;
+    }
+    esp_err_t err = esp_partition_write(partition_, offset_ + written_, data, size);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s", offset_ + written_, esp_err_to_name(err));
+        return false;
+    }
+
+    // The checksum covers everything after the 12 byte header, which is not written here
+    for (size_t i = 0; i < size; i++) {
+        checksum_ += data[i];
+    }
+    written_ += size;
+    recent_written_ += size;
+
+    if (esp_timer_get_time() - last_calc_time_ >= 1000000 || written_ == image_size_) {
+        size_t progress = written_ * 100 / image_size_;
+        ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %u B/s, Downloaded: %u", progress, written_, image_size_, recent_written_, fetched_);
+        if (progress_handler_) {
+            progress_handler_(progress, recent_written_);
+        }
+        last_calc_time_ = esp_timer_get_time();
+        recent_written_ = 0;
+    }
+    return true;
+}
+
+const AssetsUpdater::LocalFile* AssetsUpdater::FindLocal(const uint8_t* sha256, size_t size) {
+    for (size_t i = 0; i < local_files_.size(); i++) {
+        auto& file = local_files_[i];
+        if (file.size != size) {
+            continue;
+        }
+        if (file.sha256 == nullptr) {
+            mbedtls_sha256(file.data, file.size, local_hashes_[i].data(), 0);
+            file.sha256 = local_hashes_[i].data();
+        }
+        if (memcmp(file.sha256, sha256, 32) == 0) {
+            return &file;
+        }
+    }
+    return nullptr;
+}
+
+bool AssetsUpdater::CopyLocal(const LocalFile& file) {
+    static const uint8_t magic[2] = { 'Z', 'Z' };
+    if (!Write(magic, sizeof(magic))) {
+        return false;
+    }
+
+    // Copied through RAM, flash cannot be written from its own mapping. A local file that was
+    // not used since boot is not verified yet, so it is hashed on the way.
+    mbedtls_sha256_context sha256;
+    mbedtls_sha256_init(&sha256);
+    mbedtls_sha256_starts(&sha256, 0);
+    bool ok = true;
+    for (size_t copied = 0; copied < file.size && ok; ) {
+        size_t count = std::min<size_t>(ASSETS_UPDATE_BUFFER_SIZE, file.size - copied);
+        memcpy(buffer_, file.data + copied, count);
+        mbedtls_sha256_update(&sha256, buffer_, count);
+        ok = Write(buffer_, count);
+        copied += count;
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha256, digest);
+    mbedtls_sha256_free(&sha256);
+    if (ok && memcmp(digest, file.sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "A local file does not match its hash");
+        ok = false;
+    }
+    return ok;
+}
+
+bool AssetsUpdater::Update(const std::string& url, ProgressHandler progress_handler) {
+    if (buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate the update buffer");
+        return false;
+    }
+    progress_handler_ = progress_handler;
+    fetched_ = 0;
+
+    uint8_t header[12];
+    if (!ReadRange(url, 0, sizeof(header), header)) {
+        return false;
+    }
+    uint32_t files = ReadU32(header);
+    uint32_t stored_checksum = ReadU32(header + 4);
+    uint32_t stored_len = ReadU32(header + 8);
+    size_t table_size = files * sizeof(mmap_assets_table);
+    size_t image_size = sizeof(header) + stored_len;
+    if (files == 0 || table_size > stored_len || image_size > partition_->size) {
+        ESP_LOGE(TAG, "The remote assets header is not valid");
+        return false;
+    }
+
+    std::vector<mmap_assets_table> table(files);
+    if (!ReadRange(url, sizeof(header), table_size, (uint8_t*)table.data())) {
+        return false;
+    }
+
+    // The files must follow each other in the data to be rebuilt byte for byte
+    std::vector<int> order(files);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&table](int a, int b) {
+        return table[a].asset_offset < table[b].asset_offset;
+    });
+    size_t data_start = sizeof(header) + table_size;
+    size_t data_end = 0;
+    int manifest_index = -1;
+    for (int i : order) {
+        if (table[i].asset_offset != data_end) {
+            ESP_LOGW(TAG, "The remote assets are not packed back to back");
+            return false;
+        }
+        data_end += 2 + table[i].asset_size;
+        if (AssetName(table[i].asset_name) == ASSETS_MANIFEST_NAME) {
+            manifest_index = i;
+        }
+    }
+    if (data_start + data_end != image_size) {
+        ESP_LOGE(TAG, "The remote assets table does not match the image size");
+        return false;
+    }
+    if (manifest_index < 0) {
+        ESP_LOGW(TAG, "The remote assets have no manifest");
+        return false;
+    }
+
+    auto& manifest_item = table[manifest_index];
+    std::vector<uint8_t> manifest(manifest_item.asset_size);
+    if (manifest.size() % ASSETS_MANIFEST_ENTRY_SIZE != 0 ||
+        !ReadRange(url, data_start + manifest_item.asset_offset + 2, manifest.size(), manifest.data())) {
+        ESP_LOGW(TAG, "Failed to get the remote assets manifest");
+        return false;
+    }
+
+    // Hash of each remote file, and a local file with the same content if there is one
+    std::map<std::string, int> table_index;
+    for (int i = 0; i < (int)files; i++) {
+        table_index[AssetName(table[i].asset_name)] = i;
+    }
+    std::vector<const uint8_t*> hashes(files, nullptr);
+    for (size_t pos = 0; pos < manifest.size(); pos += ASSETS_MANIFEST_ENTRY_SIZE) {
+        auto it = table_index.find(AssetName((const char*)&manifest[pos]));
+        if (it != table_index.end()) {
+            hashes[it->second] = &manifest[pos + 32];
+        }
+    }
+    std::vector<const LocalFile*> sources(files, nullptr);
+    size_t to_fetch = 0;
+    for (int i = 0; i < (int)files; i++) {
+        if (i != manifest_index && hashes[i] != nullptr) {
+            sources[i] = FindLocal(hashes[i], table[i].asset_size);
+        }
+        if (i != manifest_index && sources[i] == nullptr) {
+            to_fetch += 2 + table[i].asset_size;
+        }
+    }
+
+    // Before the active image if it fits there, otherwise after it
+    sector_size_ = esp_partition_get_main_flash_sector_size();
+    if (image_size <= active_offset_) {
+        offset_ = 0;
+    } else {
+        offset_ = (active_offset_ + active_size_ + sector_size_ - 1) / sector_size_ * sector_size_;
+        if (offset_ + image_size > partition_->size) {
+            ESP_LOGW(TAG, "No room for %u bytes next to the active assets (%u bytes at 0x%x)", image_size, active_size_, active_offset_);
+            return false;
+        }
+    }
+    ESP_LOGI(TAG, "Writing %u bytes of assets at 0x%x, %u bytes of changed files to download", image_size, offset_, to_fetch);
+
+    // The header is written last, an image without one is not taken for a complete image
+    image_size_ = image_size;
+    written_ = sizeof(header);
+    erased_ = 0;
+    checksum_ = 0;
+    recent_written_ = 0;
+    last_calc_time_ = esp_timer_get_time();
+    if (!Write((const uint8_t*)table.data(), table_size)) {
+        return false;
+    }
+
+    for (size_t k = 0; k < order.size(); ) {
+        int i = order[k];
+        if (i == manifest_index) {
+            static const uint8_t magic[2] = { 'Z', 'Z' };
+            if (!Write(magic, sizeof(magic)) || !Write(manifest.data(), manifest.size())) {
+                return false;
+            }
+            k++;
+            continue;
+        }
+        if (sources[i] != nullptr) {
+            if (!CopyLocal(*sources[i])) {
+                return false;
+            }
+            k++;
+            continue;
+        }
+
+        // This and the changed files after it come in one request, each checked as it ends
+        size_t run_end = k + 1;
+        while (run_end < order.size() && order[run_end] != manifest_index && sources[order[run_end]] == nullptr) {
+            run_end++;
+        }
+        size_t range_start = table[order[k]].asset_offset;
+        size_t range_end = table[order[run_end - 1]].asset_offset + 2 + table[order[run_end - 1]].asset_size;
+
+        mbedtls_sha256_context sha256;
+        mbedtls_sha256_init(&sha256);
+        mbedtls_sha256_starts(&sha256, 0);
+        size_t current = k;
+        size_t position = 0;
+        bool ok = ReadRange(url, data_start + range_start, range_end - range_start, [&](const uint8_t* data, size_t size) {
+            if (!Write(data, size)) {
+                return false;
+            }
+            while (size > 0) {
+                auto& item = table[order[current]];
+                size_t count = std::min<size_t>(size, 2 + item.asset_size - position);
+                // The two magic bytes are not part of the file
+                size_t skip = position < 2 ? std::min<size_t>(2 - position, count) : 0;
+                mbedtls_sha256_update(&sha256, data + skip, count - skip);
+                position += count;
+                data += count;
+                size -= count;
+                if (position == 2 + item.asset_size) {
+                    uint8_t digest[32];
+                    mbedtls_sha256_finish(&sha256, digest);
+                    auto expected = hashes[order[current]];
+                    if (expected != nullptr && memcmp(digest, expected, sizeof(digest)) != 0) {
+                        ESP_LOGE(TAG, "The downloaded %s does not match the manifest", AssetName(item.asset_name).c_str());
+                        return false;
+                    }
+                    mbedtls_sha256_starts(&sha256, 0);
+                    current++;
+                    position = 0;
+                }
+            }
+            return true;
+        });
+        mbedtls_sha256_free(&sha256);
+        if (!ok) {
+            return false;
+        }
+        k = run_end;
+    }
+
+    if (written_ != image_size_ || (checksum_ & 0xFFFF) != stored_checksum) {
+        ESP_LOGE(TAG, "The rebuilt assets checksum (0x%lx) does not match the stored checksum (0x%lx)", checksum_ & 0xFFFF, stored_checksum);
+        return false;
+    }
+    esp_err_t err = esp_partition_write(partition_, offset_, header, sizeof(header));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write the assets header: %s", esp_err_to_name(err));
+        return false;
+    }
+    ESP_LOGI(TAG, "Assets rebuilt at 0x%x, downloaded %u of %u bytes", offset_, fetched_, image_size_);
+    return true;
+}
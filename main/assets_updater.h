@@ -0,0 +1,73 @@
+#ifndef ASSETS_UPDATER_H
+#define ASSETS_UPDATER_H
+
+#include "assets.h"
+
+#include <esp_partition.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#define ASSETS_UPDATE_BUFFER_SIZE 4096
+
+/*
+ * Rebuilds a remote assets image in the free space of the assets partition, next to the active
+ * image, so that only what changed is downloaded:
+ *   - the header, the table and the manifest of the remote image are fetched with range requests
+ *   - a file with the SHA-256 of a local file is copied from flash
+ *   - each run of changed files is fetched with one range request and checked against the manifest
+ *
+ * The new image is the remote one byte for byte, so its checksum is checked as it is written.
+ * The active image is not touched; the caller switches to the new image when Update() succeeds.
+ */
+class AssetsUpdater {
+public:
+    struct LocalFile {
+        const uint8_t* data;
+        size_t size;
+        // nullptr if the active image has no manifest, the file is hashed when it could match
+        const uint8_t* sha256;
+    };
+    using ProgressHandler = std::function<void(int progress, size_t speed)>;
+
+    AssetsUpdater(const esp_partition_t* partition, size_t active_offset, size_t active_size, std::vector<LocalFile> local_files);
+    ~AssetsUpdater();
+
+    // False if ranges are not served, the remote image has no manifest, there is no room, or a download failed
+    bool Update(const std::string& url, ProgressHandler progress_handler = nullptr);
+
+    // Where the new image was written and how much of it was downloaded, after Update() returned true
+    size_t offset() const { return offset_; }
+    size_t fetched() const { return fetched_; }
+
+private:
+    const esp_partition_t* partition_;
+    size_t active_offset_;
+    size_t active_size_;
+    std::vector<LocalFile> local_files_;
+    std::vector<std::array<uint8_t, 32>> local_hashes_;
+    uint8_t* buffer_ = nullptr;
+
+    ProgressHandler progress_handler_;
+    size_t sector_size_ = 0;
+    size_t offset_ = 0;
+    size_t image_size_ = 0;
+    size_t written_ = 0;
+    size_t erased_ = 0;
+    size_t fetched_ = 0;
+    uint32_t checksum_ = 0;
+    size_t recent_written_ = 0;
+    int64_t last_calc_time_ = 0;
+
+    bool ReadRange(const std::string& url, size_t offset, size_t length, const std::function<bool(const uint8_t* data, size_t size)>& handler);
+    bool ReadRange(const std::string& url, size_t offset, size_t length, uint8_t* output);
+    bool Write(const uint8_t* data, size_t size);
+    bool CopyLocal(const LocalFile& file);
+    const LocalFile* FindLocal(const uint8_t* sha256, size_t size);
+};
+
+#endif // ASSETS_UPDATER_H
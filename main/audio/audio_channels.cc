@@ -0,0 +1,63 @@
+#include "audio_channels.h"
+
+#include <algorithm>
+
+namespace audio_channels {
+
+// Word access to int16_t buffers
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+static inline bool Aligned(const void* a, const void* b) {
+    return (((uintptr_t)a | (uintptr_t)b) & 3) == 0;
+}
+
+static inline int16_t Saturate(int64_t value) {
+    return (int16_t)std::clamp<int64_t>(value, INT16_MIN, INT16_MAX);
+}
+
+void ExtractChannel(const int16_t* interleaved, size_t frames, int channels, int channel, int16_t* mono) {
+    size_t i = 0;
+    if (channels == 2 && Aligned(interleaved, mono)) {
+        // Each word holds one stereo frame, little endian puts the left sample in the low half
+        const word_t* in = (const word_t*)interleaved;
+        word_t* out = (word_t*)mono;
+        size_t words = frames / 2;
+        if (channel == 0) {
+            for (size_t k = 0; k < words; k++) {
+                out[k] = (in[k * 2] & 0xFFFF) | (in[k * 2 + 1] << 16);
+            }
+        } else {
+            for (size_t k = 0; k < words; k++) {
+                out[k] = (in[k * 2] >> 16) | (in[k * 2 + 1] & 0xFFFF0000);
+            }
+        }
+        i = words * 2;
+    }
+    for (; i < frames; i++) {
+        mono[i] = interleaved[i * channels + channel];
+    }
+}
+
+void ApplyGain(int16_t* samples, size_t count, int32_t gain_q12) {
+    if (gain_q12 == AUDIO_GAIN_UNITY) {
+        return;
+    }
+    // The products need more than 32 bits from a gain of 16 up
+    int64_t gain = gain_q12;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int64_t s0 = (samples[i] * gain) >> 12;
+        int64_t s1 = (samples[i + 1] * gain) >> 12;
+        int64_t s2 = (samples[i + 2] * gain) >> 12;
+        int64_t s3 = (samples[i + 3] * gain) >> 12;
+        samples[i] = Saturate(s0);
+        samples[i + 1] = Saturate(s1);
+        samples[i + 2] = Saturate(s2);
+        samples[i + 3] = Saturate(s3);
+    }
+    for (; i < count; i++) {
+        samples[i] = Saturate((samples[i] * gain) >> 12);
+    }
+}
+
+} // namespace audio_channels
@@ -0,0 +1,28 @@
+#ifndef AUDIO_CHANNELS_H
+#define AUDIO_CHANNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Gain of ApplyGain() in Q12, 1.0 is 4096
+#define AUDIO_GAIN_UNITY 4096
+
+/*
+ * Channel utilities for 16-bit PCM, working on buffers the caller owns so nothing is allocated.
+ *
+ * The output may be the same buffer as the input (e.g. extract the left channel in place and
+ * then resize the vector to the frame count), since no output sample is written before the
+ * input samples at the same or lower index are read. When the buffers are 4-byte aligned two
+ * samples are moved per 32-bit load and store.
+ */
+namespace audio_channels {
+
+// One channel of interleaved PCM into mono
+void ExtractChannel(const int16_t* interleaved, size_t frames, int channels, int channel, int16_t* mono);
+
+// Scales samples in place, saturating at the int16 range
+void ApplyGain(int16_t* samples, size_t count, int32_t gain_q12);
+
+} // namespace audio_channels
+
+#endif // AUDIO_CHANNELS_H
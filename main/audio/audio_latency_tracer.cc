@@ -0,0 +1,142 @@
+#include "audio_latency_tracer.h"
+
+#include <esp_log.h>
+
+#define TAG "AudioLatency"
+
+static const char* const kUplinkStageNames[AUDIO_TRACE_POINTS] = {
+    "total", "process", "encode_queue", "encode", "send",
+};
+static const char* const kDownlinkStageNames[AUDIO_TRACE_POINTS] = {
+    "total", "buffer", "decode", "playback_queue", "output",
+};
+
+void AudioLatencyTracer::ResetCapture() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capture_marks_head_ = 0;
+    capture_marks_count_ = 0;
+    captured_samples_ = 0;
+    output_samples_ = 0;
+}
+
+void AudioLatencyTracer::OnCaptured(size_t samples, int64_t now_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    captured_samples_ += samples;
+    // The oldest mark is overwritten if the processor holds back more than the marks cover
+    size_t index = (capture_marks_head_ + capture_marks_count_) % AUDIO_TRACE_CAPTURE_MARKS;
+    if (capture_marks_count_ == AUDIO_TRACE_CAPTURE_MARKS) {
+        capture_marks_head_ = (capture_marks_head_ + 1) % AUDIO_TRACE_CAPTURE_MARKS;
+    } else {
+        capture_marks_count_++;
+    }
+    capture_marks_[index] = {captured_samples_, now_us};
+}
+
+int64_t AudioLatencyTracer::GetCaptureTime(size_t samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    output_samples_ += samples;
+    // Marks that end before the newest output sample are not needed again
+    while (capture_marks_count_ > 1 && capture_marks_[capture_marks_head_].end_sample < output_samples_) {
+        capture_marks_head_ = (capture_marks_head_ + 1) % AUDIO_TRACE_CAPTURE_MARKS;
+        capture_marks_count_--;
+    }
+    if (capture_marks_count_ == 0) {
+        return 0;
+    }
+    return capture_marks_[capture_marks_head_].time_us;
+}
+
+bool AudioLatencyTracer::Record(std::array<LatencyHistogram, AUDIO_TRACE_POINTS>& histograms, const AudioFrameTrace& trace) {
+    for (int i = 0; i < AUDIO_TRACE_POINTS; i++) {
+        if (trace.time_us[i] == 0 || (i > 0 && trace.time_us[i] < trace.time_us[i - 1])) {
+            return false;
+        }
+    }
+    histograms[0].Record(trace.time_us[AUDIO_TRACE_POINTS - 1] - trace.time_us[0]);
+    for (int i = 1; i < AUDIO_TRACE_POINTS; i++) {
+        histograms[i].Record(trace.time_us[i] - trace.time_us[i - 1]);
+    }
+    return true;
+}
+
+static void LogTrace(const char* direction, const AudioFrameTrace& trace) {
+#if CONFIG_AUDIO_LATENCY_TRACE_LOG
+    ESP_LOGI(TAG, "trace %s %lu %lu %lu %lu %lu", direction,
+        (uint32_t)(trace.time_us[4] - trace.time_us[0]), (uint32_t)(trace.time_us[1] - trace.time_us[0]),
+        (uint32_t)(trace.time_us[2] - trace.time_us[1]), (uint32_t)(trace.time_us[3] - trace.time_us[2]),
+        (uint32_t)(trace.time_us[4] - trace.time_us[3]));
+#endif
+}
+
+void AudioLatencyTracer::RecordUplink(AudioFrameTrace& trace, int64_t sent_us) {
+    trace.Mark(kUplinkSent, sent_us);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Record(uplink_, trace)) {
+        LogTrace("U", trace);
+    }
+}
+
+void AudioLatencyTracer::RecordDownlink(AudioFrameTrace& trace, int64_t output_done_us) {
+    trace.Mark(kDownlinkOutputDone, output_done_us);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Record(downlink_, trace)) {
+        LogTrace("D", trace);
+    }
+}
+
+void AudioLatencyTracer::RecordPromptStart(int64_t start_us, bool predecoded) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    (predecoded ? prompt_predecoded_ : prompt_decoded_).Record(start_us);
+#if CONFIG_AUDIO_LATENCY_TRACE_LOG
+    ESP_LOGI(TAG, "trace P %s %lu", predecoded ? "predecoded" : "decoded", (uint32_t)start_us);
+#endif
+}
+
+static cJSON* StagesToJson(const std::array<LatencyHistogram, AUDIO_TRACE_POINTS>& histograms,
+    const char* const* names) {
+    cJSON* json = cJSON_CreateObject();
+    for (int i = 0; i < AUDIO_TRACE_POINTS; i++) {
+        cJSON_AddItemToObject(json, names[i], histograms[i].ToJson());
+    }
+    return json;
+}
+
+cJSON* AudioLatencyTracer::GetStatsJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "unit", "us");
+    cJSON_AddItemToObject(json, "uplink", StagesToJson(uplink_, kUplinkStageNames));
+    cJSON_AddItemToObject(json, "downlink", StagesToJson(downlink_, kDownlinkStageNames));
+    cJSON* prompt = cJSON_CreateObject();
+    cJSON_AddItemToObject(prompt, "predecoded", prompt_predecoded_.ToJson());
+    cJSON_AddItemToObject(prompt, "decoded", prompt_decoded_.ToJson());
+    cJSON_AddItemToObject(json, "prompt_start", prompt);
+    return json;
+}
+
+static void LogStages(const char* direction, const std::array<LatencyHistogram, AUDIO_TRACE_POINTS>& histograms,
+    const char* const* names) {
+    if (histograms[0].count() == 0) {
+        return;
+    }
+    for (int i = 0; i < AUDIO_TRACE_POINTS; i++) {
+        auto& histogram = histograms[i];
+        ESP_LOGI(TAG, "%s %s us: n=%lu p50=%lu p90=%lu p99=%lu max=%lu", direction, names[i], histogram.count(),
+            histogram.Percentile(50), histogram.Percentile(90), histogram.Percentile(99), histogram.max());
+    }
+}
+
+static void LogPromptStart(const char* name, const LatencyHistogram& histogram) {
+    if (histogram.count() > 0) {
+        ESP_LOGI(TAG, "Prompt start %s us: n=%lu p50=%lu p90=%lu max=%lu", name, histogram.count(),
+            histogram.Percentile(50), histogram.Percentile(90), histogram.max());
+    }
+}
+
+void AudioLatencyTracer::LogStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    LogStages("Uplink", uplink_, kUplinkStageNames);
+    LogStages("Downlink", downlink_, kDownlinkStageNames);
+    LogPromptStart("predecoded", prompt_predecoded_);
+    LogPromptStart("decoded", prompt_decoded_);
+}
@@ -0,0 +1,98 @@
+#ifndef AUDIO_LATENCY_TRACER_H
+#define AUDIO_LATENCY_TRACER_H
+
+#include <cJSON.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "latency_histogram.h"
+
+#define AUDIO_TRACE_POINTS 5
+#define AUDIO_TRACE_CAPTURE_MARKS 16
+
+// Points an uplink frame passes, in order
+enum AudioUplinkTracePoint {
+    kUplinkCaptured,        // ReadAudioData returned the newest samples of the frame
+    kUplinkProcessed,       // The audio processor output the frame into the encode queue
+    kUplinkEncodeStart,     // The encode task took it from the encode queue
+    kUplinkEncoded,         // The packet is in the send queue
+    kUplinkSent,            // SendAudio returned
+};
+
+// Points a downlink frame passes, in order
+enum AudioDownlinkTracePoint {
+    kDownlinkReceived,      // The protocol received the packet
+    kDownlinkDecodeStart,   // The jitter buffer released it
+    kDownlinkDecoded,       // The PCM is in the playback queue
+    kDownlinkOutputStart,   // The output task took it from the playback queue
+    kDownlinkOutputDone,    // OutputData returned
+};
+
+// Travels with a frame through the queues, a point that is still 0 was not passed
+struct AudioFrameTrace {
+    std::array<int64_t, AUDIO_TRACE_POINTS> time_us = {};
+
+    // A pooled frame may still hold the trace of its previous use
+    void Start(int64_t now_us) {
+        time_us.fill(0);
+        time_us[0] = now_us;
+    }
+    void Mark(int point, int64_t now_us) { time_us[point] = now_us; }
+};
+
+/*
+ * Collects per-stage latency histograms (microseconds) of the frames that made it through the
+ * whole uplink or downlink. Stage i is the time between trace points i-1 and i, stage 0 is the
+ * whole path.
+ *
+ * The audio processor buffers its input, so the capture time of a processed frame is found by
+ * counting samples: OnCaptured() marks how many samples were fed by when, and GetCaptureTime()
+ * looks up when the newest sample of an output frame was read.
+ *
+ * With CONFIG_AUDIO_LATENCY_TRACE_LOG every recorded frame is also printed as a "trace" line,
+ * scripts/audio_latency_replay.py computes the same percentiles from a captured serial log.
+ *
+ * All methods may be called from any task.
+ */
+class AudioLatencyTracer {
+public:
+    // The audio processor restarts with empty buffers
+    void ResetCapture();
+    // Audio input task, samples (per channel) just read for the audio processor
+    void OnCaptured(size_t samples, int64_t now_us);
+    // Audio processor output, returns when the newest of the next samples was captured
+    int64_t GetCaptureTime(size_t samples);
+
+    void RecordUplink(AudioFrameTrace& trace, int64_t sent_us);
+    void RecordDownlink(AudioFrameTrace& trace, int64_t output_done_us);
+    // From PlaySound() to the first frame of the sound in the playback queue
+    void RecordPromptStart(int64_t start_us, bool predecoded);
+
+    cJSON* GetStatsJson();
+    // Prints the percentiles of every stage, if any frame was recorded
+    void LogStats();
+
+private:
+    struct CaptureMark {
+        uint64_t end_sample;
+        int64_t time_us;
+    };
+
+    std::mutex mutex_;
+    std::array<LatencyHistogram, AUDIO_TRACE_POINTS> uplink_;
+    std::array<LatencyHistogram, AUDIO_TRACE_POINTS> downlink_;
+    LatencyHistogram prompt_predecoded_;
+    LatencyHistogram prompt_decoded_;
+
+    std::array<CaptureMark, AUDIO_TRACE_CAPTURE_MARKS> capture_marks_ = {};
+    size_t capture_marks_head_ = 0;
+    size_t capture_marks_count_ = 0;
+    uint64_t captured_samples_ = 0;
+    uint64_t output_samples_ = 0;
+
+    static bool Record(std::array<LatencyHistogram, AUDIO_TRACE_POINTS>& histograms, const AudioFrameTrace& trace);
+};
+
+#endif // AUDIO_LATENCY_TRACER_H
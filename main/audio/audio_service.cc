@@ -1,6 +1,9 @@
 #include "audio_service.h"
+#include "audio_channels.h"
 #include <esp_log.h>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -17,6 +20,9 @@
 
 #define TAG "AudioService"
 
+// -1 in the config leaves the task free to run on either core
+#define OPUS_TASK_CORE(core) ((core) < 0 ? tskNO_AFFINITY : (core))
+
 
 AudioService::AudioService() {
     event_group_ = xEventGroupCreate();
@@ -36,11 +42,12 @@ void AudioService::Initialize(AudioCodec* codec) {
     /* Setup the audio codec */
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
     opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_->SetComplexity(0);
+    opus_encoder_->SetComplexity(encoder_tuner_.complexity());
+
+    playback_dsp_.Configure(codec->output_sample_rate());
 
     if (codec->input_sample_rate() != 16000) {
-        input_resampler_.Configure(codec->input_sample_rate(), 16000);
-        reference_resampler_.Configure(codec->input_sample_rate(), 16000);
+        input_resampler_.Configure(codec->input_sample_rate(), 16000, codec->input_channels());
     }
 
 #if CONFIG_USE_AUDIO_PROCESSOR
@@ -50,7 +57,15 @@ void AudioService::Initialize(AudioCodec* codec) {
 #endif
 
     audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
-        PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data));
+        int64_t capture_time_us = latency_tracer_.GetCaptureTime(data.size());
+        auto task = audio_task_pool_.Acquire();
+        // Copied into the pooled buffer instead of adopting the processor's, so both keep their capacity
+        size_t capacity = task->pcm.capacity();
+        task->pcm.assign(data.begin(), data.end());
+        if (task->pcm.capacity() != capacity) {
+            pcm_allocations_.fetch_add(1, std::memory_order_relaxed);
+        }
+        PushTaskToEncodeQueue(std::move(task), kAudioTaskTypeEncodeToSendQueue, capture_time_us);
     });
 
     audio_processor_->OnVadStateChange([this](bool speaking) {
@@ -109,30 +124,43 @@ void AudioService::Start() {
     }, "audio_output", 2048, this, 4, &audio_output_task_handle_);
 #endif
 
-    /* Start the opus codec task */
-    xTaskCreate([](void* arg) {
+    /* Start the opus codec tasks, a long decode never holds up the uplink and the other way round */
+    xTaskCreatePinnedToCore([](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
-        audio_service->OpusCodecTask();
+        audio_service->OpusEncodeTask();
         vTaskDelete(NULL);
-    }, "opus_codec", 2048 * 13, this, 2, &opus_codec_task_handle_);
+    }, "opus_encode", 2048 * 13, this, 2, &opus_encode_task_handle_, OPUS_TASK_CORE(CONFIG_OPUS_ENCODE_TASK_CORE));
+
+    xTaskCreatePinnedToCore([](void* arg) {
+        AudioService* audio_service = (AudioService*)arg;
+        audio_service->OpusDecodeTask();
+        vTaskDelete(NULL);
+    }, "opus_decode", 2048 * 5, this, 3, &opus_decode_task_handle_, OPUS_TASK_CORE(CONFIG_OPUS_DECODE_TASK_CORE));
+
+    /* Stop() discarded the decode queue with any reset marker in it, start over from a clean decoder */
+    ResetDecoder();
 }
 
 void AudioService::Stop() {
     esp_timer_stop(audio_power_timer_);
     service_stopped_ = true;
+    /* Wake up every task so that they can see the service is stopped */
     xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
         AS_EVENT_WAKE_WORD_RUNNING |
-        AS_EVENT_AUDIO_PROCESSOR_RUNNING);
-
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    audio_encode_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+        AS_EVENT_AUDIO_PROCESSOR_RUNNING |
+        AS_EVENT_PLAYBACK_NOT_EMPTY | AS_EVENT_PLAYBACK_NOT_FULL |
+        AS_EVENT_ENCODE_QUEUE_NOT_EMPTY | AS_EVENT_ENCODE_QUEUE_NOT_FULL |
+        AS_EVENT_DECODE_QUEUE_NOT_EMPTY | AS_EVENT_DECODE_QUEUE_NOT_FULL |
+        AS_EVENT_SEND_QUEUE_NOT_FULL);
+
+    audio_encode_queue_.Discard();
+    audio_decode_queue_.Discard();
+    audio_playback_queue_.Discard();
+    audio_testing_queue_.Discard();
 }
 
 bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
+    size_t capacity = data.capacity();
     if (!codec_->input_enabled()) {
         esp_timer_stop(audio_power_timer_);
         esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
@@ -144,27 +172,8 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
         if (!codec_->InputData(data)) {
             return false;
         }
-        if (codec_->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
-            }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
-            }
-        } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
-        }
+        // Mic and reference stay interleaved, both channels are resampled in one pass
+        input_resampler_.Process(data);
     } else {
         data.resize(samples * codec_->input_channels());
         if (!codec_->InputData(data)) {
@@ -172,6 +181,11 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
         }
     }
 
+    /* A buffer that is read into again keeps its capacity, only the first reads allocate */
+    if (data.capacity() != capacity) {
+        pcm_allocations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
     /* Update the last input time */
     last_input_time_ = std::chrono::steady_clock::now();
     debug_statistics_.input_count++;
@@ -204,34 +218,35 @@ void AudioService::AudioInputTask() {
 
         /* Used for audio testing in NetworkConfiguring mode by clicking the BOOT button */
         if (bits & AS_EVENT_AUDIO_TESTING_RUNNING) {
-            if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
+            if (audio_testing_queue_.Full()) {
                 ESP_LOGW(TAG, "Audio testing queue is full, stopping audio testing");
                 EnableAudioTesting(false);
                 continue;
             }
-            std::vector<int16_t> data;
+            // Read straight into the pooled task, so the frame is never copied
+            auto task = audio_task_pool_.Acquire();
             int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
-            if (ReadAudioData(data, 16000, samples)) {
+            if (ReadAudioData(task->pcm, 16000, samples)) {
+                int64_t capture_time_us = esp_timer_get_time();
                 // If input channels is 2, we need to fetch the left channel data
                 if (codec_->input_channels() == 2) {
-                    auto mono_data = std::vector<int16_t>(data.size() / 2);
-                    for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                        mono_data[i] = data[j];
-                    }
-                    data = std::move(mono_data);
+                    audio_channels::ExtractChannel(task->pcm.data(), samples, 2, 0, task->pcm.data());
+                    task->pcm.resize(samples);
                 }
-                PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(data));
+                PushTaskToEncodeQueue(std::move(task), kAudioTaskTypeEncodeToTestingQueue, capture_time_us);
                 continue;
             }
         }
 
         /* Feed the wake word */
         if (bits & AS_EVENT_WAKE_WORD_RUNNING) {
-            std::vector<int16_t> data;
             int samples = wake_word_->GetFeedSize();
             if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
-                    wake_word_->Feed(data);
+                if (ReadAudioData(wake_word_input_, 16000, samples)) {
+                    wake_word_->Feed(wake_word_input_);
+                    if (callbacks_.on_speech_onset) {
+                        DetectSpeechOnset(wake_word_input_);
+                    }
                     continue;
                 }
             }
@@ -239,11 +254,12 @@ void AudioService::AudioInputTask() {
 
         /* Feed the audio processor */
         if (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING) {
-            std::vector<int16_t> data;
             int samples = audio_processor_->GetFeedSize();
             if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
-                    audio_processor_->Feed(std::move(data));
+                if (ReadAudioData(processor_input_, 16000, samples)) {
+                    latency_tracer_.OnCaptured(samples, esp_timer_get_time());
+                    // The processors copy what they keep, the buffer is read into again next time
+                    audio_processor_->Feed(std::move(processor_input_));
                     continue;
                 }
             }
@@ -256,18 +272,55 @@ void AudioService::AudioInputTask() {
     ESP_LOGW(TAG, "Audio input task stopped");
 }
 
-void AudioService::AudioOutputTask() {
-    while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() { return !audio_playback_queue_.empty() || service_stopped_; });
-        if (service_stopped_) {
-            break;
+/*
+ * A cheap energy detector for the first syllable of a possible wake word: fires once when the
+ * mean level of the microphone channel stays SPEECH_ONSET_RATIO times above a slowly rising
+ * noise floor for SPEECH_ONSET_CHUNKS chunks in a row.
+ */
+void AudioService::DetectSpeechOnset(const std::vector<int16_t>& data) {
+    int channels = codec_->input_channels();
+    uint32_t sum = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < data.size(); i += channels) {
+        sum += std::abs(data[i]);
+        count++;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    uint32_t level_q4 = sum / count * 16;
+    if (onset_noise_floor_q4_ == 0 || level_q4 < onset_noise_floor_q4_) {
+        onset_noise_floor_q4_ = level_q4;
+    } else {
+        onset_noise_floor_q4_ += (level_q4 - onset_noise_floor_q4_) >> 6;
+    }
+
+    if (level_q4 > SPEECH_ONSET_MIN_LEVEL * 16 && level_q4 > onset_noise_floor_q4_ * SPEECH_ONSET_RATIO) {
+        if (++onset_loud_chunks_ == SPEECH_ONSET_CHUNKS) {
+            callbacks_.on_speech_onset();
         }
+    } else {
+        onset_loud_chunks_ = 0;
+    }
+}
 
-        auto task = std::move(audio_playback_queue_.front());
-        audio_playback_queue_.pop_front();
-        audio_queue_cv_.notify_all();
-        lock.unlock();
+void AudioService::AudioOutputTask() {
+    bool timestamp_queue_full = false;
+    while (!service_stopped_) {
+        AudioTaskPtr task;
+        if (!audio_playback_queue_.Pop(task)) {
+            /* Discarded tasks may have been dropped by Pop(), let the producer know there is room */
+            xEventGroupSetBits(event_group_, AS_EVENT_PLAYBACK_NOT_FULL);
+            /* Clear before re-checking, so a push in between still wakes us up */
+            xEventGroupClearBits(event_group_, AS_EVENT_PLAYBACK_NOT_EMPTY);
+            if (audio_playback_queue_.Empty() && !service_stopped_) {
+                xEventGroupWaitBits(event_group_, AS_EVENT_PLAYBACK_NOT_EMPTY, pdFALSE, pdFALSE, portMAX_DELAY);
+            }
+            continue;
+        }
+        xEventGroupSetBits(event_group_, AS_EVENT_PLAYBACK_NOT_FULL);
+        task->trace.Mark(kDownlinkOutputStart, esp_timer_get_time());
 
         if (!codec_->output_enabled()) {
             esp_timer_stop(audio_power_timer_);
@@ -275,6 +328,7 @@ void AudioService::AudioOutputTask() {
             codec_->EnableOutput(true);
         }
         codec_->OutputData(task->pcm);
+        latency_tracer_.RecordDownlink(task->trace, esp_timer_get_time());
 
         /* Update the last output time */
         last_output_time_ = std::chrono::steady_clock::now();
@@ -283,8 +337,12 @@ void AudioService::AudioOutputTask() {
 #if CONFIG_USE_SERVER_AEC
         /* Record the timestamp for server AEC */
         if (task->timestamp > 0) {
-            lock.lock();
-            timestamp_queue_.push_back(task->timestamp);
+            /* Nobody takes timestamps while the microphone is not sent, log once per run of drops */
+            bool pushed = timestamp_queue_.Push(std::move(task->timestamp));
+            if (!pushed && !timestamp_queue_full) {
+                ESP_LOGW(TAG, "Timestamp queue is full, dropping timestamps until the input takes them");
+            }
+            timestamp_queue_full = !pushed;
         }
 #endif
     }
@@ -292,83 +350,283 @@ void AudioService::AudioOutputTask() {
     ESP_LOGW(TAG, "Audio output task stopped");
 }
 
-void AudioService::OpusCodecTask() {
-    while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() {
-            return service_stopped_ ||
-                (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
-                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
-        });
-        if (service_stopped_) {
-            break;
+void AudioService::OpusDecodeTask() {
+    const EventBits_t wake_bits = AS_EVENT_DECODE_QUEUE_NOT_EMPTY | AS_EVENT_PLAYBACK_NOT_FULL;
+    /* Recorded audio is played back once audio testing stops */
+    auto can_replay_testing = [this]() {
+        return !(xEventGroupGetBits(event_group_) & AS_EVENT_AUDIO_TESTING_RUNNING) && !audio_testing_queue_.Empty();
+    };
+    auto can_decode = [this, &can_replay_testing](int64_t now) {
+        return !audio_playback_queue_.Full() && (playing_prompt_ != nullptr || pending_prompt_.load() != nullptr ||
+            jitter_buffer_.Ready(now) || can_replay_testing());
+    };
+    uint32_t max_decode_us = 0;
+    auto reset_decoder = [this, &max_decode_us]() {
+        auto& stats = jitter_buffer_.statistics();
+        if (stats.received > 0) {
+            ESP_LOGI(TAG, "Jitter buffer: received=%lu late=%lu duplicate=%lu lost=%lu target_depth=%lu jitter=%lums",
+                stats.received, stats.late, stats.duplicate, stats.lost, stats.target_depth, stats.jitter_ms);
+            ESP_LOGI(TAG, "Opus decode: frames=%lu deadline_misses=%lu max=%luus stack_free=%u",
+                debug_statistics_.decode_count, debug_statistics_.decode_deadline_misses, max_decode_us,
+                uxTaskGetStackHighWaterMark(NULL));
         }
+        max_decode_us = 0;
+        // A prompt asked for after the reset is still pending, only the one being played is dropped
+        playing_prompt_ = nullptr;
+        jitter_buffer_.Reset();
+        opus_decoder_->ResetState();
+        playback_dsp_.Reset();
+        downlink_received_.store(0, std::memory_order_relaxed);
+        downlink_lost_.store(0, std::memory_order_relaxed);
+    };
 
-        /* Decode the audio from decode queue */
-        if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
-            auto packet = std::move(audio_decode_queue_.front());
-            audio_decode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
+    while (!service_stopped_) {
+        /* Move arrived packets into the jitter buffer right away, so their arrival time is measured.
+           While a reset is pending the queue is drained up to its marker even if the buffer is full. */
+        int64_t now = esp_timer_get_time();
+        if (!audio_decode_queue_.Empty() && (!jitter_buffer_.Full() || decoder_reset_requested_)) {
+            // Cleared before the pop, so a packet on its way into the buffer is never seen as idle
+            decoder_idle_ = false;
+            AudioStreamPacketPtr packet;
+            while ((!jitter_buffer_.Full() || decoder_reset_requested_) && audio_decode_queue_.Pop(packet)) {
+                if (!packet) {
+                    // The marker of ResetDecoder(), the packets behind it belong to the next stream
+                    decoder_reset_requested_ = false;
+                    reset_decoder();
+                    continue;
+                }
+                if (decoder_reset_requested_) {
+                    // Pushed before the reset, the discard mark may not have been set when it was popped
+                    continue;
+                }
+                jitter_buffer_.Put(std::move(packet), now);
+            }
+            xEventGroupSetBits(event_group_, AS_EVENT_DECODE_QUEUE_NOT_FULL);
+        }
 
-            auto task = std::make_unique<AudioTask>();
-            task->type = kAudioTaskTypeDecodeToPlaybackQueue;
-            task->timestamp = packet->timestamp;
+        if (!can_decode(now)) {
+            /* Clear before re-checking, so a push or pop in between still wakes us up */
+            xEventGroupClearBits(event_group_, wake_bits);
+            decoder_idle_ = jitter_buffer_.Empty() && playing_prompt_ == nullptr;
+            now = esp_timer_get_time();
+            if (!can_decode(now) && !service_stopped_ &&
+                (audio_decode_queue_.Empty() || jitter_buffer_.Full())) {
+                /* The jitter buffer may be holding packets back for a while */
+                int64_t wait_us = jitter_buffer_.GetWaitTimeUs(now);
+                TickType_t wait_ticks = wait_us < 0 ? portMAX_DELAY : pdMS_TO_TICKS(wait_us / 1000) + 1;
+                xEventGroupWaitBits(event_group_, wake_bits, pdFALSE, pdFALSE, wait_ticks);
+            }
+            continue;
+        }
 
+        /* Decoded prompt sounds go ahead of the jitter buffer, they are feedback to the user */
+        if (PushPromptFrame()) {
+            continue;
+        }
+
+        /* Decode the audio from the jitter buffer */
+        AudioStreamPacketPtr packet;
+        JitterBufferResult result = kJitterBufferNotReady;
+        if (can_replay_testing() && audio_testing_queue_.Pop(packet)) {
+            result = kJitterBufferPacket;
+        } else {
+            result = jitter_buffer_.Get(packet, now);
+        }
+        auto& stats = jitter_buffer_.statistics();
+        downlink_received_.store(stats.received, std::memory_order_relaxed);
+        downlink_lost_.store(stats.lost, std::memory_order_relaxed);
+        if (result == kJitterBufferNotReady) {
+            continue;
+        }
+
+        auto task = audio_task_pool_.Acquire();
+        task->type = kAudioTaskTypeDecodeToPlaybackQueue;
+        task->timestamp = 0;
+        task->trace = {};
+
+        bool decoded;
+        if (result == kJitterBufferPacket) {
+            task->timestamp = packet->timestamp;
+            task->trace = packet->trace;
+            task->trace.Mark(kDownlinkDecodeStart, now);
             SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
-                // Resample if the sample rate is different
-                if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
-                    int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
-                    std::vector<int16_t> resampled(target_size);
-                    output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
-                    task->pcm = std::move(resampled);
-                }
+            decoded = opus_decoder_->Decode(std::move(packet->payload), task->pcm);
+        } else {
+            decoded = ConcealLostFrame(task->pcm);
+        }
+
+        if (decoded) {
+            // Resample if the sample rate is different
+            if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
+                output_resampler_.Process(task->pcm);
+            }
+            playback_dsp_.Process(task->pcm);
+
+            int64_t decoded_time = esp_timer_get_time();
+            task->trace.Mark(kDownlinkDecoded, decoded_time);
+            audio_playback_queue_.Push(std::move(task));
+            xEventGroupSetBits(event_group_, AS_EVENT_PLAYBACK_NOT_EMPTY);
+            // Exact for a prompt played while nothing else is, otherwise this is the frame ahead of it
+            int64_t request_time = prompt_request_time_us_.exchange(0);
+            if (request_time != 0) {
+                latency_tracer_.RecordPromptStart(decoded_time - request_time, false);
+            }
+        } else {
+            ESP_LOGE(TAG, "Failed to decode audio");
+        }
 
-                lock.lock();
-                audio_playback_queue_.push_back(std::move(task));
-                audio_queue_cv_.notify_all();
-            } else {
-                ESP_LOGE(TAG, "Failed to decode audio");
-                lock.lock();
+        /* The frame has to be ready before the one ahead of it finishes playing */
+        uint32_t decode_us = esp_timer_get_time() - now;
+        max_decode_us = std::max(max_decode_us, decode_us);
+        if (decode_us > opus_decoder_->duration_ms() * 1000u) {
+            debug_statistics_.decode_deadline_misses++;
+        }
+        debug_statistics_.decode_count++;
+        debug_statistics_.heap_alloc_count = GetAudioStreamPacketPool().allocations() + audio_task_pool_.allocations() +
+            pcm_allocations_.load(std::memory_order_relaxed);
+    }
+
+    ESP_LOGW(TAG, "Opus decode task stopped");
+}
+
+/*
+ * Copies the next frame of the decoded prompt sound into the playback queue. Returns false when
+ * no decoded prompt is playing, so the decode task goes on with the jitter buffer.
+ */
+bool AudioService::PushPromptFrame() {
+    if (playing_prompt_ == nullptr) {
+        if (pending_prompt_.load() == nullptr) {
+            return false;
+        }
+        // Cleared before the hand-over, so the prompt is never seen as neither pending nor playing
+        decoder_idle_ = false;
+        playing_prompt_ = pending_prompt_.exchange(nullptr);
+        prompt_position_ = 0;
+        if (playing_prompt_ == nullptr) {
+            return false;
+        }
+    }
+
+    size_t frame_samples = codec_->output_sample_rate() / 1000 * OPUS_FRAME_DURATION_MS;
+    size_t samples = std::min(frame_samples, playing_prompt_->pcm_samples - prompt_position_);
+    const int16_t* pcm = playing_prompt_->pcm + prompt_position_;
+
+    auto task = audio_task_pool_.Acquire();
+    task->type = kAudioTaskTypeDecodeToPlaybackQueue;
+    task->timestamp = 0;
+    task->trace = {};
+    task->pcm.assign(pcm, pcm + samples);
+    playback_dsp_.Process(task->pcm);
+    audio_playback_queue_.Push(std::move(task));
+    xEventGroupSetBits(event_group_, AS_EVENT_PLAYBACK_NOT_EMPTY);
+
+    if (prompt_position_ == 0) {
+        int64_t request_time = prompt_request_time_us_.exchange(0);
+        if (request_time != 0) {
+            latency_tracer_.RecordPromptStart(esp_timer_get_time() - request_time, true);
+        }
+    }
+    prompt_position_ += samples;
+    if (prompt_position_ >= playing_prompt_->pcm_samples) {
+        playing_prompt_ = nullptr;
+    }
+    return true;
+}
+
+void AudioService::OpusEncodeTask() {
+    const EventBits_t wake_bits = AS_EVENT_ENCODE_QUEUE_NOT_EMPTY | AS_EVENT_SEND_QUEUE_NOT_FULL;
+    auto can_encode = [this]() {
+        return !audio_encode_queue_.Empty() && !audio_send_queue_.Full();
+    };
+    uint32_t max_encode_us = 0;
+
+    while (!service_stopped_) {
+        if (encoder_tuner_reset_requested_.exchange(false)) {
+            if (max_encode_us > 0) {
+                ESP_LOGI(TAG, "Opus encode: frames=%lu deadline_misses=%lu max=%luus stack_free=%u",
+                    debug_statistics_.encode_count, debug_statistics_.encode_deadline_misses, max_encode_us,
+                    uxTaskGetStackHighWaterMark(NULL));
             }
-            debug_statistics_.decode_count++;
+            max_encode_us = 0;
+            encoder_tuner_.Reset();
         }
-        
+
+        if (!can_encode()) {
+            /* Clear before re-checking, so a push or pop in between still wakes us up */
+            xEventGroupClearBits(event_group_, wake_bits);
+            decoder_idle_ = jitter_buffer_.Empty() && playing_prompt_ == nullptr;
+            if (!can_encode() && !service_stopped_) {
+                xEventGroupWaitBits(event_group_, wake_bits, pdFALSE, pdFALSE, portMAX_DELAY);
+            }
+            continue;
+        }
+
         /* Encode the audio to send queue */
-        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
-            auto task = std::move(audio_encode_queue_.front());
-            audio_encode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
-
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->frame_duration = OPUS_FRAME_DURATION_MS;
-            packet->sample_rate = 16000;
-            packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
-                ESP_LOGE(TAG, "Failed to encode audio");
-                continue;
+        AudioTaskPtr task;
+        if (!audio_encode_queue_.Pop(task)) {
+            continue;
+        }
+        xEventGroupSetBits(event_group_, AS_EVENT_ENCODE_QUEUE_NOT_FULL);
+
+        auto packet = GetAudioStreamPacketPool().Acquire();
+        packet->frame_duration = OPUS_FRAME_DURATION_MS;
+        packet->sample_rate = 16000;
+        packet->timestamp = task->timestamp;
+        packet->sequence = 0;
+        int64_t encode_start_time = esp_timer_get_time();
+        if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
+            ESP_LOGE(TAG, "Failed to encode audio");
+            continue;
+        }
+        int64_t encode_end_time = esp_timer_get_time();
+        if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+            if (encoder_tuner_.OnFrameEncoded(encode_end_time - encode_start_time, audio_send_queue_.Size(),
+                    MAX_SEND_PACKETS_IN_QUEUE, downlink_received_.load(std::memory_order_relaxed),
+                    downlink_lost_.load(std::memory_order_relaxed), encode_end_time)) {
+                opus_encoder_->SetComplexity(encoder_tuner_.complexity());
             }
+        }
 
-            if (task->type == kAudioTaskTypeEncodeToSendQueue) {
-                {
-                    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
-                }
-                if (callbacks_.on_send_queue_available) {
-                    callbacks_.on_send_queue_available();
-                }
-            } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
-                std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                audio_testing_queue_.push_back(std::move(packet));
+        if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+            packet->trace = task->trace;
+            packet->trace.Mark(kUplinkEncodeStart, encode_start_time);
+            packet->trace.Mark(kUplinkEncoded, esp_timer_get_time());
+            audio_send_queue_.Push(std::move(packet));
+            if (callbacks_.on_send_queue_available) {
+                callbacks_.on_send_queue_available();
             }
-            debug_statistics_.encode_count++;
-            lock.lock();
+        } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
+            packet->trace = {};
+            if (!audio_testing_queue_.Push(std::move(packet))) {
+                ESP_LOGW(TAG, "Audio testing queue is full, stopping audio testing");
+                EnableAudioTesting(false);
+            }
+        }
+
+        /* The next frame is captured by now, a frame still waiting on us is late */
+        uint32_t encode_us = encode_end_time - task->trace.time_us[kUplinkProcessed];
+        max_encode_us = std::max(max_encode_us, encode_us);
+        if (encode_us > OPUS_FRAME_DURATION_MS * 1000u) {
+            debug_statistics_.encode_deadline_misses++;
         }
+        debug_statistics_.encode_count++;
+        debug_statistics_.heap_alloc_count = GetAudioStreamPacketPool().allocations() + audio_task_pool_.allocations() +
+            pcm_allocations_.load(std::memory_order_relaxed);
     }
 
-    ESP_LOGW(TAG, "Opus codec task stopped");
+    ESP_LOGW(TAG, "Opus encode task stopped");
+}
+
+bool AudioService::ConcealLostFrame(std::vector<int16_t>& pcm) {
+    /* An empty packet makes the Opus decoder run its packet loss concealment */
+    concealment_payload_.clear();
+    if (opus_decoder_->Decode(std::move(concealment_payload_), pcm)) {
+        return true;
+    }
+
+    /* Keep the timing with a silent frame if the decoder cannot conceal */
+    pcm.assign(opus_decoder_->sample_rate() * opus_decoder_->duration_ms() / 1000, 0);
+    return true;
 }
 
 void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
@@ -386,51 +644,63 @@ void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
     }
 }
 
-void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm) {
-    auto task = std::make_unique<AudioTask>();
+void AudioService::PushTaskToEncodeQueue(AudioTaskPtr task, AudioTaskType type, int64_t capture_time_us) {
     task->type = type;
-    task->pcm = std::move(pcm);
-    
-    /* Push the task to the encode queue */
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+    task->timestamp = 0;
+    task->trace.Start(capture_time_us);
+    task->trace.Mark(kUplinkProcessed, esp_timer_get_time());
 
     /* If the task is to send queue, we need to set the timestamp */
-    if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
-        if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
-            task->timestamp = timestamp_queue_.front();
-        } else {
-            ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamp_queue_.size());
+    if (type == kAudioTaskTypeEncodeToSendQueue) {
+        /* Drop the stale timestamps at once, dropping one per frame would never catch up */
+        uint32_t timestamp;
+        size_t dropped = 0;
+        while (timestamp_queue_.Size() > MAX_TIMESTAMPS_IN_QUEUE && timestamp_queue_.Pop(timestamp)) {
+            dropped++;
+        }
+        if (dropped > 0) {
+            ESP_LOGW(TAG, "Timestamp queue was full, dropped %u timestamps", dropped);
+        }
+        if (timestamp_queue_.Pop(timestamp)) {
+            task->timestamp = timestamp;
         }
-        timestamp_queue_.pop_front();
     }
 
-    audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
-    audio_encode_queue_.push_back(std::move(task));
-    audio_queue_cv_.notify_all();
+    /* Push the task to the encode queue */
+    std::lock_guard<std::mutex> lock(audio_encode_producer_mutex_);
+    while (!audio_encode_queue_.Push(std::move(task))) {
+        if (service_stopped_) {
+            return;
+        }
+        xEventGroupClearBits(event_group_, AS_EVENT_ENCODE_QUEUE_NOT_FULL);
+        if (audio_encode_queue_.Full()) {
+            xEventGroupWaitBits(event_group_, AS_EVENT_ENCODE_QUEUE_NOT_FULL, pdFALSE, pdFALSE, portMAX_DELAY);
+        }
+    }
+    xEventGroupSetBits(event_group_, AS_EVENT_ENCODE_QUEUE_NOT_EMPTY);
 }
 
-bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-    if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
-        if (wait) {
-            audio_queue_cv_.wait(lock, [this]() { return audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
-        } else {
+bool AudioService::PushPacketToDecodeQueue(AudioStreamPacketPtr packet, bool wait) {
+    std::lock_guard<std::mutex> lock(audio_decode_producer_mutex_);
+    while (!audio_decode_queue_.Push(std::move(packet))) {
+        if (!wait || service_stopped_) {
             return false;
         }
+        xEventGroupClearBits(event_group_, AS_EVENT_DECODE_QUEUE_NOT_FULL);
+        if (audio_decode_queue_.Full()) {
+            xEventGroupWaitBits(event_group_, AS_EVENT_DECODE_QUEUE_NOT_FULL, pdFALSE, pdFALSE, portMAX_DELAY);
+        }
     }
-    audio_decode_queue_.push_back(std::move(packet));
-    audio_queue_cv_.notify_all();
+    xEventGroupSetBits(event_group_, AS_EVENT_DECODE_QUEUE_NOT_EMPTY);
     return true;
 }
 
-std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    if (audio_send_queue_.empty()) {
+AudioStreamPacketPtr AudioService::PopPacketFromSendQueue() {
+    AudioStreamPacketPtr packet;
+    if (!audio_send_queue_.Pop(packet)) {
         return nullptr;
     }
-    auto packet = std::move(audio_send_queue_.front());
-    audio_send_queue_.pop_front();
-    audio_queue_cv_.notify_all();
+    xEventGroupSetBits(event_group_, AS_EVENT_SEND_QUEUE_NOT_FULL);
     return packet;
 }
 
@@ -444,8 +714,13 @@ const std::string& AudioService::GetLastWakeWord() const {
     return wake_word_->GetLastDetectedWakeWord();
 }
 
-std::unique_ptr<AudioStreamPacket> AudioService::PopWakeWordPacket() {
-    auto packet = std::make_unique<AudioStreamPacket>();
+AudioStreamPacketPtr AudioService::PopWakeWordPacket() {
+    auto packet = GetAudioStreamPacketPool().Acquire();
+    packet->sample_rate = 16000;
+    packet->frame_duration = OPUS_FRAME_DURATION_MS;
+    packet->timestamp = 0;
+    packet->sequence = 0;
+    packet->trace = {};
     if (wake_word_->GetWakeWordOpus(packet->payload)) {
         return packet;
     }
@@ -484,6 +759,8 @@ void AudioService::EnableVoiceProcessing(bool enable) {
 
         /* We should make sure no audio is playing */
         ResetDecoder();
+        encoder_tuner_reset_requested_ = true;
+        latency_tracer_.ResetCapture();
         audio_input_need_warmup_ = true;
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
@@ -499,10 +776,8 @@ void AudioService::EnableAudioTesting(bool enable) {
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
     } else {
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
-        /* Copy audio_testing_queue_ to audio_decode_queue_ */
-        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-        audio_decode_queue_ = std::move(audio_testing_queue_);
-        audio_queue_cv_.notify_all();
+        /* The opus decode task plays back audio_testing_queue_ once testing is stopped */
+        xEventGroupSetBits(event_group_, AS_EVENT_DECODE_QUEUE_NOT_EMPTY);
     }
 }
 
@@ -527,111 +802,63 @@ void AudioService::PlaySound(const std::string_view& ogg) {
         codec_->EnableOutput(true);
     }
 
-    const uint8_t* buf = reinterpret_cast<const uint8_t*>(ogg.data());
-    size_t size = ogg.size();
-    size_t offset = 0;
-
-    auto find_page = [&](size_t start)->size_t {
-        for (size_t i = start; i + 4 <= size; ++i) {
-            if (buf[i] == 'O' && buf[i+1] == 'g' && buf[i+2] == 'g' && buf[i+3] == 'S') return i;
-        }
-        return static_cast<size_t>(-1);
-    };
-
-    bool seen_head = false;
-    bool seen_tags = false;
-    int sample_rate = 16000; // 默认值
-
-    while (true) {
-        size_t pos = find_page(offset);
-        if (pos == static_cast<size_t>(-1)) break;
-        offset = pos;
-        if (offset + 27 > size) break;
-
-        const uint8_t* page = buf + offset;
-        uint8_t page_segments = page[26];
-        size_t seg_table_off = offset + 27;
-        if (seg_table_off + page_segments > size) break;
-
-        size_t body_size = 0;
-        for (size_t i = 0; i < page_segments; ++i) body_size += page[27 + i];
-
-        size_t body_off = seg_table_off + page_segments;
-        if (body_off + body_size > size) break;
-
-        // Parse packets using lacing
-        size_t cur = body_off;
-        size_t seg_idx = 0;
-        while (seg_idx < page_segments) {
-            size_t pkt_len = 0;
-            size_t pkt_start = cur;
-            bool continued = false;
-            do {
-                uint8_t l = page[27 + seg_idx++];
-                pkt_len += l;
-                cur += l;
-                continued = (l == 255);
-            } while (continued && seg_idx < page_segments);
-
-            if (pkt_len == 0) continue;
-            const uint8_t* pkt_ptr = buf + pkt_start;
-
-            if (!seen_head) {
-                // 解析OpusHead包
-                if (pkt_len >= 19 && std::memcmp(pkt_ptr, "OpusHead", 8) == 0) {
-                    seen_head = true;
-                    
-                    // OpusHead结构：[0-7] "OpusHead", [8] version, [9] channel_count, [10-11] pre_skip
-                    // [12-15] input_sample_rate, [16-17] output_gain, [18] mapping_family
-                    if (pkt_len >= 12) {
-                        uint8_t version = pkt_ptr[8];
-                        uint8_t channel_count = pkt_ptr[9];
-                        
-                        if (pkt_len >= 16) {
-                            // 读取输入采样率 (little-endian)
-                            sample_rate = pkt_ptr[12] | (pkt_ptr[13] << 8) | 
-                                        (pkt_ptr[14] << 16) | (pkt_ptr[15] << 24);
-                            ESP_LOGI(TAG, "OpusHead: version=%d, channels=%d, sample_rate=%d", 
-                                   version, channel_count, sample_rate);
-                        }
-                    }
-                }
-                continue;
-            }
-            if (!seen_tags) {
-                // Expect OpusTags in second packet
-                if (pkt_len >= 8 && std::memcmp(pkt_ptr, "OpusTags", 8) == 0) {
-                    seen_tags = true;
-                }
-                continue;
-            }
+    auto sound = prompt_sounds_.Get(ogg);
+    if (sound == nullptr) {
+        return;
+    }
+    prompt_request_time_us_ = esp_timer_get_time();
 
-            // Audio packet (Opus)
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->sample_rate = sample_rate;
-            packet->frame_duration = 60;
-            packet->payload.resize(pkt_len);
-            std::memcpy(packet->payload.data(), pkt_ptr, pkt_len);
-            PushPacketToDecodeQueue(std::move(packet), true);
+    if (sound->pcm != nullptr) {
+        const PromptSound* expected = nullptr;
+        if (pending_prompt_.compare_exchange_strong(expected, sound)) {
+            xEventGroupSetBits(event_group_, AS_EVENT_DECODE_QUEUE_NOT_EMPTY);
+            return;
         }
+        // Another decoded prompt has not started yet, this one is queued behind it as packets
+    }
 
-        offset = body_off + body_size;
+    for (auto& [offset, length] : sound->packets) {
+        auto packet = GetAudioStreamPacketPool().Acquire();
+        packet->sample_rate = sound->sample_rate;
+        packet->frame_duration = PROMPT_SOUND_FRAME_DURATION_MS;
+        packet->timestamp = 0;
+        packet->sequence = 0;
+        packet->trace = {};
+        packet->payload.assign(sound->data + offset, sound->data + offset + length);
+        PushPacketToDecodeQueue(std::move(packet), true);
     }
 }
 
+void AudioService::PreloadSound(const std::string_view& ogg, bool decode) {
+    prompt_sounds_.Preload(ogg, decode, codec_->output_sample_rate());
+}
+
 bool AudioService::IsIdle() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
+    // The decode queue and the pending prompt are read first, the decode task marks itself busy before taking from them
+    return audio_encode_queue_.Empty() && audio_decode_queue_.Empty() && pending_prompt_.load() == nullptr &&
+        decoder_idle_.load() && audio_playback_queue_.Empty() && audio_testing_queue_.Empty();
 }
 
 void AudioService::ResetDecoder() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    opus_decoder_->ResetState();
-    timestamp_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+    /* The consumers drop the discarded items. The opus decode task resets the decoder when it pops the
+       empty packet queued behind them, so whatever is pushed after this call is kept. */
+    decoder_reset_requested_ = true;
+    timestamp_queue_.Discard();
+    audio_playback_queue_.Discard();
+    audio_testing_queue_.Discard();
+    {
+        std::lock_guard<std::mutex> lock(audio_decode_producer_mutex_);
+        audio_decode_queue_.Discard();
+        xEventGroupSetBits(event_group_, AS_EVENT_DECODE_QUEUE_NOT_EMPTY);
+        while (!audio_decode_queue_.Push(AudioStreamPacketPtr()) && !service_stopped_) {
+            /* Full of discarded packets, the decode task drops them while a reset is pending */
+            xEventGroupClearBits(event_group_, AS_EVENT_DECODE_QUEUE_NOT_FULL);
+            if (audio_decode_queue_.Full()) {
+                xEventGroupWaitBits(event_group_, AS_EVENT_DECODE_QUEUE_NOT_FULL, pdFALSE, pdFALSE, pdMS_TO_TICKS(100));
+            }
+        }
+    }
+    xEventGroupSetBits(event_group_, AS_EVENT_DECODE_QUEUE_NOT_EMPTY | AS_EVENT_PLAYBACK_NOT_EMPTY);
 }
 
 void AudioService::CheckAndUpdateAudioPowerState() {
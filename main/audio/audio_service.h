@@ -2,8 +2,7 @@
 #define AUDIO_SERVICE_H
 
 #include <memory>
-#include <deque>
-#include <condition_variable>
+#include <atomic>
 #include <chrono>
 #include <mutex>
 
@@ -15,24 +14,40 @@
 
 #include <opus_encoder.h>
 #include <opus_decoder.h>
-#include <opus_resampler.h>
 
 #include "audio_codec.h"
 #include "audio_processor.h"
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
 #include "protocol.h"
+#include "spsc_ring.h"
+#include "object_pool.h"
+#include "jitter_buffer.h"
+#include "polyphase_resampler.h"
+#include "opus_encoder_tuner.h"
+#include "audio_latency_tracer.h"
+#include "playback_dsp.h"
+#include "prompt_sound_cache.h"
 
 
 /*
  * There are two types of audio data flow:
  * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
- * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
+ * 2. (Server) -> {Decode Queue} -> [Jitter Buffer] -> [Opus Decoder] -> [Playback DSP] -> {Playback Queue} -> (Speaker)
  *
- * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
+ * Prompt sounds take the second path from the decode queue on, except the preloaded ones that are
+ * kept decoded: the decode task copies those into the playback queue ahead of everything else.
+ *
+ * We use one task for MIC / Speaker / Processors, and one task each for the Opus Encoder and the Opus Decoder,
+ * so in full-duplex mode the uplink and the downlink keep their own frame deadlines. The core each codec task
+ * runs on is set with CONFIG_OPUS_ENCODE_TASK_CORE / CONFIG_OPUS_DECODE_TASK_CORE.
  * 
  * Decode Queue and Send Queue are the main queues, because Opus packets are quite smaller than PCM packets.
- * 
+ *
+ * Every queue is a lock-free SPSC ring with its own "not empty" / "not full" event bits, so a task
+ * only wakes up for the queue it is waiting on. Queues with more than one producer serialize the
+ * producers with a mutex that the consumer never takes.
+ *
  */
 
 #define OPUS_FRAME_DURATION_MS 60
@@ -42,6 +57,13 @@
 #define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
 #define MAX_TIMESTAMPS_IN_QUEUE 3
+// Enough for full encode and playback queues, plus the tasks being encoded, decoded and played
+#define AUDIO_TASK_POOL_SIZE (MAX_ENCODE_TASKS_IN_QUEUE + MAX_PLAYBACK_TASKS_IN_QUEUE + 4)
+
+// Speech onset detection on the wake word input, see DetectSpeechOnset()
+#define SPEECH_ONSET_MIN_LEVEL 200
+#define SPEECH_ONSET_RATIO 4
+#define SPEECH_ONSET_CHUNKS 3
 
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
@@ -51,12 +73,20 @@
 #define AS_EVENT_WAKE_WORD_RUNNING          (1 << 1)
 #define AS_EVENT_AUDIO_PROCESSOR_RUNNING    (1 << 2)
 #define AS_EVENT_PLAYBACK_NOT_EMPTY         (1 << 3)
+#define AS_EVENT_PLAYBACK_NOT_FULL          (1 << 4)
+#define AS_EVENT_ENCODE_QUEUE_NOT_EMPTY     (1 << 5)
+#define AS_EVENT_ENCODE_QUEUE_NOT_FULL      (1 << 6)
+#define AS_EVENT_DECODE_QUEUE_NOT_EMPTY     (1 << 7)
+#define AS_EVENT_DECODE_QUEUE_NOT_FULL      (1 << 8)
+#define AS_EVENT_SEND_QUEUE_NOT_FULL        (1 << 9)
 
 struct AudioServiceCallbacks {
     std::function<void(void)> on_send_queue_available;
     std::function<void(const std::string&)> on_wake_word_detected;
     std::function<void(bool)> on_vad_change;
     std::function<void(void)> on_audio_testing_queue_full;
+    // Microphone level jumped while waiting for the wake word, called from the audio input task
+    std::function<void(void)> on_speech_onset;
 };
 
 
@@ -70,13 +100,23 @@ struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
     uint32_t timestamp;
+    AudioFrameTrace trace;
 };
 
+// Tasks go back to the pool with their pcm capacity when the pointer is destroyed
+using AudioTaskPtr = PooledPtr<AudioTask>;
+
 struct DebugStatistics {
     uint32_t input_count = 0;
     uint32_t decode_count = 0;
     uint32_t encode_count = 0;
     uint32_t playback_count = 0;
+    // Packets and tasks the pools had to take from the heap, plus pcm buffers that had to grow.
+    // Stays flat once the pools and buffers are warm.
+    uint32_t heap_alloc_count = 0;
+    // Frames that took the codec task longer than a frame duration, counted per stage
+    uint32_t encode_deadline_misses = 0;
+    uint32_t decode_deadline_misses = 0;
 };
 
 class AudioService {
@@ -88,13 +128,16 @@ public:
     void Start();
     void Stop();
     void EncodeWakeWord();
-    std::unique_ptr<AudioStreamPacket> PopWakeWordPacket();
+    AudioStreamPacketPtr PopWakeWordPacket();
     const std::string& GetLastWakeWord() const;
     bool IsVoiceDetected() const { return voice_detected_; }
     bool IsIdle();
     bool IsWakeWordRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_WAKE_WORD_RUNNING; }
     bool IsAudioProcessorRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_AUDIO_PROCESSOR_RUNNING; }
     bool IsAfeWakeWord();
+    // Uplink encoder complexity picked by the tuner, advertised in the hello audio_params
+    int GetEncoderComplexity() const { return encoder_tuner_.complexity(); }
+    AudioLatencyTracer& GetLatencyTracer() { return latency_tracer_; }
 
     void EnableWakeWordDetection(bool enable);
     void EnableVoiceProcessing(bool enable);
@@ -103,9 +146,11 @@ public:
 
     void SetCallbacks(AudioServiceCallbacks& callbacks);
 
-    bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
-    std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
+    bool PushPacketToDecodeQueue(AudioStreamPacketPtr packet, bool wait = false);
+    AudioStreamPacketPtr PopPacketFromSendQueue();
     void PlaySound(const std::string_view& sound);
+    // Indexes a prompt sound at boot instead of on first use, short ones are also kept decoded if decode is set
+    void PreloadSound(const std::string_view& sound, bool decode);
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
     void SetModelsList(srmodel_list_t* models_list);
@@ -118,33 +163,63 @@ private:
     std::unique_ptr<AudioDebugger> audio_debugger_;
     std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
     std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
-    OpusResampler input_resampler_;
-    OpusResampler reference_resampler_;
-    OpusResampler output_resampler_;
+    PolyphaseResampler input_resampler_;
+    PolyphaseResampler output_resampler_;
     DebugStatistics debug_statistics_;
+    AudioLatencyTracer latency_tracer_;
     srmodel_list_t* models_list_ = nullptr;
 
     EventGroupHandle_t event_group_;
 
     // Audio encode / decode
+    ObjectPool<AudioTask> audio_task_pool_{AUDIO_TASK_POOL_SIZE};
+    // Only touched by the opus decode task
+    JitterBuffer jitter_buffer_;
+    PlaybackDsp playback_dsp_;
+    std::vector<uint8_t> concealment_payload_;
+    const PromptSound* playing_prompt_ = nullptr;
+    size_t prompt_position_ = 0;
+    // Downlink counters the decode task publishes for the encoder tuner
+    std::atomic<uint32_t> downlink_received_ = 0;
+    std::atomic<uint32_t> downlink_lost_ = 0;
+    // Set by the decode task while its jitter buffer is empty and no prompt is playing, IsIdle() reads
+    // this instead of the buffer and playing_prompt_
+    std::atomic<bool> decoder_idle_ = true;
+    // Only touched by the opus encode task
+    OpusEncoderTuner encoder_tuner_{OPUS_FRAME_DURATION_MS};
+    std::atomic<bool> encoder_tuner_reset_requested_ = false;
     TaskHandle_t audio_input_task_handle_ = nullptr;
     TaskHandle_t audio_output_task_handle_ = nullptr;
-    TaskHandle_t opus_codec_task_handle_ = nullptr;
-    std::mutex audio_queue_mutex_;
-    std::condition_variable audio_queue_cv_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
+    TaskHandle_t opus_encode_task_handle_ = nullptr;
+    TaskHandle_t opus_decode_task_handle_ = nullptr;
+    SpscRing<AudioStreamPacketPtr, MAX_DECODE_PACKETS_IN_QUEUE> audio_decode_queue_;
+    SpscRing<AudioStreamPacketPtr, MAX_SEND_PACKETS_IN_QUEUE> audio_send_queue_;
+    SpscRing<AudioStreamPacketPtr, AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS> audio_testing_queue_;
+    SpscRing<AudioTaskPtr, MAX_ENCODE_TASKS_IN_QUEUE> audio_encode_queue_;
+    SpscRing<AudioTaskPtr, MAX_PLAYBACK_TASKS_IN_QUEUE> audio_playback_queue_;
     // For server AEC
-    std::deque<uint32_t> timestamp_queue_;
+    SpscRing<uint32_t, MAX_TIMESTAMPS_IN_QUEUE + 1> timestamp_queue_;
+    // Only producers of multi-producer queues take these, never the consumer
+    std::mutex audio_encode_producer_mutex_;
+    std::mutex audio_decode_producer_mutex_;
+    std::atomic<bool> decoder_reset_requested_ = false;
+    std::atomic<uint32_t> pcm_allocations_ = 0;
+    PromptSoundCache prompt_sounds_;
+    // A decoded prompt sound handed to the decode task
+    std::atomic<const PromptSound*> pending_prompt_ = nullptr;
+    // When the last prompt sound was asked for, 0 once its first frame is in the playback queue
+    std::atomic<int64_t> prompt_request_time_us_ = 0;
 
     bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
     bool voice_detected_ = false;
     bool service_stopped_ = true;
     bool audio_input_need_warmup_ = false;
+    // Only touched by the audio input task, read into again for every frame
+    std::vector<int16_t> wake_word_input_;
+    std::vector<int16_t> processor_input_;
+    uint32_t onset_noise_floor_q4_ = 0;
+    int onset_loud_chunks_ = 0;
 
     esp_timer_handle_t audio_power_timer_ = nullptr;
     std::chrono::steady_clock::time_point last_input_time_;
@@ -152,10 +227,14 @@ private:
 
     void AudioInputTask();
     void AudioOutputTask();
-    void OpusCodecTask();
-    void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
+    void OpusEncodeTask();
+    void OpusDecodeTask();
+    void PushTaskToEncodeQueue(AudioTaskPtr task, AudioTaskType type, int64_t capture_time_us);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
+    bool ConcealLostFrame(std::vector<int16_t>& pcm);
+    bool PushPromptFrame();
     void CheckAndUpdateAudioPowerState();
+    void DetectSpeechOnset(const std::vector<int16_t>& data);
 };
 
 #endif
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "no_audio_codec.h"
+#include "audio_channels.h"
 
 #include <esp_log.h>
 #include <cmath>
@@ -349,11 +350,7 @@ int NoAudioCodecSimplexPdm::Read(int16_t* dest, int samples) {
 
     samples = bytes_read / sizeof(int16_t);
     if (input_gain_ > 0) {
-        int gain_factor = (int)input_gain_;
-        for (int i = 0; i < samples; i++) {
-            int32_t amplified = dest[i] * gain_factor;
-            dest[i] = (amplified > INT16_MAX) ? INT16_MAX : (amplified < -INT16_MAX) ? -INT16_MAX : (int16_t)amplified;
-        }
+        audio_channels::ApplyGain(dest, samples, std::lround(input_gain_ * AUDIO_GAIN_UNITY));
     }
     return samples;
 }
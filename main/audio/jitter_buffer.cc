@@ -0,0 +1,216 @@
+#include "jitter_buffer.h"
+
+#include <algorithm>
+
+JitterBuffer::JitterBuffer() {
+    slots_.resize(JITTER_BUFFER_CAPACITY);
+    bypass_.resize(JITTER_BUFFER_CAPACITY);
+    statistics_.target_depth = 1;
+}
+
+void JitterBuffer::Put(AudioStreamPacketPtr packet, int64_t now_us) {
+    statistics_.received++;
+
+    uint32_t sequence = packet->sequence;
+    if (sequence == 0) {
+        if (sequenced_) {
+            // A local prompt in the middle of a sequenced stream
+            Bypass(std::move(packet));
+            return;
+        }
+        sequence = started_ ? highest_sequence_ + 1 : 1;
+    } else if (!sequenced_) {
+        // The numbers given by arrival order so far are not the transport's, play those packets first
+        sequenced_ = true;
+        for (; count_ > 0; next_sequence_++) {
+            auto& slot = Slot(next_sequence_);
+            if (slot) {
+                Bypass(std::move(slot));
+                count_--;
+            }
+        }
+        started_ = false;
+        buffering_ = true;
+        gap_since_us_ = -1;
+        has_transit_base_ = false;
+    }
+
+    if (packet->frame_duration > 0) {
+        frame_duration_ms_ = packet->frame_duration;
+    }
+    if (!started_) {
+        started_ = true;
+        next_sequence_ = sequence;
+        highest_sequence_ = sequence;
+    }
+
+    int32_t offset = static_cast<int32_t>(sequence - next_sequence_);
+    if (offset < 0) {
+        if (-offset > static_cast<int32_t>(slots_.size())) {
+            // Far behind what we have played, the server has restarted the stream
+            Reset();
+            Put(std::move(packet), now_us);
+        } else {
+            statistics_.late++;
+        }
+        return;
+    }
+    if (offset >= static_cast<int32_t>(slots_.size())) {
+        // Too far ahead to fit, give up on everything before it
+        statistics_.lost += offset - static_cast<int32_t>(count_);
+        for (auto& slot : slots_) {
+            slot.reset();
+        }
+        count_ = 0;
+        next_sequence_ = sequence;
+        gap_since_us_ = -1;
+    }
+
+    auto& slot = Slot(sequence);
+    if (slot) {
+        statistics_.duplicate++;
+        return;
+    }
+
+    UpdateJitter(sequence, now_us);
+    if (count_ == 0 && buffering_) {
+        buffering_since_us_ = now_us;
+    }
+    slot = std::move(packet);
+    count_++;
+    if (static_cast<int32_t>(sequence - highest_sequence_) > 0) {
+        highest_sequence_ = sequence;
+    }
+    UpdateGap(now_us);
+    statistics_.depth = count_;
+}
+
+int64_t JitterBuffer::GetWaitTimeUs(int64_t now_us) const {
+    if (bypass_count_ > 0) {
+        return 0;
+    }
+    if (count_ == 0) {
+        return -1;
+    }
+
+    int64_t deadline;
+    if (Slot(next_sequence_)) {
+        // Build up the target depth again after running dry
+        if (!buffering_ || count_ >= statistics_.target_depth) {
+            return 0;
+        }
+        deadline = buffering_since_us_ + target_delay_us();
+    } else {
+        // Give the missing packet at least one frame to arrive out of order
+        if (count_ > statistics_.target_depth) {
+            return 0;
+        }
+        deadline = gap_since_us_ + target_delay_us() + frame_duration_ms_ * 1000;
+    }
+    return std::max<int64_t>(deadline - now_us, 0);
+}
+
+bool JitterBuffer::Ready(int64_t now_us) const {
+    return GetWaitTimeUs(now_us) == 0;
+}
+
+JitterBufferResult JitterBuffer::Get(AudioStreamPacketPtr& packet, int64_t now_us) {
+    if (!Ready(now_us)) {
+        return kJitterBufferNotReady;
+    }
+
+    if (bypass_count_ > 0) {
+        // Not part of the stream, played as they come
+        packet = std::move(bypass_[bypass_head_]);
+        bypass_head_ = (bypass_head_ + 1) % bypass_.size();
+        bypass_count_--;
+        return kJitterBufferPacket;
+    }
+
+    JitterBufferResult result;
+    auto& slot = Slot(next_sequence_);
+    if (slot) {
+        packet = std::move(slot);
+        count_--;
+        gap_since_us_ = -1;
+        result = kJitterBufferPacket;
+    } else {
+        statistics_.lost++;
+        result = kJitterBufferLost;
+    }
+    next_sequence_++;
+
+    buffering_ = (count_ == 0);
+    UpdateGap(now_us);
+    statistics_.depth = count_;
+    return result;
+}
+
+void JitterBuffer::Reset() {
+    for (auto& slot : slots_) {
+        slot.reset();
+    }
+    for (auto& packet : bypass_) {
+        packet.reset();
+    }
+    count_ = 0;
+    bypass_head_ = 0;
+    bypass_count_ = 0;
+    started_ = false;
+    sequenced_ = false;
+    buffering_ = true;
+    gap_since_us_ = -1;
+    has_transit_base_ = false;
+
+    // Keep the jitter estimate, the network is likely the same for the next stream
+    auto target_depth = statistics_.target_depth;
+    auto jitter_ms = statistics_.jitter_ms;
+    statistics_ = {};
+    statistics_.target_depth = target_depth;
+    statistics_.jitter_ms = jitter_ms;
+}
+
+void JitterBuffer::Bypass(AudioStreamPacketPtr packet) {
+    if (bypass_count_ == bypass_.size()) {
+        // Full() keeps the caller from getting here
+        return;
+    }
+    bypass_[(bypass_head_ + bypass_count_) % bypass_.size()] = std::move(packet);
+    bypass_count_++;
+}
+
+void JitterBuffer::UpdateJitter(uint32_t sequence, int64_t now_us) {
+    int64_t frame_us = frame_duration_ms_ * 1000;
+
+    // Transit time up to a constant offset. The fastest packet seen is the baseline, it slowly
+    // drifts up so that a clock skew between server and device is forgotten over time.
+    int64_t transit = now_us - static_cast<int64_t>(sequence) * frame_us;
+    if (!has_transit_base_) {
+        transit_base_us_ = transit;
+        has_transit_base_ = true;
+    } else {
+        transit_base_us_ = std::min(transit_base_us_ + frame_us / 128, transit);
+    }
+
+    // Grow quickly when packets are late, shrink slowly when the network calms down
+    int64_t lateness = transit - transit_base_us_;
+    if (lateness > jitter_us_) {
+        jitter_us_ += (lateness - jitter_us_) / 2;
+    } else {
+        jitter_us_ -= (jitter_us_ - lateness) / 64;
+    }
+    jitter_us_ = std::min<int64_t>(jitter_us_, (JITTER_BUFFER_MAX_TARGET_DEPTH - 1) * frame_us);
+
+    statistics_.jitter_ms = jitter_us_ / 1000;
+    statistics_.target_depth = 1 + (jitter_us_ + frame_us - 1) / frame_us;
+}
+
+void JitterBuffer::UpdateGap(int64_t now_us) {
+    if (count_ > 0 && !Slot(next_sequence_)) {
+        if (gap_since_us_ < 0) {
+            gap_since_us_ = now_us;
+        }
+    } else {
+        gap_since_us_ = -1;
+    }
+}
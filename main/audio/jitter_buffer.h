@@ -0,0 +1,87 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "protocol.h"
+
+#define JITTER_BUFFER_CAPACITY 32
+#define JITTER_BUFFER_MAX_TARGET_DEPTH 8
+
+struct JitterBufferStatistics {
+    uint32_t received = 0;
+    uint32_t late = 0;          // Arrived after their slot was played or concealed
+    uint32_t duplicate = 0;
+    uint32_t lost = 0;          // Never arrived in time, handed to the decoder for concealment
+    uint32_t depth = 0;         // Packets currently buffered
+    uint32_t target_depth = 0;
+    uint32_t jitter_ms = 0;     // Estimated arrival lateness
+};
+
+enum JitterBufferResult {
+    kJitterBufferNotReady,
+    kJitterBufferPacket,
+    kJitterBufferLost,
+};
+
+/*
+ * Reorders downlink packets by sequence number and releases them at the playout rate.
+ *
+ * The arrival lateness of each packet is compared with its sequence number to estimate the network
+ * jitter, which sets how many packets are held back (the target depth). A missing packet is waited
+ * for until the target depth is reached or the jitter estimate has elapsed, then it is reported
+ * as lost so that the decoder can conceal it.
+ *
+ * Packets without a sequence number (0) are numbered in arrival order, as long as no sequenced
+ * packet was seen since the last reset. After that they bypass the reordering and are released
+ * right away, so a prompt played during an MQTT stream cannot take the number of a real packet.
+ * Not thread safe, the buffer is owned by the opus codec task.
+ */
+class JitterBuffer {
+public:
+    JitterBuffer();
+
+    bool Full() const { return count_ + bypass_count_ >= slots_.size(); }
+    bool Empty() const { return count_ == 0 && bypass_count_ == 0; }
+
+    void Put(AudioStreamPacketPtr packet, int64_t now_us);
+    bool Ready(int64_t now_us) const;
+    JitterBufferResult Get(AudioStreamPacketPtr& packet, int64_t now_us);
+    // Microseconds until Get() may return something, or -1 if it has to wait for a new packet
+    int64_t GetWaitTimeUs(int64_t now_us) const;
+    void Reset();
+
+    const JitterBufferStatistics& statistics() const { return statistics_; }
+
+private:
+    std::vector<AudioStreamPacketPtr> slots_;
+    size_t count_ = 0;
+    bool started_ = false;
+    bool sequenced_ = false;            // The stream carries transport sequence numbers
+    bool buffering_ = true;
+    uint32_t next_sequence_ = 0;
+    uint32_t highest_sequence_ = 0;
+    int frame_duration_ms_ = 60;
+    int64_t buffering_since_us_ = 0;
+    int64_t gap_since_us_ = -1;
+
+    bool has_transit_base_ = false;
+    int64_t transit_base_us_ = 0;
+    int64_t jitter_us_ = 0;
+    JitterBufferStatistics statistics_;
+
+    // Unsequenced packets that arrived during a sequenced stream, in arrival order
+    std::vector<AudioStreamPacketPtr> bypass_;
+    size_t bypass_head_ = 0;
+    size_t bypass_count_ = 0;
+
+    AudioStreamPacketPtr& Slot(uint32_t sequence) { return slots_[sequence % slots_.size()]; }
+    const AudioStreamPacketPtr& Slot(uint32_t sequence) const { return slots_[sequence % slots_.size()]; }
+    void Bypass(AudioStreamPacketPtr packet);
+    void UpdateJitter(uint32_t sequence, int64_t now_us);
+    void UpdateGap(int64_t now_us);
+    int64_t target_delay_us() const { return jitter_us_; }
+};
+
+#endif // JITTER_BUFFER_H
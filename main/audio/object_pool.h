@@ -0,0 +1,91 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+template <typename T>
+class ObjectPool;
+
+template <typename T>
+struct PoolRecycler {
+    ObjectPool<T>* pool = nullptr;
+
+    void operator()(T* object) const {
+        if (pool != nullptr) {
+            pool->Recycle(object);
+        } else {
+            delete object;
+        }
+    }
+};
+
+template <typename T>
+using PooledPtr = std::unique_ptr<T, PoolRecycler<T>>;
+
+/*
+ * A bounded free list of heap objects.
+ *
+ * Destroying a PooledPtr hands the object back to the pool instead of freeing it, so the object
+ * and the capacity of the buffers it owns are reused by the next Acquire(). Once the pool has
+ * warmed up, the steady state makes no heap calls. Objects released while the pool is full are
+ * deleted.
+ *
+ * Recycled objects keep their previous contents, the caller of Acquire() must set every field.
+ */
+template <typename T>
+class ObjectPool {
+public:
+    explicit ObjectPool(size_t capacity) : capacity_(capacity), free_(new T*[capacity]) {}
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    ~ObjectPool() {
+        for (size_t i = 0; i < free_count_; i++) {
+            delete free_[i];
+        }
+    }
+
+    PooledPtr<T> Acquire() {
+        T* object = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (free_count_ > 0) {
+                object = free_[--free_count_];
+            }
+        }
+        if (object == nullptr) {
+            object = new T();
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return PooledPtr<T>(object, PoolRecycler<T>{this});
+    }
+
+    // Number of objects taken from the heap since the pool was created
+    uint32_t allocations() const { return allocations_.load(std::memory_order_relaxed); }
+
+private:
+    friend struct PoolRecycler<T>;
+
+    void Recycle(T* object) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (free_count_ < capacity_) {
+                free_[free_count_++] = object;
+                return;
+            }
+        }
+        delete object;
+    }
+
+    std::mutex mutex_;
+    const size_t capacity_;
+    std::unique_ptr<T*[]> free_;
+    size_t free_count_ = 0;
+    std::atomic<uint32_t> allocations_{0};
+};
+
+#endif // OBJECT_POOL_H
@@ -0,0 +1,72 @@
+#include "opus_encoder_tuner.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "OpusEncoderTuner"
+
+void OpusEncoderTuner::Reset() {
+    ceiling_ = OPUS_ENCODER_MAX_COMPLEXITY;
+    stable_windows_ = 0;
+    frames_ = 0;
+    busy_us_ = 0;
+    max_send_queue_depth_ = 0;
+}
+
+bool OpusEncoderTuner::OnFrameEncoded(uint32_t encode_us, size_t send_queue_depth, size_t send_queue_size,
+    uint32_t packets_received, uint32_t packets_lost, int64_t now_us) {
+    if (OPUS_ENCODER_MAX_COMPLEXITY == 0) {
+        return false;
+    }
+
+    if (frames_ == 0) {
+        window_start_us_ = now_us - encode_us;
+        busy_us_ = 0;
+        max_send_queue_depth_ = 0;
+        window_received_ = packets_received;
+        window_lost_ = packets_lost;
+    }
+    busy_us_ += encode_us;
+    max_send_queue_depth_ = std::max(max_send_queue_depth_, send_queue_depth);
+    if (++frames_ < OPUS_TUNER_WINDOW_FRAMES) {
+        return false;
+    }
+    frames_ = 0;
+
+    int64_t wall_us = std::max<int64_t>(now_us - window_start_us_, 1);
+    if (wall_us > 2000LL * frame_duration_ms_ * OPUS_TUNER_WINDOW_FRAMES) {
+        // The uplink paused in between, e.g. while speaking, the load would look too low
+        return false;
+    }
+    uint32_t load = busy_us_ * 100 / wall_us;
+    // The jitter buffer counters restart with the decoder
+    uint32_t received = packets_received >= window_received_ ? packets_received - window_received_ : packets_received;
+    uint32_t lost = packets_lost >= window_lost_ ? packets_lost - window_lost_ : packets_lost;
+    uint32_t loss = received + lost == 0 ? 0 : lost * 100 / (received + lost);
+    bool queue_backed_up = max_send_queue_depth_ > send_queue_size / 4;
+
+    int complexity = complexity_.load(std::memory_order_relaxed);
+    int next = complexity;
+    if (load > OPUS_TUNER_HIGH_LOAD || queue_backed_up) {
+        stable_windows_ = 0;
+        if (complexity > 0) {
+            next = complexity - 1;
+            ceiling_ = next;
+        }
+    } else if (load < OPUS_TUNER_LOW_LOAD && max_send_queue_depth_ <= 1 && loss <= OPUS_TUNER_MAX_LOSS) {
+        if (++stable_windows_ >= OPUS_TUNER_STABLE_WINDOWS && complexity < ceiling_) {
+            stable_windows_ = 0;
+            next = complexity + 1;
+        }
+    } else {
+        stable_windows_ = 0;
+    }
+
+    if (next == complexity) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Complexity %d -> %d (load %lu%%, send queue %u, loss %lu%%)", complexity, next,
+        load, (unsigned)max_send_queue_depth_, loss);
+    complexity_.store(next, std::memory_order_relaxed);
+    return true;
+}
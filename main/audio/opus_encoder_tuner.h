@@ -0,0 +1,58 @@
+#ifndef OPUS_ENCODER_TUNER_H
+#define OPUS_ENCODER_TUNER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// The highest complexity worth trying on each target, 0 keeps the encoder at its fastest setting
+#if CONFIG_IDF_TARGET_ESP32P4
+#define OPUS_ENCODER_MAX_COMPLEXITY 6
+#elif CONFIG_IDF_TARGET_ESP32S3
+#define OPUS_ENCODER_MAX_COMPLEXITY 3
+#else
+#define OPUS_ENCODER_MAX_COMPLEXITY 0
+#endif
+
+#define OPUS_TUNER_WINDOW_FRAMES 16
+#define OPUS_TUNER_HIGH_LOAD 50         // Percent of wall time the encode task spends encoding
+#define OPUS_TUNER_LOW_LOAD 25
+#define OPUS_TUNER_STABLE_WINDOWS 4     // Quiet windows in a row before trying a higher complexity
+#define OPUS_TUNER_MAX_LOSS 2           // Percent of downlink packets lost
+
+/*
+ * Picks the uplink Opus complexity from what the opus encode task can afford.
+ *
+ * Every OPUS_TUNER_WINDOW_FRAMES encoded frames it compares the time spent encoding with the wall
+ * time of the window. A busy task, or a send queue the main loop is not keeping up
+ * with, lowers the complexity at once and caps it for the rest of the session. A quiet task on a
+ * healthy link raises it one step after OPUS_TUNER_STABLE_WINDOWS windows.
+ *
+ * Only the opus encode task calls into it, complexity() may be read from anywhere.
+ */
+class OpusEncoderTuner {
+public:
+    explicit OpusEncoderTuner(int frame_duration_ms) : frame_duration_ms_(frame_duration_ms) {}
+
+    // A new session starts, the complexity reached so far is kept
+    void Reset();
+    // Returns true when complexity() changed and should be applied to the encoder
+    bool OnFrameEncoded(uint32_t encode_us, size_t send_queue_depth, size_t send_queue_size,
+        uint32_t packets_received, uint32_t packets_lost, int64_t now_us);
+    int complexity() const { return complexity_.load(std::memory_order_relaxed); }
+
+private:
+    const int frame_duration_ms_;
+    std::atomic<int> complexity_{0};
+    int ceiling_ = OPUS_ENCODER_MAX_COMPLEXITY;
+    int stable_windows_ = 0;
+
+    int frames_ = 0;
+    int64_t window_start_us_ = 0;
+    uint64_t busy_us_ = 0;
+    size_t max_send_queue_depth_ = 0;
+    uint32_t window_received_ = 0;
+    uint32_t window_lost_ = 0;
+};
+
+#endif // OPUS_ENCODER_TUNER_H
@@ -0,0 +1,106 @@
+#include "playback_dsp.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstdlib>
+
+#define TAG "PlaybackDsp"
+
+void PlaybackDsp::Configure(int sample_rate) {
+    block_size_ = std::max(sample_rate * PLAYBACK_DSP_BLOCK_MS / 1000, 1);
+    delay_.assign(block_size_ * 2, 0);
+    Reset();
+}
+
+void PlaybackDsp::Reset() {
+    std::fill(delay_.begin(), delay_.end(), 0);
+    delay_pos_ = 0;
+    block_peak_ = 0;
+    last_block_peak_ = 0;
+    limiter_gain_ = PLAYBACK_DSP_UNITY;
+    limiter_target_ = PLAYBACK_DSP_UNITY;
+    limiter_step_ = 0;
+}
+
+void PlaybackDsp::UpdateGain(const std::vector<int16_t>& pcm) {
+#if CONFIG_PLAYBACK_LOUDNESS_NORMALIZATION
+    uint32_t sum = 0;
+    for (int16_t sample : pcm) {
+        sum += std::abs(sample);
+    }
+    int32_t mean = sum / pcm.size();
+    if (mean < PLAYBACK_DSP_GATE_LEVEL) {
+        return;
+    }
+
+    bool first = level_ == 0;
+    level_ = first ? mean : level_ + (mean - level_) / 4;
+    int32_t desired = std::clamp<int32_t>(PLAYBACK_DSP_TARGET_LEVEL * PLAYBACK_DSP_UNITY / level_,
+        PLAYBACK_DSP_MIN_GAIN, PLAYBACK_DSP_MAX_GAIN);
+    if (first) {
+        ESP_LOGI(TAG, "Speech level %ld, gain %ld/4096", level_, desired);
+        agc_gain_ = desired;
+    } else if (desired > agc_gain_) {
+        agc_gain_ = std::min(desired, agc_gain_ + agc_gain_ / 8);
+    } else {
+        agc_gain_ = std::max(desired, agc_gain_ - agc_gain_ / 4);
+    }
+#endif
+}
+
+int32_t PlaybackDsp::LimiterTarget(int32_t peak) {
+    return peak > PLAYBACK_DSP_CEILING ? PLAYBACK_DSP_CEILING * PLAYBACK_DSP_UNITY / peak : PLAYBACK_DSP_UNITY;
+}
+
+// Called when a block is written, the other half of the ring is played next
+void PlaybackDsp::StartBlock() {
+    limiter_gain_ = limiter_target_;
+    int32_t release = limiter_gain_ + ((PLAYBACK_DSP_UNITY - limiter_gain_) >> 6);
+    // Below the ceiling for the block about to be played and for the one after it
+    limiter_target_ = std::min({release, LimiterTarget(last_block_peak_), LimiterTarget(block_peak_)});
+    limiter_step_ = (limiter_target_ - limiter_gain_) / (int32_t)block_size_;
+    last_block_peak_ = block_peak_;
+    block_peak_ = 0;
+}
+
+int16_t PlaybackDsp::SoftClip(int32_t sample) {
+    int32_t magnitude = std::abs(sample);
+    if (magnitude <= PLAYBACK_DSP_CEILING) {
+        return sample;
+    }
+    const int32_t headroom = INT16_MAX - PLAYBACK_DSP_CEILING;
+    int32_t over = magnitude - PLAYBACK_DSP_CEILING;
+    int32_t bent = PLAYBACK_DSP_CEILING + over * headroom / (over + headroom);
+    return sample < 0 ? -bent : bent;
+}
+
+void PlaybackDsp::Process(std::vector<int16_t>& pcm) {
+    if (pcm.empty() || block_size_ == 0) {
+        return;
+    }
+
+    // The gain is ramped over the frame, in Q28 so the step is exact enough
+    int32_t start_gain = agc_gain_;
+    UpdateGain(pcm);
+    int32_t gain_q28 = start_gain * 65536;
+    int32_t gain_step = (agc_gain_ - start_gain) * 65536 / (int32_t)pcm.size();
+
+    const size_t ring_size = delay_.size();
+    for (auto& sample : pcm) {
+        int32_t in = (sample * (gain_q28 >> 16)) >> 12;
+        gain_q28 += gain_step;
+
+        int32_t out = (delay_[delay_pos_] * limiter_gain_) >> 12;
+        limiter_gain_ += limiter_step_;
+        sample = SoftClip(out);
+
+        delay_[delay_pos_] = in;
+        block_peak_ = std::max(block_peak_, std::abs(in));
+        if (++delay_pos_ % block_size_ == 0) {
+            if (delay_pos_ == ring_size) {
+                delay_pos_ = 0;
+            }
+            StartBlock();
+        }
+    }
+}
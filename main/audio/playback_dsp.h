@@ -0,0 +1,62 @@
+#ifndef PLAYBACK_DSP_H
+#define PLAYBACK_DSP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Gains are Q12, 4096 is 1.0
+#define PLAYBACK_DSP_UNITY 4096
+#define PLAYBACK_DSP_TARGET_LEVEL 2600      // Mean absolute level of normalized speech, about -22 dBFS RMS
+#define PLAYBACK_DSP_GATE_LEVEL 300         // Quieter frames are pauses, they do not move the loudness
+#define PLAYBACK_DSP_MIN_GAIN 1024          // -12 dB
+#define PLAYBACK_DSP_MAX_GAIN 12288         // +9.5 dB
+#define PLAYBACK_DSP_CEILING 29204          // -1 dBFS, the limiter keeps peaks below it
+#define PLAYBACK_DSP_BLOCK_MS 1             // Limiter block, the look-ahead is one block
+
+/*
+ * Levels decoded speech before it is played.
+ *
+ * 1. Loudness normalization (CONFIG_PLAYBACK_LOUDNESS_NORMALIZATION): the mean level of speech
+ *    frames is tracked and a gain between PLAYBACK_DSP_MIN_GAIN and PLAYBACK_DSP_MAX_GAIN brings
+ *    it to PLAYBACK_DSP_TARGET_LEVEL. The gain moves at most about 1 dB up or 2.5 dB down per
+ *    frame, ramped sample by sample.
+ * 2. Look-ahead limiter: the gain is already down when a peak above PLAYBACK_DSP_CEILING is
+ *    played, and recovers over about 64 ms. This delays the output by two blocks.
+ * 3. Soft clip: whatever is still above the ceiling bends towards full scale instead of wrapping.
+ *
+ * Fixed point only. Only the opus decode task calls into it.
+ */
+class PlaybackDsp {
+public:
+    void Configure(int sample_rate);
+    // A new stream starts, the limiter drops the delayed samples of the last one. The loudness
+    // is kept, the next answer is most likely in the same voice.
+    void Reset();
+    void Process(std::vector<int16_t>& pcm);
+
+    int gain() const { return agc_gain_; }
+
+private:
+    size_t block_size_ = 0;
+
+    // Loudness normalization
+    int32_t level_ = 0;         // Mean absolute level of speech, 0 before the first speech frame
+    int32_t agc_gain_ = PLAYBACK_DSP_UNITY;
+
+    // Limiter, a ring of two blocks of gained samples
+    std::vector<int32_t> delay_;
+    size_t delay_pos_ = 0;
+    int32_t block_peak_ = 0;        // Peak of the block being written
+    int32_t last_block_peak_ = 0;   // Peak of the last complete block, played after the current one
+    int32_t limiter_gain_ = PLAYBACK_DSP_UNITY;
+    int32_t limiter_target_ = PLAYBACK_DSP_UNITY;   // Reached at the end of the block being played
+    int32_t limiter_step_ = 0;
+
+    void UpdateGain(const std::vector<int16_t>& pcm);
+    void StartBlock();
+    static int32_t LimiterTarget(int32_t peak);
+    static int16_t SoftClip(int32_t sample);
+};
+
+#endif // PLAYBACK_DSP_H
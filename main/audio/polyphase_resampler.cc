@@ -0,0 +1,176 @@
+#include "polyphase_resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <esp_log.h>
+
+#define TAG "PolyphaseResampler"
+
+// Kaiser window shape, about 80 dB of stopband attenuation
+#define KAISER_BETA 8.0
+// Passband edge relative to the lower of the two Nyquist frequencies
+#define PASSBAND_RATIO 0.9
+
+static double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+/*
+ * The inner loop of the filter. Products are accumulated in 32 bits: a unity gain Q15 phase
+ * has a small absolute sum, so full scale input cannot overflow. Unrolled by four so the
+ * compiler can keep the accumulators in registers and use the MAC / SIMD units where the
+ * target has them.
+ */
+static inline int32_t DotProduct(const int16_t* x, const int16_t* h, size_t n) {
+    int32_t acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 += static_cast<int32_t>(x[i]) * h[i];
+        acc1 += static_cast<int32_t>(x[i + 1]) * h[i + 1];
+        acc2 += static_cast<int32_t>(x[i + 2]) * h[i + 2];
+        acc3 += static_cast<int32_t>(x[i + 3]) * h[i + 3];
+    }
+    for (; i < n; i++) {
+        acc0 += static_cast<int32_t>(x[i]) * h[i];
+    }
+    return acc0 + acc1 + acc2 + acc3;
+}
+
+static inline int16_t SaturateQ15(int32_t acc) {
+    acc = (acc + (1 << 14)) >> 15;
+    if (acc > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (acc < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return static_cast<int16_t>(acc);
+}
+
+void PolyphaseResampler::Configure(int input_sample_rate, int output_sample_rate, int channels) {
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+    channels_ = channels;
+
+    uint32_t divisor = std::gcd(input_sample_rate, output_sample_rate);
+    up_ = output_sample_rate / divisor;
+    down_ = input_sample_rate / divisor;
+    taps_ = POLYPHASE_RESAMPLER_BASE_TAPS;
+    if (down_ > up_) {
+        taps_ *= (down_ + up_ - 1) / up_;
+    }
+
+    // Prototype low-pass at the upsampled rate, cut off below the lower Nyquist frequency
+    size_t length = up_ * taps_;
+    double cutoff = PASSBAND_RATIO * 0.5 * std::min(input_sample_rate, output_sample_rate)
+        / (static_cast<double>(input_sample_rate) * up_);
+    double center = (length - 1) / 2.0;
+    double window_scale = 1.0 / BesselI0(KAISER_BETA);
+    std::vector<double> prototype(length);
+    for (size_t j = 0; j < length; j++) {
+        double t = j - center;
+        double sinc = (t == 0) ? 1.0 : std::sin(2.0 * M_PI * cutoff * t) / (2.0 * M_PI * cutoff * t);
+        double r = t / center;
+        double window = BesselI0(KAISER_BETA * std::sqrt(std::max(0.0, 1.0 - r * r))) * window_scale;
+        prototype[j] = 2.0 * cutoff * up_ * sinc * window;
+    }
+
+    // Split into phases, each scaled to exactly unity DC gain so no phase adds a ripple
+    coefficients_.assign(up_ * taps_, 0);
+    for (uint32_t p = 0; p < up_; p++) {
+        double sum = 0;
+        for (size_t t = 0; t < taps_; t++) {
+            sum += prototype[p + up_ * t];
+        }
+        int16_t* phase = &coefficients_[p * taps_];
+        int32_t total = 0;
+        size_t peak = 0;
+        for (size_t t = 0; t < taps_; t++) {
+            int32_t value = std::lround(prototype[p + up_ * t] / sum * 32768.0);
+            value = std::min<int32_t>(std::max<int32_t>(value, INT16_MIN), INT16_MAX);
+            phase[taps_ - 1 - t] = value;
+            total += value;
+            if (std::abs(value) > std::abs(phase[taps_ - 1 - peak])) {
+                peak = t;
+            }
+        }
+        // Put the rounding error on the largest tap, where it matters least
+        int32_t corrected = phase[taps_ - 1 - peak] + (32768 - total);
+        phase[taps_ - 1 - peak] = std::min<int32_t>(corrected, INT16_MAX);
+    }
+
+    history_.assign(channels_, std::vector<int16_t>(taps_ - 1, 0));
+    phase_ = 0;
+    ESP_LOGI(TAG, "Configured %d -> %d Hz, %d channels, %lu phases x %u taps", input_sample_rate, output_sample_rate,
+        channels, up_, (unsigned)taps_);
+}
+
+void PolyphaseResampler::Reset() {
+    for (auto& history : history_) {
+        history.assign(taps_ - 1, 0);
+    }
+    phase_ = 0;
+}
+
+size_t PolyphaseResampler::GetOutputSamples(size_t input_samples) const {
+    uint64_t end = static_cast<uint64_t>(input_samples / channels_) * up_;
+    if (end <= phase_) {
+        return 0;
+    }
+    return (end - phase_ + down_ - 1) / down_ * channels_;
+}
+
+size_t PolyphaseResampler::Process(const int16_t* input, size_t input_samples, int16_t* output) {
+    size_t frames = input_samples / channels_;
+    size_t output_samples = GetOutputSamples(input_samples);
+
+    // Append the new frames to each channel's history first, so output may overwrite input
+    for (int c = 0; c < channels_; c++) {
+        auto& history = history_[c];
+        history.resize(taps_ - 1 + frames);
+        int16_t* dst = history.data() + taps_ - 1;
+        const int16_t* src = input + c;
+        for (size_t i = 0; i < frames; i++, src += channels_) {
+            dst[i] = *src;
+        }
+    }
+
+    uint32_t position = phase_;
+    for (size_t n = 0; n < output_samples; n += channels_, position += down_) {
+        uint32_t index = position / up_;
+        const int16_t* h = &coefficients_[(position % up_) * taps_];
+        for (int c = 0; c < channels_; c++) {
+            // Window ends at input frame index, which sits at taps_ - 1 + index in the history
+            output[n + c] = SaturateQ15(DotProduct(history_[c].data() + index, h, taps_));
+        }
+    }
+    phase_ = position - frames * up_;
+
+    // Keep the last taps_ - 1 frames for the next call
+    for (auto& history : history_) {
+        memmove(history.data(), history.data() + frames, (taps_ - 1) * sizeof(int16_t));
+        history.resize(taps_ - 1);
+    }
+    return output_samples;
+}
+
+void PolyphaseResampler::Process(std::vector<int16_t>& data) {
+    size_t input_samples = data.size();
+    size_t output_samples = GetOutputSamples(input_samples);
+    if (output_samples > input_samples) {
+        data.resize(output_samples);
+    }
+    Process(data.data(), input_samples, data.data());
+    data.resize(output_samples);
+}
@@ -0,0 +1,54 @@
+#ifndef POLYPHASE_RESAMPLER_H
+#define POLYPHASE_RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Filter taps per phase when upsampling, scaled up with the decimation ratio when downsampling
+#define POLYPHASE_RESAMPLER_BASE_TAPS 16
+
+/*
+ * Streaming rational resampler for interleaved 16-bit PCM.
+ *
+ * The rate pair is reduced to L/M (e.g. 48k -> 16k is 1/3, 16k -> 44.1k is 441/160) and a
+ * Kaiser-windowed sinc is split into L phases of Q15 coefficients when the resampler is
+ * configured. Each output sample is then a single dot product over one phase, with no
+ * intermediate upsampled signal.
+ *
+ * All channels are resampled in one pass, so interleaved mic + reference input is handled
+ * without de-interleaving into temporaries. Filter history is kept between calls, so frames can
+ * be fed one by one without clicks at the boundaries.
+ */
+class PolyphaseResampler {
+public:
+    void Configure(int input_sample_rate, int output_sample_rate, int channels = 1);
+    void Reset();
+
+    int input_sample_rate() const { return input_sample_rate_; }
+    int output_sample_rate() const { return output_sample_rate_; }
+
+    // Interleaved samples produced for input_samples interleaved samples at the current phase
+    size_t GetOutputSamples(size_t input_samples) const;
+    // Returns the number of interleaved samples written. output may alias input.
+    size_t Process(const int16_t* input, size_t input_samples, int16_t* output);
+    // Resamples in place, resizing data to the output length
+    void Process(std::vector<int16_t>& data);
+
+private:
+    int input_sample_rate_ = 0;
+    int output_sample_rate_ = 0;
+    int channels_ = 1;
+    uint32_t up_ = 1;       // L
+    uint32_t down_ = 1;     // M
+    size_t taps_ = 0;       // Taps per phase
+    // Position of the next output sample in 1/L input samples, relative to the next input frame
+    uint32_t phase_ = 0;
+
+    // up_ phases of taps_ coefficients, each stored in reverse so it lines up with the history
+    std::vector<int16_t> coefficients_;
+    // Per channel: taps_ - 1 samples of history followed by the current input frames
+    std::vector<std::vector<int16_t>> history_;
+};
+
+#endif // POLYPHASE_RESAMPLER_H
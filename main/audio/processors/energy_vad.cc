@@ -0,0 +1,68 @@
+#include "energy_vad.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+void EnergyVad::Reset() {
+    speaking_ = false;
+    last_speech_frame_ = false;
+    silent_frames_ = 0;
+    noise_floor_ = 0;
+    last_low_ = 0;
+    last_high_ = 0;
+    last_sample_ = 0;
+}
+
+bool EnergyVad::Process(const int16_t* data, size_t samples, int frame_duration_ms) {
+    if (samples == 0) {
+        return false;
+    }
+
+    uint32_t low_sum = 0;
+    uint32_t high_sum = 0;
+    uint32_t crossings = 0;
+    int16_t previous = last_sample_;
+    for (size_t i = 0; i < samples; i++) {
+        int16_t sample = data[i];
+        low_sum += std::abs(sample);
+        high_sum += std::abs(sample - previous);
+        crossings += (sample ^ previous) < 0;
+        previous = sample;
+    }
+    last_sample_ = previous;
+
+    uint32_t low = low_sum / samples;
+    uint32_t high = high_sum / samples;
+    uint32_t zcr = crossings * 1000 / samples;
+    if (noise_floor_ == 0) {
+        noise_floor_ = std::max<uint32_t>(low, 1);
+    }
+
+    bool loud = low > ENERGY_VAD_MIN_LEVEL && low > noise_floor_ * ENERGY_VAD_RATIO;
+    bool speech_frame = loud && (zcr < ENERGY_VAD_MAX_ZCR || low > noise_floor_ * ENERGY_VAD_LOUD_RATIO);
+    bool onset = low > last_low_ * ENERGY_VAD_FLUX_RATIO || high > last_high_ * ENERGY_VAD_FLUX_RATIO;
+    last_low_ = low;
+    last_high_ = high;
+
+    // The floor follows quiet frames down at once and creeps up, slower still under speech
+    if (low < noise_floor_) {
+        noise_floor_ = std::max<uint32_t>(low, 1);
+    } else {
+        noise_floor_ += (low - noise_floor_) >> (speech_frame ? 7 : 4);
+    }
+
+    bool was_speaking = speaking_;
+    if (speech_frame) {
+        silent_frames_ = 0;
+        if (!speaking_ && (last_speech_frame_ || onset)) {
+            speaking_ = true;
+        }
+    } else {
+        silent_frames_++;
+        if (speaking_ && silent_frames_ * frame_duration_ms >= ENERGY_VAD_HANGOVER_MS) {
+            speaking_ = false;
+        }
+    }
+    last_speech_frame_ = speech_frame;
+    return speaking_ != was_speaking;
+}
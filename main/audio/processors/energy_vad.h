@@ -0,0 +1,44 @@
+#ifndef ENERGY_VAD_H
+#define ENERGY_VAD_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define ENERGY_VAD_MIN_LEVEL 120        // Mean absolute level below which nothing is speech
+#define ENERGY_VAD_RATIO 2              // Speech is this many times louder than the noise floor
+#define ENERGY_VAD_LOUD_RATIO 4         // Loud enough to be speech whatever the zero crossing rate
+#define ENERGY_VAD_MAX_ZCR 350          // Zero crossings per 1000 samples, noise hiss is around 500
+#define ENERGY_VAD_FLUX_RATIO 2         // A band getting this much louder in one frame is an onset
+#define ENERGY_VAD_HANGOVER_MS 600
+
+/*
+ * A cheap voice activity detector for builds without the AFE, a few operations per sample.
+ *
+ * Each frame is speech when its level is well above a slowly tracked noise floor and it is
+ * either voiced (low zero crossing rate) or very loud. Speech starts on two speech frames in a
+ * row, or on one with a spectral flux onset: the low band (level) or the high band (level of the
+ * first difference) jumping up from the frame before. It ends after ENERGY_VAD_HANGOVER_MS of
+ * frames that are not speech.
+ */
+class EnergyVad {
+public:
+    void Reset();
+    // Returns true when speaking() changed
+    bool Process(const int16_t* data, size_t samples, int frame_duration_ms);
+    bool speaking() const { return speaking_; }
+    // Frames in a row that were not speech
+    int silent_frames() const { return silent_frames_; }
+    // Mean absolute level of the background
+    uint32_t noise_floor() const { return noise_floor_; }
+
+private:
+    bool speaking_ = false;
+    bool last_speech_frame_ = false;
+    int silent_frames_ = 0;
+    uint32_t noise_floor_ = 0;      // 0 before the first frame
+    uint32_t last_low_ = 0;
+    uint32_t last_high_ = 0;
+    int16_t last_sample_ = 0;
+};
+
+#endif // ENERGY_VAD_H
@@ -1,10 +1,13 @@
 #include "no_audio_processor.h"
 #include <esp_log.h>
 
+#include "audio_channels.h"
+
 #define TAG "NoAudioProcessor"
 
 void NoAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srmodel_list_t* models_list) {
     codec_ = codec;
+    frame_duration_ms_ = frame_duration_ms;
     frame_samples_ = frame_duration_ms * 16000 / 1000;
 }
 
@@ -12,25 +15,61 @@ void NoAudioProcessor::Feed(std::vector<int16_t>&& data) {
     if (!is_running_ || !output_callback_) {
         return;
     }
+    if (vad_reset_requested_.exchange(false)) {
+        vad_.Reset();
+        held_count_ = 0;
+        suppressed_frames_ = 0;
+    }
 
     if (codec_->input_channels() == 2) {
         // If input channels is 2, we need to fetch the left channel data
-        auto mono_data = std::vector<int16_t>(data.size() / 2);
-        for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-            mono_data[i] = data[j];
+        size_t frames = data.size() / 2;
+        audio_channels::ExtractChannel(data.data(), frames, 2, 0, data.data());
+        data.resize(frames);
+    }
+
+    if (vad_.Process(data.data(), data.size(), frame_duration_ms_) && vad_state_change_callback_) {
+        vad_state_change_callback_(vad_.speaking());
+    }
+
+#if CONFIG_AUDIO_SILENCE_SUPPRESSION
+    /* The server still gets the first part of every pause, so its own endpointing keeps working */
+    if (!vad_.speaking() && vad_.silent_frames() * frame_duration_ms_ > CONFIG_AUDIO_SILENCE_SUPPRESSION_DELAY_MS &&
+        vad_.noise_floor() < SILENCE_SUPPRESSION_MAX_NOISE_FLOOR) {
+        if (held_count_ == held_frames_.size()) {
+            held_head_ = (held_head_ + 1) % held_frames_.size();
+            held_count_--;
+            suppressed_frames_++;
         }
-        output_callback_(std::move(mono_data));
-    } else {
-        output_callback_(std::move(data));
+        // Swapped, so the caller gets a buffer back to read the next frame into
+        held_frames_[(held_head_ + held_count_) % held_frames_.size()].swap(data);
+        held_count_++;
+        return;
+    }
+    SendHeldFrames();
+#endif
+    output_callback_(std::move(data));
+}
+
+void NoAudioProcessor::SendHeldFrames() {
+    for (; held_count_ > 0; held_count_--) {
+        output_callback_(std::move(held_frames_[held_head_]));
+        held_head_ = (held_head_ + 1) % held_frames_.size();
     }
 }
 
 void NoAudioProcessor::Start() {
+    vad_reset_requested_ = true;
     is_running_ = true;
 }
 
 void NoAudioProcessor::Stop() {
     is_running_ = false;
+#if CONFIG_AUDIO_SILENCE_SUPPRESSION
+    if (suppressed_frames_ > 0) {
+        ESP_LOGI(TAG, "Suppressed %lu silent frames", suppressed_frames_);
+    }
+#endif
 }
 
 bool NoAudioProcessor::IsRunning() {
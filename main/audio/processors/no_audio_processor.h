@@ -1,11 +1,19 @@
 #ifndef DUMMY_AUDIO_PROCESSOR_H
 #define DUMMY_AUDIO_PROCESSOR_H
 
+#include <array>
+#include <atomic>
 #include <vector>
 #include <functional>
 
 #include "audio_processor.h"
 #include "audio_codec.h"
+#include "energy_vad.h"
+
+// Silent frames held back while the uplink is suppressed, sent ahead of the next speech
+#define SILENCE_SUPPRESSION_PREROLL_FRAMES 2
+// Above this noise floor the detector misses quiet speech, so nothing is suppressed
+#define SILENCE_SUPPRESSION_MAX_NOISE_FLOOR 400
 
 class NoAudioProcessor : public AudioProcessor {
 public:
@@ -25,9 +33,20 @@ public:
 private:
     AudioCodec* codec_ = nullptr;
     int frame_samples_ = 0;
+    int frame_duration_ms_ = 0;
     std::function<void(std::vector<int16_t>&& data)> output_callback_;
     std::function<void(bool speaking)> vad_state_change_callback_;
     bool is_running_ = false;
+
+    // Only touched by the audio input task, apart from the reset request
+    EnergyVad vad_;
+    std::atomic<bool> vad_reset_requested_ = false;
+    std::array<std::vector<int16_t>, SILENCE_SUPPRESSION_PREROLL_FRAMES> held_frames_;
+    size_t held_head_ = 0;
+    size_t held_count_ = 0;
+    uint32_t suppressed_frames_ = 0;
+
+    void SendHeldFrames();
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "prompt_sound_cache.h"
+#include "polyphase_resampler.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <opus_decoder.h>
+#include <cstring>
+#include <memory>
+
+#define TAG "PromptSoundCache"
+
+PromptSoundCache::~PromptSoundCache() {
+    for (auto sound : sounds_) {
+        if (sound->pcm != nullptr) {
+            heap_caps_free(sound->pcm);
+        }
+        delete sound;
+    }
+}
+
+PromptSound* PromptSoundCache::Find(std::string_view ogg) {
+    for (auto sound : sounds_) {
+        if (sound->data == (const uint8_t*)ogg.data() && sound->size == ogg.size()) {
+            return sound;
+        }
+    }
+
+    auto sound = new PromptSound();
+    sound->data = (const uint8_t*)ogg.data();
+    sound->size = ogg.size();
+    if (!Parse(*sound)) {
+        ESP_LOGW(TAG, "No audio in the sound at %p (%u bytes)", ogg.data(), ogg.size());
+    }
+    // Kept even without audio, so a broken sound is not parsed again every time
+    sounds_.push_back(sound);
+    return sound;
+}
+
+const PromptSound* PromptSoundCache::Get(std::string_view ogg) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto sound = Find(ogg);
+    return sound->packets.empty() ? nullptr : sound;
+}
+
+const PromptSound* PromptSoundCache::Preload(std::string_view ogg, bool decode, int output_sample_rate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto sound = Find(ogg);
+    if (sound->packets.empty()) {
+        return nullptr;
+    }
+    if (!decode || sound->pcm != nullptr || sound->packets.size() * PROMPT_SOUND_FRAME_DURATION_MS > PROMPT_SOUND_PCM_MAX_MS) {
+        return sound;
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    if (Decode(*sound, output_sample_rate)) {
+        ESP_LOGI(TAG, "Decoded %u packets into %u samples in %lldus", sound->packets.size(), sound->pcm_samples,
+            esp_timer_get_time() - start_time);
+    }
+    return sound;
+}
+
+/*
+ * Same rules as the original scan: the first packet is OpusHead, the second OpusTags, every
+ * later packet is one Opus frame. Pages are normally back to back, the scan for "OggS" is only
+ * there to step over garbage between them.
+ */
+bool PromptSoundCache::Parse(PromptSound& sound) {
+    const uint8_t* buf = sound.data;
+    size_t size = sound.size;
+    size_t offset = 0;
+    bool seen_head = false;
+    bool seen_tags = false;
+
+    while (offset + 27 <= size) {
+        if (std::memcmp(buf + offset, "OggS", 4) != 0) {
+            offset++;
+            continue;
+        }
+
+        const uint8_t* page = buf + offset;
+        uint8_t page_segments = page[26];
+        size_t body_off = offset + 27 + page_segments;
+        if (body_off > size) {
+            break;
+        }
+        size_t body_size = 0;
+        for (size_t i = 0; i < page_segments; ++i) {
+            body_size += page[27 + i];
+        }
+        if (body_off + body_size > size) {
+            break;
+        }
+
+        // Packets using lacing, a packet continued on the next page is dropped
+        size_t cur = body_off;
+        size_t seg_idx = 0;
+        if (page[5] & 0x01) {
+            // The page starts with the tail of a packet continued from the previous page, skip it
+            while (seg_idx < page_segments) {
+                uint8_t l = page[27 + seg_idx++];
+                cur += l;
+                if (l < 255) {
+                    break;
+                }
+            }
+        }
+        while (seg_idx < page_segments) {
+            size_t pkt_len = 0;
+            size_t pkt_start = cur;
+            uint8_t l;
+            do {
+                l = page[27 + seg_idx++];
+                pkt_len += l;
+                cur += l;
+            } while (l == 255 && seg_idx < page_segments);
+
+            if (pkt_len == 0 || l == 255) {
+                continue;
+            }
+            const uint8_t* pkt_ptr = buf + pkt_start;
+
+            if (!seen_head) {
+                // [0-7] "OpusHead", [8] version, [9] channel_count, [10-11] pre_skip, [12-15] input_sample_rate
+                if (pkt_len >= 16 && std::memcmp(pkt_ptr, "OpusHead", 8) == 0) {
+                    seen_head = true;
+                    sound.sample_rate = pkt_ptr[12] | (pkt_ptr[13] << 8) | (pkt_ptr[14] << 16) | (pkt_ptr[15] << 24);
+                }
+                continue;
+            }
+            if (!seen_tags) {
+                if (pkt_len >= 8 && std::memcmp(pkt_ptr, "OpusTags", 8) == 0) {
+                    seen_tags = true;
+                }
+                continue;
+            }
+            sound.packets.emplace_back(pkt_start, pkt_len);
+        }
+
+        offset = body_off + body_size;
+    }
+    return !sound.packets.empty();
+}
+
+bool PromptSoundCache::Decode(PromptSound& sound, int output_sample_rate) {
+    auto decoder = std::make_unique<OpusDecoderWrapper>(sound.sample_rate, 1, PROMPT_SOUND_FRAME_DURATION_MS);
+    PolyphaseResampler resampler;
+    if (sound.sample_rate != output_sample_rate) {
+        resampler.Configure(sound.sample_rate, output_sample_rate);
+    }
+
+    std::vector<int16_t> pcm;
+    std::vector<int16_t> frame;
+    std::vector<uint8_t> payload;
+    for (auto& [offset, length] : sound.packets) {
+        payload.assign(sound.data + offset, sound.data + offset + length);
+        if (!decoder->Decode(std::move(payload), frame)) {
+            ESP_LOGE(TAG, "Failed to decode the sound at %p", sound.data);
+            return false;
+        }
+        if (sound.sample_rate != output_sample_rate) {
+            resampler.Process(frame);
+        }
+        pcm.insert(pcm.end(), frame.begin(), frame.end());
+    }
+
+    // Internal RAM is not spent on it, the sound can still be played from the index
+    sound.pcm = (int16_t*)heap_caps_malloc(pcm.size() * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    if (sound.pcm == nullptr) {
+        return false;
+    }
+    std::memcpy(sound.pcm, pcm.data(), pcm.size() * sizeof(int16_t));
+    sound.pcm_samples = pcm.size();
+    return true;
+}
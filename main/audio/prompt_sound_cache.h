@@ -0,0 +1,57 @@
+#ifndef PROMPT_SOUND_CACHE_H
+#define PROMPT_SOUND_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// Sounds up to this long are also kept decoded when preloaded, if there is PSRAM for them
+#define PROMPT_SOUND_PCM_MAX_MS 1500
+#define PROMPT_SOUND_FRAME_DURATION_MS 60
+
+// One prompt sound, parsed once. The sound data stays where it is, usually in flash.
+struct PromptSound {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    int sample_rate = 16000;
+    // Offset and length of every Opus packet in data
+    std::vector<std::pair<uint32_t, uint16_t>> packets;
+    // Decoded at the output sample rate, in PSRAM, nullptr when the sound is only indexed
+    int16_t* pcm = nullptr;
+    size_t pcm_samples = 0;
+};
+
+/*
+ * Prompt sounds (Lang::Sounds::OGG_*) are OGG Opus files embedded in the firmware. Walking the
+ * OGG pages of a sound every time it plays is replaced by a packet index built on first use,
+ * keyed by the address of the sound data.
+ *
+ * Preload() builds the index at boot. Application::Start() also decodes the short feedback
+ * sounds (popup, vibration) to PCM, so the decode task can put the first frame into the playback
+ * queue right away instead of going through the decode queue and the decoder. Success and
+ * exclamation are only indexed.
+ *
+ * Entries are never removed, so the returned pointers stay valid.
+ */
+class PromptSoundCache {
+public:
+    ~PromptSoundCache();
+
+    // Indexes the sound, and decodes it for output_sample_rate if decode is set and it is short enough
+    const PromptSound* Preload(std::string_view ogg, bool decode, int output_sample_rate);
+    // Returns the indexed sound, indexing it now if needed. nullptr if it has no audio packets.
+    const PromptSound* Get(std::string_view ogg);
+
+private:
+    std::mutex mutex_;
+    std::vector<PromptSound*> sounds_;
+
+    // Finds or indexes the sound, the mutex must be held
+    PromptSound* Find(std::string_view ogg);
+    static bool Parse(PromptSound& sound);
+    static bool Decode(PromptSound& sound, int output_sample_rate);
+};
+
+#endif // PROMPT_SOUND_CACHE_H
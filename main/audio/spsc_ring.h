@@ -0,0 +1,90 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/*
+ * Bounded single-producer / single-consumer ring buffer.
+ *
+ * Slots are preallocated, so pushing and popping never touches the heap. Push() must only be
+ * called from one task and Pop() from one other task; no locks are taken on either side.
+ *
+ * Discard() may be called from any task. It marks everything pushed so far as stale; the
+ * consumer drops those items on its next Pop(), so the producer and consumer never race on
+ * a slot.
+ */
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0, "Capacity must be greater than 0");
+
+public:
+    SpscRing() = default;
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer side. The item is only moved from when true is returned.
+    bool Push(T&& item) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= Capacity) {
+            return false;
+        }
+        slots_[tail & kMask] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if there is nothing left after dropping discarded items.
+    bool Pop(T& item) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        // A discard mark outside [head, tail] is stale and ignored
+        uint32_t discard = discard_until_.load(std::memory_order_acquire) - head;
+        if (discard > tail - head) {
+            discard = 0;
+        }
+        for (; discard > 0; --discard, ++head) {
+            slots_[head & kMask] = T();
+        }
+        if (head == tail) {
+            head_.store(head, std::memory_order_release);
+            return false;
+        }
+        item = std::move(slots_[head & kMask]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Any task. Items already in the ring are dropped by the consumer.
+    void Discard() {
+        discard_until_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    size_t Size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+    bool Empty() const { return Size() == 0; }
+    bool Full() const { return Size() >= Capacity; }
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    static constexpr size_t RoundUpPowerOfTwo(size_t n) {
+        size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+    static constexpr size_t kSlots = RoundUpPowerOfTwo(Capacity);
+    static constexpr uint32_t kMask = kSlots - 1;
+
+    std::array<T, kSlots> slots_;
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+    std::atomic<uint32_t> discard_until_{0};
+};
+
+#endif // SPSC_RING_H
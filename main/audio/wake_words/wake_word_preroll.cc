@@ -0,0 +1,204 @@
+#include "wake_word_preroll.h"
+#include "audio_service.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#define TAG "WakeWordPreroll"
+
+#define PCM_MASK (WAKE_WORD_PREROLL_PCM_SAMPLES - 1)
+#define MAX_PREROLL_PACKETS (WAKE_WORD_PREROLL_DURATION_MS / OPUS_FRAME_DURATION_MS)
+#define ENCODE_TASK_STACK_SIZE (4096 * 7)
+
+WakeWordPreroll::WakeWordPreroll() {
+}
+
+WakeWordPreroll::~WakeWordPreroll() {
+    if (encode_task_ != nullptr) {
+        vTaskDelete(encode_task_);
+    }
+    if (encode_task_stack_ != nullptr) {
+        heap_caps_free(encode_task_stack_);
+    }
+    if (encode_task_buffer_ != nullptr) {
+        heap_caps_free(encode_task_buffer_);
+    }
+    if (pcm_ != nullptr) {
+        heap_caps_free(pcm_);
+    }
+}
+
+bool WakeWordPreroll::Initialize() {
+    if (encode_task_ != nullptr) {
+        return true;
+    }
+
+    pcm_ = (int16_t*)heap_caps_malloc(WAKE_WORD_PREROLL_PCM_SAMPLES * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    if (pcm_ == nullptr) {
+        ESP_LOGW(TAG, "No PSRAM for the pre-roll buffer, using internal RAM");
+        pcm_ = (int16_t*)heap_caps_malloc(WAKE_WORD_PREROLL_PCM_SAMPLES * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+        if (pcm_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate the pre-roll buffer");
+            return false;
+        }
+    }
+
+    frame_samples_ = WAKE_WORD_PREROLL_SAMPLE_RATE / 1000 * OPUS_FRAME_DURATION_MS;
+    frame_.resize(frame_samples_);
+    packets_.resize(MAX_PREROLL_PACKETS);
+    encoder_ = std::make_unique<OpusEncoderWrapper>(WAKE_WORD_PREROLL_SAMPLE_RATE, 1, OPUS_FRAME_DURATION_MS);
+    encoder_->SetComplexity(0); // 0 is the fastest
+
+    encode_task_stack_ = (StackType_t*)heap_caps_malloc(ENCODE_TASK_STACK_SIZE, MALLOC_CAP_SPIRAM);
+    encode_task_buffer_ = (StaticTask_t*)heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
+    if (encode_task_stack_ == nullptr || encode_task_buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate the encode task");
+        return false;
+    }
+    encode_task_ = xTaskCreateStatic([](void* arg) {
+        auto this_ = (WakeWordPreroll*)arg;
+        this_->EncodeTask();
+        vTaskDelete(NULL);
+    }, "encode_wake_word", ENCODE_TASK_STACK_SIZE, this, 2, encode_task_stack_, encode_task_buffer_);
+    return true;
+}
+
+void WakeWordPreroll::Feed(const int16_t* data, size_t samples) {
+    if (encode_task_ == nullptr) {
+        return;
+    }
+
+    uint32_t write_pos = write_pos_.load(std::memory_order_relaxed);
+    // Detection runs again after the last pre-roll was taken, start a new one from here
+    if (state_.load(std::memory_order_acquire) == kStateReady && !reset_requested_.load(std::memory_order_relaxed)) {
+        reset_pos_.store(write_pos, std::memory_order_relaxed);
+        reset_requested_.store(true, std::memory_order_release);
+    }
+
+    if (samples > WAKE_WORD_PREROLL_PCM_SAMPLES) {
+        data += samples - WAKE_WORD_PREROLL_PCM_SAMPLES;
+        write_pos += samples - WAKE_WORD_PREROLL_PCM_SAMPLES;
+        samples = WAKE_WORD_PREROLL_PCM_SAMPLES;
+    }
+    size_t offset = write_pos & PCM_MASK;
+    size_t first = std::min(samples, (size_t)WAKE_WORD_PREROLL_PCM_SAMPLES - offset);
+    memcpy(pcm_ + offset, data, first * sizeof(int16_t));
+    memcpy(pcm_, data + first, (samples - first) * sizeof(int16_t));
+    write_pos_.store(write_pos + samples, std::memory_order_release);
+
+    xTaskNotifyGive(encode_task_);
+}
+
+void WakeWordPreroll::Flush() {
+    if (encode_task_ == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_ == kStateRolling) {
+            state_ = kStateFlushing;
+        }
+        flush_time_us_ = esp_timer_get_time();
+    }
+    flush_requested_.store(true, std::memory_order_release);
+    xTaskNotifyGive(encode_task_);
+}
+
+bool WakeWordPreroll::GetPacket(std::vector<uint8_t>& opus) {
+    if (encode_task_ == nullptr) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool ready = cv_.wait_for(lock, std::chrono::milliseconds(WAKE_WORD_PREROLL_FLUSH_TIMEOUT_MS), [this]() {
+        return state_ == kStateReady;
+    });
+    if (!ready) {
+        ESP_LOGE(TAG, "Pre-roll not ready after %d ms, sending none", WAKE_WORD_PREROLL_FLUSH_TIMEOUT_MS);
+        opus.clear();
+        return false;
+    }
+    if (packets_count_ == 0) {
+        opus.clear();
+        return false;
+    }
+    opus.swap(packets_[packets_head_]);
+    packets_head_ = (packets_head_ + 1) % packets_.size();
+    packets_count_--;
+    return true;
+}
+
+void WakeWordPreroll::EncodeTask() {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        if (reset_requested_.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            packets_count_ = 0;
+            read_pos_ = reset_pos_.load(std::memory_order_relaxed);
+            state_ = kStateRolling;
+            reset_requested_.store(false, std::memory_order_release);
+        }
+
+        if (state_ != kStateReady) {
+            EncodeAvailableFrames();
+        }
+
+        if (flush_requested_.exchange(false, std::memory_order_acq_rel)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            state_ = kStateReady;
+            cv_.notify_all();
+            ESP_LOGI(TAG, "Pre-roll ready: %u packets, %ld ms after detection", (unsigned)packets_count_,
+                (long)((esp_timer_get_time() - flush_time_us_) / 1000));
+        }
+    }
+}
+
+void WakeWordPreroll::EncodeAvailableFrames() {
+    uint32_t write_pos = write_pos_.load(std::memory_order_acquire);
+    if (write_pos - read_pos_ > WAKE_WORD_PREROLL_PCM_SAMPLES) {
+        ESP_LOGW(TAG, "Encoder fell behind, skipping to the latest %d ms", WAKE_WORD_PREROLL_PCM_SAMPLES / 2 * 1000 / WAKE_WORD_PREROLL_SAMPLE_RATE);
+        read_pos_ = write_pos - WAKE_WORD_PREROLL_PCM_SAMPLES / 2;
+    }
+
+    while (write_pos - read_pos_ >= frame_samples_) {
+        size_t offset = read_pos_ & PCM_MASK;
+        size_t first = std::min(frame_samples_, (size_t)WAKE_WORD_PREROLL_PCM_SAMPLES - offset);
+        memcpy(frame_.data(), pcm_ + offset, first * sizeof(int16_t));
+        memcpy(frame_.data() + first, pcm_, (frame_samples_ - first) * sizeof(int16_t));
+
+        // The writer may have lapped us while we were copying
+        uint32_t frame_pos = read_pos_;
+        read_pos_ += frame_samples_;
+        if (write_pos_.load(std::memory_order_acquire) - frame_pos > WAKE_WORD_PREROLL_PCM_SAMPLES) {
+            continue;
+        }
+
+        // The encoder works on the buffer in place, take it back so the next frame reuses it
+        std::vector<int16_t> pcm = std::move(frame_);
+        bool encoded = encoder_->Encode(std::move(pcm), encoded_);
+        frame_ = std::move(pcm);
+        frame_.resize(frame_samples_); // Only allocates if the encoder kept the buffer after all
+        if (encoded) {
+            PushPacket();
+        }
+    }
+}
+
+void WakeWordPreroll::PushPacket() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t index;
+    if (packets_count_ < packets_.size()) {
+        index = (packets_head_ + packets_count_) % packets_.size();
+        packets_count_++;
+    } else {
+        // Drop the oldest packet and keep its buffer
+        index = packets_head_;
+        packets_head_ = (packets_head_ + 1) % packets_.size();
+    }
+    packets_[index].swap(encoded_);
+}
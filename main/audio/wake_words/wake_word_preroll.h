@@ -0,0 +1,85 @@
+#ifndef WAKE_WORD_PREROLL_H
+#define WAKE_WORD_PREROLL_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <opus_encoder.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define WAKE_WORD_PREROLL_SAMPLE_RATE 16000
+#define WAKE_WORD_PREROLL_DURATION_MS 2000
+// A bit more than WAKE_WORD_PREROLL_DURATION_MS of samples, a power of two so positions can wrap
+#define WAKE_WORD_PREROLL_PCM_SAMPLES 32768
+// Flushing encodes at most one frame, GetPacket() gives up if it takes longer than this
+#define WAKE_WORD_PREROLL_FLUSH_TIMEOUT_MS 1000
+
+/*
+ * Keeps the last ~2 seconds before a wake word as ready-to-send Opus packets.
+ *
+ * The detection task writes mono 16 kHz PCM into a ring in PSRAM with Feed(), which never blocks
+ * and never allocates. A background task encodes every complete frame as soon as it is available
+ * and keeps a rolling window of packets, so when the wake word fires at most one frame is left
+ * to encode and GetPacket() can start returning packets almost immediately.
+ */
+class WakeWordPreroll {
+public:
+    WakeWordPreroll();
+    ~WakeWordPreroll();
+
+    bool Initialize();
+
+    // Detection task only
+    void Feed(const int16_t* data, size_t samples);
+
+    // Stops rolling and finishes the pre-roll, GetPacket() returns packets once it is done
+    void Flush();
+
+    // Waits for the pre-roll to be flushed, returns false after the last packet or if it times out
+    bool GetPacket(std::vector<uint8_t>& opus);
+
+private:
+    enum State {
+        kStateRolling,
+        kStateFlushing,
+        kStateReady,
+    };
+
+    // PCM ring, the positions count samples and only ever grow
+    int16_t* pcm_ = nullptr;
+    std::atomic<uint32_t> write_pos_{0};
+    std::atomic<uint32_t> reset_pos_{0};
+    uint32_t read_pos_ = 0;
+
+    // Packet ring, the oldest packet is overwritten when it is full
+    std::vector<std::vector<uint8_t>> packets_;
+    size_t packets_head_ = 0;
+    size_t packets_count_ = 0;
+
+    std::unique_ptr<OpusEncoderWrapper> encoder_;
+    std::vector<int16_t> frame_;
+    std::vector<uint8_t> encoded_;
+    size_t frame_samples_ = 0;
+
+    std::atomic<State> state_{kStateRolling};
+    std::atomic<bool> flush_requested_ = false;
+    std::atomic<bool> reset_requested_ = false;
+    int64_t flush_time_us_ = 0;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    TaskHandle_t encode_task_ = nullptr;
+    StaticTask_t* encode_task_buffer_ = nullptr;
+    StackType_t* encode_task_stack_ = nullptr;
+
+    void EncodeTask();
+    void EncodeAvailableFrames();
+    void PushPacket();
+};
+
+#endif // WAKE_WORD_PREROLL_H
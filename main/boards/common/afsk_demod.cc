@@ -3,6 +3,7 @@
 #include <algorithm>
 #include "esp_log.h"
 #include "display.h"
+#include "audio_channels.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -41,11 +42,9 @@ namespace audio_wifi_config
             }
 
             if (input_channels == 2) { // 如果是双声道输入，转换为单声道
-                auto mono_data = std::vector<int16_t>(audio_data.size() / 2);
-                for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                    mono_data[i] = audio_data[j];
-                }
-                audio_data = std::move(mono_data);
+                size_t frames = audio_data.size() / 2;
+                audio_channels::ExtractChannel(audio_data.data(), frames, 2, 0, audio_data.data());
+                audio_data.resize(frames);
             }
             
             // Downsample the audio data
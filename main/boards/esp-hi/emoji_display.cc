@@ -81,7 +81,7 @@ void EmojiPlayer::StartPlayer(const std::string& asset_name, bool repeat, int fp
         size_t src_len = 0;
 
         auto& assets = Assets::GetInstance();
-        std::string filename = emoji_asset_name_map.at(asset_name);
+        const std::string& filename = emoji_asset_name_map.at(asset_name);
         if (!assets.GetAssetData(filename, src_data, src_len)) {
             ESP_LOGE(TAG, "Failed to get asset data for %s", asset_name.c_str());
             return;
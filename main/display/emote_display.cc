@@ -524,12 +524,18 @@ void EmoteDisplay::SetTheme(Theme* const theme)
     ESP_LOGI(TAG, "SetTheme: %p", theme);
 
 }
-void EmoteDisplay::AddEmojiData(const std::string &name, const void* const data, const size_t size,
+void EmoteDisplay::AddEmojiData(std::string_view name, const void* const data, const size_t size,
                                 uint8_t fps, bool loop, bool lack)
 {
-    emoji_data_map_[name] = AssetData(data, size, fps, loop, lack);
-    ESP_LOGD(TAG, "Added emoji data: %s, size: %d, fps: %d, loop: %s, lack: %s",
-             name.c_str(), size, fps, loop ? "true" : "false", lack ? "true" : "false");
+    // The name is only copied when it is new
+    auto it = emoji_data_map_.find(name);
+    if (it != emoji_data_map_.end()) {
+        it->second = AssetData(data, size, fps, loop, lack);
+    } else {
+        emoji_data_map_.emplace(name, AssetData(data, size, fps, loop, lack));
+    }
+    ESP_LOGD(TAG, "Added emoji data: %.*s, size: %d, fps: %d, loop: %s, lack: %s",
+             (int)name.size(), name.data(), size, fps, loop ? "true" : "false", lack ? "true" : "false");
 
     DisplayLockGuard lock(this);
     if (name == "happy") {
@@ -537,10 +543,15 @@ void EmoteDisplay::AddEmojiData(const std::string &name, const void* const data,
     }
 }
 
-void EmoteDisplay::AddIconData(const std::string &name, const void* const data, const size_t size)
+void EmoteDisplay::AddIconData(std::string_view name, const void* const data, const size_t size)
 {
-    icon_data_map_[name] = AssetData(data, size);
-    ESP_LOGD(TAG, "Added icon data: %s, size: %d", name.c_str(), size);
+    auto it = icon_data_map_.find(name);
+    if (it != icon_data_map_.end()) {
+        it->second = AssetData(data, size);
+    } else {
+        icon_data_map_.emplace(name, AssetData(data, size));
+    }
+    ESP_LOGD(TAG, "Added icon data: %.*s, size: %d", (int)name.size(), name.data(), size);
 
     DisplayLockGuard lock(this);
     if (name == ICON_WIFI_FAILED) {
@@ -602,7 +613,7 @@ void EmoteDisplay::AddTextFont(std::shared_ptr<LvglFont> text_font)
     }
 }
 
-AssetData EmoteDisplay::GetEmojiData(const std::string &name) const
+AssetData EmoteDisplay::GetEmojiData(std::string_view name) const
 {
     const auto it = emoji_data_map_.find(name);
     if (it != emoji_data_map_.cend()) {
@@ -611,7 +622,7 @@ AssetData EmoteDisplay::GetEmojiData(const std::string &name) const
     return AssetData();
 }
 
-AssetData EmoteDisplay::GetIconData(const std::string &name) const
+AssetData EmoteDisplay::GetIconData(std::string_view name) const
 {
     const auto it = icon_data_map_.find(name);
     if (it != icon_data_map_.cend()) {
@@ -6,6 +6,7 @@
 #include <functional>
 #include <map>
 #include <string>
+#include <string_view>
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
 
@@ -68,12 +69,12 @@ public:
     virtual void SetPowerSaveMode(bool on) override;
     virtual void SetPreviewImage(const void* image);
 
-    void AddEmojiData(const std::string &name, const void* data, size_t size, uint8_t fps = 0, bool loop = false, bool lack = false);
-    void AddIconData(const std::string &name, const void* data, size_t size);
+    void AddEmojiData(std::string_view name, const void* data, size_t size, uint8_t fps = 0, bool loop = false, bool lack = false);
+    void AddIconData(std::string_view name, const void* data, size_t size);
     void AddLayoutData(const std::string &name, const std::string &align_str, int x, int y, int width = 0, int height = 0);
     void AddTextFont(std::shared_ptr<LvglFont> text_font);
-    AssetData GetEmojiData(const std::string &name) const;
-    AssetData GetIconData(const std::string &name) const;
+    AssetData GetEmojiData(std::string_view name) const;
+    AssetData GetIconData(std::string_view name) const;
 
     EmoteEngine* GetEngine() const;
     void* GetEngineHandle() const;
@@ -93,9 +94,9 @@ private:
     // Font management
     std::shared_ptr<LvglFont> text_font_ = nullptr;
 
-    // Non-LVGL asset data storage
-    std::map<std::string, AssetData> emoji_data_map_;
-    std::map<std::string, AssetData> icon_data_map_;
+    // Non-LVGL asset data storage, looked up by views of the name
+    std::map<std::string, AssetData, std::less<>> emoji_data_map_;
+    std::map<std::string, AssetData, std::less<>> icon_data_map_;
 
 };
 
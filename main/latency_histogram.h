@@ -0,0 +1,90 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <cJSON.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Counts values in half-octave buckets (each bucket is about 1.41 times wider than the one before),
+ * so percentiles can be read without keeping the samples. Values are in whatever unit the caller
+ * records, up to about 2^23 (8 seconds in microseconds) before they land in the last bucket.
+ *
+ * Not synchronized, guard it if it is recorded and read from different tasks.
+ */
+class LatencyHistogram {
+public:
+    static constexpr size_t kBuckets = 48;
+
+    void Record(uint32_t value) {
+        buckets_[BucketOf(value)]++;
+        count_++;
+        sum_ += value;
+        max_ = std::max(max_, value);
+    }
+
+    void Reset() {
+        buckets_.fill(0);
+        count_ = 0;
+        sum_ = 0;
+        max_ = 0;
+    }
+
+    uint32_t count() const { return count_; }
+    uint32_t max() const { return max_; }
+    uint32_t mean() const { return count_ == 0 ? 0 : sum_ / count_; }
+
+    // Upper bound of the bucket holding the given percentile (0-100), never more than the max
+    uint32_t Percentile(int percentile) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        uint64_t rank = ((uint64_t)count_ * percentile + 99) / 100;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; i++) {
+            seen += buckets_[i];
+            if (seen >= rank && buckets_[i] > 0) {
+                return i + 1 < kBuckets ? std::min(LowerBound(i + 1) - 1, max_) : max_;
+            }
+        }
+        return max_;
+    }
+
+    cJSON* ToJson() const {
+        cJSON* json = cJSON_CreateObject();
+        cJSON_AddNumberToObject(json, "count", count());
+        cJSON_AddNumberToObject(json, "mean", mean());
+        cJSON_AddNumberToObject(json, "p50", Percentile(50));
+        cJSON_AddNumberToObject(json, "p90", Percentile(90));
+        cJSON_AddNumberToObject(json, "p99", Percentile(99));
+        cJSON_AddNumberToObject(json, "max", max());
+        return json;
+    }
+
+private:
+    std::array<uint32_t, kBuckets> buckets_ = {};
+    uint32_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint32_t max_ = 0;
+
+    static size_t BucketOf(uint32_t value) {
+        if (value < 4) {
+            return value;
+        }
+        int msb = 31 - __builtin_clz(value);
+        size_t index = msb * 2 + ((value >> (msb - 1)) & 1);
+        return std::min(index, kBuckets - 1);
+    }
+
+    static uint32_t LowerBound(size_t index) {
+        if (index < 4) {
+            return index;
+        }
+        int msb = index / 2;
+        return (1u << msb) | ((uint32_t)(index & 1) << (msb - 1));
+    }
+};
+
+#endif // LATENCY_HISTOGRAM_H
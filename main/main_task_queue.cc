@@ -0,0 +1,84 @@
+#include "main_task_queue.h"
+
+#include <esp_timer.h>
+
+void MainTaskQueue::Push(MainTask&& task, MainTaskPriority priority) {
+    if (task.on_heap()) {
+        heap_tasks_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint32_t depth = depth_.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint32_t max_depth = max_depth_.load(std::memory_order_relaxed);
+    while (depth > max_depth && !max_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed)) {
+    }
+
+    QueuedTask queued;
+    queued.task = std::move(task);
+    queued.enqueue_time_us = esp_timer_get_time();
+    if (overflow_size_[priority].load(std::memory_order_acquire) == 0) {
+        bool pushed = priority == kMainTaskPriorityHigh ? high_priority_tasks_.Push(std::move(queued))
+            : tasks_.Push(std::move(queued));
+        if (pushed) {
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(overflow_mutex_);
+    overflow_tasks_[priority].push_back(std::move(queued));
+    overflow_size_[priority].fetch_add(1, std::memory_order_release);
+    overflow_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool MainTaskQueue::Pop(MainTask& task) {
+    // The ring of a priority holds its older tasks, its overflow the newer ones
+    QueuedTask queued;
+    if (high_priority_tasks_.Pop(queued)) {
+        Finish(queued, task);
+        return true;
+    }
+    if (PopOverflow(kMainTaskPriorityHigh, task)) {
+        return true;
+    }
+    if (tasks_.Pop(queued)) {
+        Finish(queued, task);
+        return true;
+    }
+    return PopOverflow(kMainTaskPriorityNormal, task);
+}
+
+bool MainTaskQueue::PopOverflow(MainTaskPriority priority, MainTask& task) {
+    if (overflow_size_[priority].load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(overflow_mutex_);
+    auto& overflow = overflow_tasks_[priority];
+    if (overflow.empty()) {
+        return false;
+    }
+    QueuedTask queued = std::move(overflow.front());
+    overflow.pop_front();
+    overflow_size_[priority].fetch_sub(1, std::memory_order_release);
+    Finish(queued, task);
+    return true;
+}
+
+void MainTaskQueue::Finish(QueuedTask& queued, MainTask& task) {
+    depth_.fetch_sub(1, std::memory_order_relaxed);
+    uint32_t latency_us = esp_timer_get_time() - queued.enqueue_time_us;
+    if (latency_us > max_latency_us_) {
+        max_latency_us_ = latency_us;
+    }
+    task = std::move(queued.task);
+}
+
+MainTaskQueueStatistics MainTaskQueue::TakeStatistics() {
+    MainTaskQueueStatistics statistics;
+    statistics.depth = depth_.load(std::memory_order_relaxed);
+    statistics.max_depth = max_depth_.exchange(statistics.depth, std::memory_order_relaxed);
+    statistics.max_latency_us = max_latency_us_;
+    statistics.heap_tasks = heap_tasks_.load(std::memory_order_relaxed);
+    statistics.overflow_tasks = overflow_count_.load(std::memory_order_relaxed);
+    max_latency_us_ = 0;
+    return statistics;
+}
@@ -0,0 +1,162 @@
+#ifndef MAIN_TASK_QUEUE_H
+#define MAIN_TASK_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "mpsc_ring.h"
+
+// Room for a lambda capturing `this`, a pointer and a std::string or two without touching the heap
+#define MAIN_TASK_INLINE_SIZE 48
+#define MAIN_TASK_QUEUE_SIZE 32
+#define MAIN_TASK_QUEUE_HIGH_PRIORITY_SIZE 8
+
+/*
+ * A move-only void() callable. Callables up to MAIN_TASK_INLINE_SIZE bytes are stored inline,
+ * larger ones fall back to the heap.
+ */
+class MainTask {
+public:
+    MainTask() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, MainTask>>>
+    MainTask(F&& callable) {
+        using Fn = std::decay_t<F>;
+        if constexpr (sizeof(Fn) <= MAIN_TASK_INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t) &&
+            std::is_nothrow_move_constructible_v<Fn>) {
+            new (storage_) Fn(std::forward<F>(callable));
+            ops_ = &kInlineOps<Fn>;
+        } else {
+            *reinterpret_cast<Fn**>(storage_) = new Fn(std::forward<F>(callable));
+            ops_ = &kHeapOps<Fn>;
+        }
+    }
+
+    MainTask(MainTask&& other) noexcept {
+        if (other.ops_ != nullptr) {
+            other.ops_->move(storage_, other.storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    MainTask& operator=(MainTask&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            if (other.ops_ != nullptr) {
+                other.ops_->move(storage_, other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    MainTask(const MainTask&) = delete;
+    MainTask& operator=(const MainTask&) = delete;
+
+    ~MainTask() { Reset(); }
+
+    void operator()() { ops_->invoke(storage_); }
+    explicit operator bool() const { return ops_ != nullptr; }
+    bool on_heap() const { return ops_ != nullptr && ops_->on_heap; }
+
+    void Reset() {
+        if (ops_ != nullptr) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        // Move constructs into dst and destroys src
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void* storage);
+        bool on_heap;
+    };
+
+    template <typename Fn>
+    static constexpr Ops kInlineOps = {
+        [](void* storage) { (*static_cast<Fn*>(storage))(); },
+        [](void* dst, void* src) {
+            new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        },
+        [](void* storage) { static_cast<Fn*>(storage)->~Fn(); },
+        false,
+    };
+
+    template <typename Fn>
+    static constexpr Ops kHeapOps = {
+        [](void* storage) { (**static_cast<Fn**>(storage))(); },
+        [](void* dst, void* src) { *static_cast<Fn**>(dst) = *static_cast<Fn**>(src); },
+        [](void* storage) { delete *static_cast<Fn**>(storage); },
+        true,
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[MAIN_TASK_INLINE_SIZE];
+    const Ops* ops_ = nullptr;
+};
+
+enum MainTaskPriority {
+    kMainTaskPriorityHigh,      // Audio and state changes that must not wait behind UI updates
+    kMainTaskPriorityNormal,
+};
+
+struct MainTaskQueueStatistics {
+    uint32_t depth = 0;
+    uint32_t max_depth = 0;
+    uint32_t max_latency_us = 0;    // Longest time a task waited before it started to run
+    uint32_t heap_tasks = 0;        // Callables too large to be stored inline
+    uint32_t overflow_tasks = 0;    // Tasks that found their ring full
+};
+
+/*
+ * The queue behind Application::Schedule().
+ *
+ * Any task may push, only the main event loop pops. High priority tasks are popped before
+ * normal ones. Pushing never fails: when a ring is full the task goes to the overflow list of
+ * its priority under a mutex, and later tasks of that priority follow it there so the order is
+ * kept. The high priority overflow is drained before any normal task.
+ */
+class MainTaskQueue {
+public:
+    void Push(MainTask&& task, MainTaskPriority priority);
+    bool Pop(MainTask& task);
+    size_t Size() const { return depth_.load(std::memory_order_relaxed); }
+
+    // Returns the counters and restarts the max values
+    MainTaskQueueStatistics TakeStatistics();
+
+private:
+    struct QueuedTask {
+        MainTask task;
+        int64_t enqueue_time_us = 0;
+    };
+
+    MpscRing<QueuedTask, MAIN_TASK_QUEUE_HIGH_PRIORITY_SIZE> high_priority_tasks_;
+    MpscRing<QueuedTask, MAIN_TASK_QUEUE_SIZE> tasks_;
+    std::mutex overflow_mutex_;
+    // Indexed by MainTaskPriority
+    std::deque<QueuedTask> overflow_tasks_[2];
+    std::atomic<uint32_t> overflow_size_[2] = {};
+
+    std::atomic<uint32_t> depth_{0};
+    std::atomic<uint32_t> max_depth_{0};
+    std::atomic<uint32_t> heap_tasks_{0};
+    std::atomic<uint32_t> overflow_count_{0};
+    uint32_t max_latency_us_ = 0;
+
+    bool PopOverflow(MainTaskPriority priority, MainTask& task);
+    void Finish(QueuedTask& queued, MainTask& task);
+};
+
+#endif // MAIN_TASK_QUEUE_H
@@ -122,7 +122,10 @@ void McpServer::AddCommonTools() {
 #endif
 
     // Restore the original tools list to the end of the tools list
+    std::lock_guard<std::mutex> lock(tools_list_mutex_);
     tools_.insert(tools_.end(), original_tools.begin(), original_tools.end());
+    tools_list_pages_[0].clear();
+    tools_list_pages_[1].clear();
 }
 
 void McpServer::AddUserOnlyTools() {
@@ -135,6 +138,20 @@ void McpServer::AddUserOnlyTools() {
             return board.GetSystemInfoJson();
         });
 
+    AddUserOnlyTool("self.network.get_connect_stats",
+        "Audio channel connect latency histograms (ms) and warm connection counters",
+        PropertyList(),
+        [this](const PropertyList& properties) -> ReturnValue {
+            return Application::GetInstance().GetAudioChannelWarmer().GetStatsJson();
+        });
+
+    AddUserOnlyTool("self.audio.get_latency_stats",
+        "Per-stage audio latency histograms (us), uplink from mic capture to send and downlink from receive to speaker output",
+        PropertyList(),
+        [this](const PropertyList& properties) -> ReturnValue {
+            return Application::GetInstance().GetAudioService().GetLatencyTracer().GetStatsJson();
+        });
+
     AddUserOnlyTool("self.reboot", "Reboot the system",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
@@ -303,14 +320,20 @@ void McpServer::AddUserOnlyTools() {
 }
 
 void McpServer::AddTool(McpTool* tool) {
-    // Prevent adding duplicate tools
-    if (std::find_if(tools_.begin(), tools_.end(), [tool](const McpTool* t) { return t->name() == tool->name(); }) != tools_.end()) {
+    std::lock_guard<std::mutex> lock(tools_list_mutex_);
+    // Prevent adding duplicate tools, the index also covers tools set aside by AddCommonTools()
+    if (tool_index_.find(tool->name()) != tool_index_.end()) {
         ESP_LOGW(TAG, "Tool %s already added", tool->name().c_str());
         return;
     }
 
     ESP_LOGI(TAG, "Add tool: %s%s", tool->name().c_str(), tool->user_only() ? " [user]" : "");
     tools_.push_back(tool);
+    // Keyed by a view of the tool's own name, tools live as long as the server
+    tool_index_[tool->name()] = tool;
+    // Rebuilt on the next tools/list
+    tools_list_pages_[0].clear();
+    tools_list_pages_[1].clear();
 }
 
 void McpServer::AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback) {
@@ -430,7 +453,7 @@ void McpServer::ParseMessage(const cJSON* json) {
             ReplyError(id_int, "Invalid arguments");
             return;
         }
-        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments);
+        DoToolCall(id_int, tool_name->valuestring, tool_arguments);
     } else {
         ESP_LOGE(TAG, "Method not implemented: %s", method_str.c_str());
         ReplyError(id_int, "Method not implemented: " + method_str);
@@ -438,7 +461,10 @@ void McpServer::ParseMessage(const cJSON* json) {
 }
 
 void McpServer::ReplyResult(int id, const std::string& result) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
+    std::string payload;
+    // One allocation, a tools/list page is up to 8 KB
+    payload.reserve(result.size() + 48);
+    payload = "{\"jsonrpc\":\"2.0\",\"id\":";
     payload += std::to_string(id) + ",\"result\":";
     payload += result;
     payload += "}";
@@ -455,108 +481,171 @@ void McpServer::ReplyError(int id, const std::string& message) {
 }
 
 void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_only_tools) {
-    const int max_payload_size = 8000;
-    std::string json = "{\"tools\":[";
-    
-    bool found_cursor = cursor.empty();
-    auto it = tools_.begin();
-    std::string next_cursor = "";
-    
-    while (it != tools_.end()) {
-        // 如果我们还没有找到起始位置，继续搜索
-        if (!found_cursor) {
-            if ((*it)->name() == cursor) {
-                found_cursor = true;
-            } else {
-                ++it;
-                continue;
+    bool found = false;
+    std::shared_ptr<const std::string> result;
+    std::string oversized_tool;
+    {
+        std::lock_guard<std::mutex> lock(tools_list_mutex_);
+        auto& pages = tools_list_pages_[list_user_only_tools ? 1 : 0];
+        if (pages.empty()) {
+            BuildToolsListPages(list_user_only_tools, pages);
+        }
+        for (const auto& p : pages) {
+            if (p.cursor == cursor) {
+                found = true;
+                result = p.result;
+                if (result == nullptr) {
+                    oversized_tool = p.oversized_tool;
+                }
+                break;
             }
         }
+    }
+
+    if (!found) {
+        ESP_LOGE(TAG, "tools/list: Invalid cursor %s", cursor.c_str());
+        ReplyError(id, "Invalid cursor: " + cursor);
+    } else if (result == nullptr) {
+        ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", oversized_tool.c_str());
+        ReplyError(id, "Failed to add tool " + oversized_tool + " because of payload size limit");
+    } else {
+        ReplyResult(id, *result);
+    }
+}
+
+// Splits the tool list into replies that fit the payload limit, so a request is just a lookup
+void McpServer::BuildToolsListPages(bool list_user_only_tools, std::vector<ToolsListPage>& pages) {
+    const int max_payload_size = 8000;
+    pages.clear();
+
+    std::string json;
+    std::string cursor;
+    bool page_open = false;
+    auto close_page = [&](const std::string& next_cursor) {
+        if (json.back() == ',') {
+            json.pop_back();
+        }
+        if (next_cursor.empty()) {
+            json += "]}";
+        } else {
+            json += "],\"nextCursor\":\"" + next_cursor + "\"}";
+        }
+        pages.push_back({cursor, std::make_shared<const std::string>(std::move(json)), ""});
+        json.clear();
+        page_open = false;
+    };
 
-        if (!list_user_only_tools && (*it)->user_only()) {
-            ++it;
+    for (auto tool : tools_) {
+        if (!list_user_only_tools && tool->user_only()) {
             continue;
         }
-        
-        // 添加tool前检查大小
-        std::string tool_json = (*it)->to_json() + ",";
-        if (json.length() + tool_json.length() + 30 > max_payload_size) {
-            // 如果添加这个tool会超出大小限制，设置next_cursor并退出循环
-            next_cursor = (*it)->name();
-            break;
+
+        std::string tool_json = tool->to_json() + ",";
+        if (page_open && json.length() + tool_json.length() + 30 > max_payload_size) {
+            close_page(tool->name());
+        }
+        if (!page_open) {
+            cursor = pages.empty() ? "" : tool->name();
+            json = "{\"tools\":[";
+            page_open = true;
+            if (json.length() + tool_json.length() + 30 > max_payload_size) {
+                // This tool can never be listed, its page has no result and reports it
+                pages.push_back({cursor, nullptr, tool->name()});
+                page_open = false;
+                break;
+            }
         }
-        
         json += tool_json;
-        ++it;
     }
-    
-    if (json.back() == ',') {
-        json.pop_back();
+    if (page_open || pages.empty()) {
+        if (!page_open) {
+            cursor.clear();
+            json = "{\"tools\":[";
+        }
+        close_page("");
     }
-    
-    if (json.back() == '[' && !tools_.empty()) {
-        // 如果没有添加任何tool，返回错误
-        ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", next_cursor.c_str());
-        ReplyError(id, "Failed to add tool " + next_cursor + " because of payload size limit");
-        return;
+
+    size_t size = 0;
+    for (auto& page : pages) {
+        size += page.result != nullptr ? page.result->size() : 0;
     }
+    ESP_LOGI(TAG, "tools/list: %u pages, %u bytes for the %s view", (unsigned)pages.size(), (unsigned)size,
+        list_user_only_tools ? "user" : "AI");
+}
 
-    if (next_cursor.empty()) {
-        json += "]}";
-    } else {
-        json += "],\"nextCursor\":\"" + next_cursor + "\"}";
+// Checks one argument against its schema without modifying anything, returns an error message
+static std::string ValidateArgument(const Property& property, const cJSON* value, bool& found) {
+    found = false;
+    if (property.type() == kPropertyTypeBoolean) {
+        found = cJSON_IsBool(value);
+    } else if (property.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
+        found = true;
+        if (property.has_range() && value->valueint < property.min_value()) {
+            return "Value is below minimum allowed: " + std::to_string(property.min_value());
+        }
+        if (property.has_range() && value->valueint > property.max_value()) {
+            return "Value exceeds maximum allowed: " + std::to_string(property.max_value());
+        }
+    } else if (property.type() == kPropertyTypeString) {
+        found = cJSON_IsString(value);
     }
-    
-    ReplyResult(id, json);
+    if (!property.has_default_value() && !found) {
+        return "Missing valid argument: " + property.name();
+    }
+    return "";
 }
 
-void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments) {
-    auto tool_iter = std::find_if(tools_.begin(), tools_.end(), 
-                                 [&tool_name](const McpTool* tool) { 
-                                     return tool->name() == tool_name; 
-                                 });
-    
-    if (tool_iter == tools_.end()) {
-        ESP_LOGE(TAG, "tools/call: Unknown tool: %s", tool_name.c_str());
-        ReplyError(id, "Unknown tool: " + tool_name);
+void McpServer::DoToolCall(int id, std::string_view tool_name, const cJSON* tool_arguments) {
+    McpTool* tool = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(tools_list_mutex_);
+        auto entry = tool_index_.find(tool_name);
+        if (entry != tool_index_.end()) {
+            tool = entry->second;
+        }
+    }
+    if (tool == nullptr) {
+        ESP_LOGE(TAG, "tools/call: Unknown tool: %.*s", (int)tool_name.size(), tool_name.data());
+        ReplyError(id, "Unknown tool: " + std::string(tool_name));
         return;
     }
 
-    PropertyList arguments = (*tool_iter)->properties();
-    try {
-        for (auto& argument : arguments) {
-            bool found = false;
-            if (cJSON_IsObject(tool_arguments)) {
-                auto value = cJSON_GetObjectItem(tool_arguments, argument.name().c_str());
-                if (argument.type() == kPropertyTypeBoolean && cJSON_IsBool(value)) {
-                    argument.set_value<bool>(value->valueint == 1);
-                    found = true;
-                } else if (argument.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
-                    argument.set_value<int>(value->valueint);
-                    found = true;
-                } else if (argument.type() == kPropertyTypeString && cJSON_IsString(value)) {
-                    argument.set_value<std::string>(value->valuestring);
-                    found = true;
-                }
-            }
+    // Validate straight from the request, the schema is only copied once every argument is good
+    const PropertyList& schema = tool->properties();
+    bool has_arguments = cJSON_IsObject(tool_arguments);
+    for (size_t i = 0; i < schema.size(); i++) {
+        const Property& property = schema.at(i);
+        auto value = has_arguments ? cJSON_GetObjectItem(tool_arguments, property.name().c_str()) : nullptr;
+        bool found;
+        auto error = ValidateArgument(property, value, found);
+        if (!error.empty()) {
+            ESP_LOGE(TAG, "tools/call: %s", error.c_str());
+            ReplyError(id, error);
+            return;
+        }
+    }
 
-            if (!argument.has_default_value() && !found) {
-                ESP_LOGE(TAG, "tools/call: Missing valid argument: %s", argument.name().c_str());
-                ReplyError(id, "Missing valid argument: " + argument.name());
-                return;
+    // Bind the values by slot, the checks above guarantee the types and ranges
+    PropertyList arguments = schema;
+    if (has_arguments) {
+        for (size_t i = 0; i < arguments.size(); i++) {
+            Property& argument = arguments.at(i);
+            auto value = cJSON_GetObjectItem(tool_arguments, argument.name().c_str());
+            if (argument.type() == kPropertyTypeBoolean && cJSON_IsBool(value)) {
+                argument.set_value<bool>(value->valueint == 1);
+            } else if (argument.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
+                argument.set_value<int>(value->valueint);
+            } else if (argument.type() == kPropertyTypeString && cJSON_IsString(value)) {
+                argument.set_value<std::string>(value->valuestring);
             }
         }
-    } catch (const std::exception& e) {
-        ESP_LOGE(TAG, "tools/call: %s", e.what());
-        ReplyError(id, e.what());
-        return;
     }
 
     // Use main thread to call the tool
     auto& app = Application::GetInstance();
-    app.Schedule([this, id, tool_iter, arguments = std::move(arguments)]() {
+    app.Schedule([this, id, tool, arguments = std::move(arguments)]() {
         try {
-            ReplyResult(id, (*tool_iter)->Call(arguments));
+            ReplyResult(id, tool->Call(arguments));
         } catch (const std::exception& e) {
             ESP_LOGE(TAG, "tools/call: %s", e.what());
             ReplyError(id, e.what());
@@ -4,11 +4,15 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <unordered_map>
+#include <string_view>
 #include <functional>
 #include <variant>
 #include <optional>
 #include <stdexcept>
 #include <thread>
+#include <mutex>
 #include <mbedtls/base64.h>
 
 #include <cJSON.h>
@@ -120,7 +124,8 @@ public:
         value_ = value;
     }
 
-    std::string to_json() const {
+    // The caller owns the returned tree
+    cJSON* to_cjson() const {
         cJSON *json = cJSON_CreateObject();
         
         if (type_ == kPropertyTypeBoolean) {
@@ -145,7 +150,11 @@ public:
                 cJSON_AddStringToObject(json, "default", value<std::string>().c_str());
             }
         }
-        
+        return json;
+    }
+
+    std::string to_json() const {
+        cJSON *json = to_cjson();
         char *json_str = cJSON_PrintUnformatted(json);
         std::string result(json_str);
         cJSON_free(json_str);
@@ -177,6 +186,11 @@ public:
 
     auto begin() { return properties_.begin(); }
     auto end() { return properties_.end(); }
+    auto begin() const { return properties_.begin(); }
+    auto end() const { return properties_.end(); }
+    size_t size() const { return properties_.size(); }
+    Property& at(size_t index) { return properties_[index]; }
+    const Property& at(size_t index) const { return properties_[index]; }
 
     std::vector<std::string> GetRequired() const {
         std::vector<std::string> required;
@@ -188,14 +202,17 @@ public:
         return required;
     }
 
-    std::string to_json() const {
+    // The caller owns the returned tree
+    cJSON* to_cjson() const {
         cJSON *json = cJSON_CreateObject();
-        
         for (const auto& property : properties_) {
-            cJSON *prop_json = cJSON_Parse(property.to_json().c_str());
-            cJSON_AddItemToObject(json, property.name().c_str(), prop_json);
+            cJSON_AddItemToObject(json, property.name().c_str(), property.to_cjson());
         }
-        
+        return json;
+    }
+
+    std::string to_json() const {
+        cJSON *json = to_cjson();
         char *json_str = cJSON_PrintUnformatted(json);
         std::string result(json_str);
         cJSON_free(json_str);
@@ -239,8 +256,7 @@ public:
         cJSON *input_schema = cJSON_CreateObject();
         cJSON_AddStringToObject(input_schema, "type", "object");
         
-        cJSON *properties = cJSON_Parse(properties_.to_json().c_str());
-        cJSON_AddItemToObject(input_schema, "properties", properties);
+        cJSON_AddItemToObject(input_schema, "properties", properties_.to_cjson());
         
         if (!required.empty()) {
             cJSON *required_array = cJSON_CreateArray();
@@ -311,6 +327,15 @@ public:
     }
 };
 
+// One tools/list reply, starting at the tool named by cursor (empty for the first page)
+struct ToolsListPage {
+    std::string cursor;
+    // Shared with replies in flight, so a lookup copies no JSON. nullptr if oversized_tool alone
+    // exceeds the payload limit.
+    std::shared_ptr<const std::string> result;
+    std::string oversized_tool;
+};
+
 class McpServer {
 public:
     static McpServer& GetInstance() {
@@ -336,9 +361,15 @@ private:
     void ReplyError(int id, const std::string& message);
 
     void GetToolsList(int id, const std::string& cursor, bool list_user_only_tools);
-    void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments);
+    void BuildToolsListPages(bool list_user_only_tools, std::vector<ToolsListPage>& pages);
+    void DoToolCall(int id, std::string_view tool_name, const cJSON* tool_arguments);
 
     std::vector<McpTool*> tools_;
+    std::unordered_map<std::string_view, McpTool*> tool_index_;
+    // Guards tools_, tool_index_ and the cached tools/list replies
+    std::mutex tools_list_mutex_;
+    // tools/list replies for the AI view [0] and the user view [1], built on first use
+    std::vector<ToolsListPage> tools_list_pages_[2];
 };
 
 #endif // MCP_SERVER_H
@@ -0,0 +1,81 @@
+#ifndef MPSC_RING_H
+#define MPSC_RING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/*
+ * Bounded multi-producer / single-consumer ring buffer.
+ *
+ * Every slot carries a sequence number that tells producers and the consumer whose turn it is,
+ * so producers only race on a compare-and-swap of the tail and never take a lock (the bounded
+ * queue design by Dmitry Vyukov). Pop() must only be called from one task.
+ */
+template <typename T, size_t Capacity>
+class MpscRing {
+    static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscRing() {
+        for (size_t i = 0; i < Capacity; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    // Any task. The item is only moved from when true is returned.
+    bool Push(T&& item) {
+        uint32_t position = tail_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[position & kMask];
+            uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+            int32_t diff = static_cast<int32_t>(sequence - position);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->item = std::move(item);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool Pop(T& item) {
+        Cell& cell = cells_[head_ & kMask];
+        uint32_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<int32_t>(sequence - (head_ + 1)) < 0) {
+            return false;
+        }
+        item = std::move(cell.item);
+        cell.sequence.store(head_ + Capacity, std::memory_order_release);
+        head_++;
+        return true;
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    static constexpr uint32_t kMask = Capacity - 1;
+
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        T item;
+    };
+
+    std::array<Cell, Capacity> cells_;
+    std::atomic<uint32_t> tail_{0};
+    uint32_t head_ = 0;
+};
+
+#endif // MPSC_RING_H
@@ -1,4 +1,6 @@
 #include "ota.h"
+#include "ota_downloader.h"
+#include "ota_delta.h"
 #include "system_info.h"
 #include "settings.h"
 #include "assets/lang_config.h"
@@ -86,6 +88,8 @@ bool Ota::CheckVersion() {
     }
 
     auto http = SetupHttp();
+    // Tells the server this firmware can apply delta patches, see scripts/ota_delta.py
+    http->SetHeader("Ota-Delta-Format", OTA_DELTA_MAGIC);
 
     std::string data = board.GetSystemInfoJson();
     std::string method = data.length() > 0 ? "POST" : "GET";
@@ -105,7 +109,8 @@ bool Ota::CheckVersion() {
     data = http->ReadAll();
     http->Close();
 
-    // Response: { "firmware": { "version": "1.0.0", "url": "http://" } }
+    // Response: { "firmware": { "version": "1.0.0", "url": "http://", "sha256": "...",
+    //     "deltas": [ { "base": "0.9.0", "url": "http://" } ] } }
     // Parse the JSON response and check if the version is newer
     // If it is, set has_new_version_ to true and store the new version and URL
     
@@ -217,6 +222,27 @@ bool Ota::CheckVersion() {
         if (cJSON_IsString(url)) {
             firmware_url_ = url->valuestring;
         }
+        // Optional, hex SHA-256 of the image the download is checked against
+        firmware_sha256_.clear();
+        cJSON *sha256 = cJSON_GetObjectItem(firmware, "sha256");
+        if (cJSON_IsString(sha256)) {
+            firmware_sha256_ = sha256->valuestring;
+            std::transform(firmware_sha256_.begin(), firmware_sha256_.end(), firmware_sha256_.begin(), ::tolower);
+        }
+        // Optional, patches to the new version from the versions listed as their base
+        delta_url_.clear();
+        cJSON *deltas = cJSON_GetObjectItem(firmware, "deltas");
+        if (cJSON_IsArray(deltas)) {
+            cJSON *delta = NULL;
+            cJSON_ArrayForEach(delta, deltas) {
+                cJSON *base = cJSON_GetObjectItem(delta, "base");
+                cJSON *delta_url = cJSON_GetObjectItem(delta, "url");
+                if (cJSON_IsString(base) && cJSON_IsString(delta_url) && current_version_ == base->valuestring) {
+                    delta_url_ = delta_url->valuestring;
+                    ESP_LOGI(TAG, "Delta update from %s available", base->valuestring);
+                }
+            }
+        }
 
         if (cJSON_IsString(version) && cJSON_IsString(url)) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -261,7 +287,26 @@ void Ota::MarkCurrentVersionValid() {
 }
 
 bool Ota::Upgrade(const std::string& firmware_url) {
-    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
+    // A delta is made against the running image, for the image CheckVersion() announced
+    if (firmware_url == firmware_url_ && !delta_url_.empty()) {
+        if (WriteImage(delta_url_, true)) {
+            return true;
+        }
+        ESP_LOGW(TAG, "Delta upgrade failed, downloading the full image");
+    }
+    if (WriteImage(firmware_url, false)) {
+        return true;
+    }
+    // The partition written so far is abandoned, the new image starts from its first byte
+    if (image_changed_) {
+        ESP_LOGW(TAG, "The image changed during the download, starting over");
+        return WriteImage(firmware_url, false);
+    }
+    return false;
+}
+
+bool Ota::WriteImage(const std::string& url, bool delta) {
+    ESP_LOGI(TAG, "Upgrading firmware from %s%s", url.c_str(), delta ? " (delta)" : "");
     esp_ota_handle_t update_handle = 0;
     auto update_partition = esp_ota_get_next_update_partition(NULL);
     if (update_partition == NULL) {
@@ -273,78 +318,69 @@ bool Ota::Upgrade(const std::string& firmware_url) {
     bool image_header_checked = false;
     std::string image_header;
 
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
-    if (!http->Open("GET", firmware_url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return false;
-    }
-
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
-        return false;
-    }
-
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
-        return false;
-    }
-
-    char buffer[512];
-    size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            return false;
-        }
-
-        // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
-            if (upgrade_callback_) {
-                upgrade_callback_(progress, recent_read);
+    // Runs on the write task of the downloader while the next buffer is being received
+    OtaDownloader::WriteHandler image_writer = [&](const uint8_t* data, size_t size) {
+        if (!image_header_checked) {
+            image_header.append((const char*)data, size);
+            if (image_header.size() < sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+                return true;
             }
-            last_calc_time = esp_timer_get_time();
-            recent_read = 0;
-        }
+            esp_app_desc_t new_app_info;
+            memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
 
-        if (ret == 0) {
-            break;
-        }
+            auto current_version = esp_app_get_description()->version;
+            ESP_LOGI(TAG, "Current version: %s, New version: %s", current_version, new_app_info.version);
 
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-                
-                auto current_version = esp_app_get_description()->version;
-                ESP_LOGI(TAG, "Current version: %s, New version: %s", current_version, new_app_info.version);
-
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    return false;
-                }
+            if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
+                esp_ota_abort(update_handle);
+                ESP_LOGE(TAG, "Failed to begin OTA");
+                return false;
+            }
+            image_header_checked = true;
 
-                image_header_checked = true;
-                std::string().swap(image_header);
+            auto err = esp_ota_write(update_handle, image_header.data(), image_header.size());
+            std::string().swap(image_header);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+                return false;
             }
+            return true;
         }
-        auto err = esp_ota_write(update_handle, buffer, ret);
+        auto err = esp_ota_write(update_handle, data, size);
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
             return false;
         }
+        return true;
+    };
+
+    OtaDownloader downloader;
+    bool downloaded;
+    image_changed_ = false;
+    if (delta) {
+        // The patch is applied on the write task as well, from the running partition into the image writer
+        OtaDeltaPatcher patcher(esp_ota_get_running_partition(), image_writer);
+        downloaded = downloader.Download(url, [&patcher](const uint8_t* data, size_t size) {
+            return patcher.Feed(data, size);
+        }, upgrade_callback_);
+        downloaded = downloaded && patcher.Finish();
+    } else {
+        downloaded = downloader.Download(url, image_writer, upgrade_callback_);
+        image_changed_ = downloader.image_changed();
+        // The hash announced by CheckVersion() only applies to the image it announced
+        if (downloaded && url == firmware_url_ && !firmware_sha256_.empty() && downloader.GetSha256Hex() != firmware_sha256_) {
+            ESP_LOGE(TAG, "Firmware SHA-256 mismatch, expected %s", firmware_sha256_.c_str());
+            downloaded = false;
+        }
+    }
+
+    if (!downloaded || !image_header_checked) {
+        ESP_LOGE(TAG, "Failed to download firmware");
+        if (image_header_checked) {
+            esp_ota_abort(update_handle);
+        }
+        return false;
     }
-    http->Close();
 
     esp_err_t err = esp_ota_end(update_handle);
     if (err != ESP_OK) {
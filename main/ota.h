@@ -44,11 +44,15 @@ private:
     std::string current_version_;
     std::string firmware_version_;
     std::string firmware_url_;
+    std::string firmware_sha256_;
+    std::string delta_url_;
+    bool image_changed_ = false;  // The last full image download failed because the server replaced it
     std::string activation_challenge_;
     std::string serial_number_;
     int activation_timeout_ms_ = 30000;
 
     bool Upgrade(const std::string& firmware_url);
+    bool WriteImage(const std::string& url, bool delta);
     std::function<void(int progress, size_t speed)> upgrade_callback_;
     std::vector<int> ParseVersion(const std::string& version);
     bool IsNewVersionAvailable(const std::string& currentVersion, const std::string& newVersion);
@@ -0,0 +1,277 @@
+#include "ota_delta.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "OtaDelta"
+
+static uint32_t ReadU32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+OtaDeltaPatcher::OtaDeltaPatcher(const esp_partition_t* base_partition, OutputHandler output_handler)
+    : base_partition_(base_partition), output_handler_(std::move(output_handler)) {
+    base_cache_ = (uint8_t*)heap_caps_malloc(OTA_DELTA_BASE_CACHE_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    output_ = (uint8_t*)heap_caps_malloc(OTA_DELTA_OUTPUT_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (base_cache_ == nullptr || output_ == nullptr) {
+        Fail("out of memory");
+    }
+    mbedtls_sha256_init(&sha256_);
+    mbedtls_sha256_starts(&sha256_, 0);
+}
+
+OtaDeltaPatcher::~OtaDeltaPatcher() {
+    mbedtls_sha256_free(&sha256_);
+    if (base_cache_ != nullptr) {
+        heap_caps_free(base_cache_);
+    }
+    if (output_ != nullptr) {
+        heap_caps_free(output_);
+    }
+}
+
+bool OtaDeltaPatcher::Fail(const char* reason) {
+    if (state_ != kStateError) {
+        ESP_LOGE(TAG, "Patch failed at output %lu: %s", output_total_, reason);
+        state_ = kStateError;
+    }
+    return false;
+}
+
+bool OtaDeltaPatcher::ParseHeader() {
+    if (memcmp(header_.data(), OTA_DELTA_MAGIC, 4) != 0) {
+        return Fail("not a delta patch");
+    }
+    base_size_ = ReadU32(&header_[4]);
+    target_size_ = ReadU32(&header_[40]);
+    memcpy(target_sha256_.data(), &header_[44], target_sha256_.size());
+
+    uint8_t running_sha256[32];
+    if (base_size_ > base_partition_->size ||
+        esp_partition_get_sha256(base_partition_, running_sha256) != ESP_OK ||
+        memcmp(running_sha256, &header_[8], sizeof(running_sha256)) != 0) {
+        return Fail("patch is for another base image");
+    }
+    ESP_LOGI(TAG, "Patching %lu bytes of %s into %lu bytes", base_size_, base_partition_->label, target_size_);
+    state_ = kStateOp;
+    return true;
+}
+
+bool OtaDeltaPatcher::StartRecord() {
+    field_count_ = 0;
+    varint_ = 0;
+    varint_shift_ = 0;
+    add_have_zero_run_ = false;
+    switch (op_) {
+    case kOpEnd:
+        state_ = kStateDone;
+        return FlushOutput();
+    case kOpCopy:
+    case kOpAdd:
+    case kOpInsert:
+        state_ = kStateVarint;
+        return true;
+    default:
+        return Fail("unknown record");
+    }
+}
+
+bool OtaDeltaPatcher::OnVarint(uint32_t value) {
+    varint_ = 0;
+    varint_shift_ = 0;
+    if (field_count_ < 2) {
+        fields_[field_count_++] = value;
+    }
+
+    if (op_ == kOpInsert) {
+        remaining_ = fields_[0];
+        state_ = remaining_ > 0 ? kStateInsert : kStateOp;
+        return true;
+    }
+    if (field_count_ < 2) {
+        return true;
+    }
+
+    if (op_ == kOpCopy) {
+        base_offset_ = fields_[0];
+        state_ = kStateOp;
+        return CopyBase(fields_[1]);
+    }
+
+    // ADD: offset and length, then pairs of zero run and literal count
+    if (field_count_ == 2) {
+        base_offset_ = fields_[0];
+        remaining_ = fields_[1];
+        field_count_ = 3;
+        state_ = remaining_ > 0 ? kStateVarint : kStateOp;
+        return true;
+    }
+    if (!add_have_zero_run_) {
+        if (value > remaining_) {
+            return Fail("zero run past the record");
+        }
+        add_have_zero_run_ = true;
+        return CopyBase(value);
+    }
+    add_have_zero_run_ = false;
+    if (value > remaining_) {
+        return Fail("literals past the record");
+    }
+    literals_ = value;
+    if (literals_ > 0) {
+        state_ = kStateAddLiterals;
+    } else if (remaining_ == 0) {
+        state_ = kStateOp;
+    }
+    return true;
+}
+
+bool OtaDeltaPatcher::ReadBase(uint32_t offset, uint8_t& value) {
+    if (offset >= base_size_) {
+        return Fail("base offset out of range");
+    }
+    if (offset < base_cache_offset_ || offset >= base_cache_offset_ + base_cache_size_) {
+        base_cache_offset_ = offset;
+        base_cache_size_ = std::min<size_t>(OTA_DELTA_BASE_CACHE_SIZE, base_size_ - offset);
+        if (esp_partition_read(base_partition_, offset, base_cache_, base_cache_size_) != ESP_OK) {
+            base_cache_size_ = 0;
+            return Fail("failed to read the base image");
+        }
+    }
+    value = base_cache_[offset - base_cache_offset_];
+    return true;
+}
+
+// Copies base bytes from base_offset_, counted against the bytes left in an ADD record
+bool OtaDeltaPatcher::CopyBase(uint32_t length) {
+    if (op_ == kOpAdd) {
+        remaining_ -= length;
+    }
+    while (length > 0) {
+        uint8_t value;
+        if (!ReadBase(base_offset_, value)) {
+            return false;
+        }
+        // Everything the cache holds from here on goes out in one piece
+        size_t cached = base_cache_offset_ + base_cache_size_ - base_offset_;
+        size_t count = std::min<size_t>({length, cached, OTA_DELTA_OUTPUT_SIZE - output_size_});
+        memcpy(output_ + output_size_, base_cache_ + (base_offset_ - base_cache_offset_), count);
+        output_size_ += count;
+        base_offset_ += count;
+        length -= count;
+        if (output_size_ == OTA_DELTA_OUTPUT_SIZE && !FlushOutput()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OtaDeltaPatcher::Output(uint8_t value) {
+    output_[output_size_++] = value;
+    if (output_size_ == OTA_DELTA_OUTPUT_SIZE) {
+        return FlushOutput();
+    }
+    return true;
+}
+
+bool OtaDeltaPatcher::FlushOutput() {
+    if (output_size_ == 0) {
+        return true;
+    }
+    output_total_ += output_size_;
+    if (output_total_ > target_size_) {
+        return Fail("output larger than the target");
+    }
+    mbedtls_sha256_update(&sha256_, output_, output_size_);
+    bool ok = output_handler_(output_, output_size_);
+    output_size_ = 0;
+    return ok ? true : Fail("output failed");
+}
+
+bool OtaDeltaPatcher::Feed(const uint8_t* data, size_t size) {
+    size_t pos = 0;
+    while (pos < size) {
+        switch (state_) {
+        case kStateHeader: {
+            size_t count = std::min(size - pos, header_.size() - header_size_);
+            memcpy(header_.data() + header_size_, data + pos, count);
+            header_size_ += count;
+            pos += count;
+            if (header_size_ == header_.size() && !ParseHeader()) {
+                return false;
+            }
+            break;
+        }
+        case kStateOp:
+            op_ = data[pos++];
+            if (!StartRecord()) {
+                return false;
+            }
+            break;
+        case kStateVarint: {
+            uint8_t byte = data[pos++];
+            if (varint_shift_ > 28) {
+                return Fail("varint too long");
+            }
+            varint_ |= (uint32_t)(byte & 0x7F) << varint_shift_;
+            varint_shift_ += 7;
+            if ((byte & 0x80) == 0 && !OnVarint(varint_)) {
+                return false;
+            }
+            break;
+        }
+        case kStateInsert: {
+            size_t count = std::min<size_t>({size - pos, remaining_, OTA_DELTA_OUTPUT_SIZE - output_size_});
+            memcpy(output_ + output_size_, data + pos, count);
+            output_size_ += count;
+            remaining_ -= count;
+            pos += count;
+            if (output_size_ == OTA_DELTA_OUTPUT_SIZE && !FlushOutput()) {
+                return false;
+            }
+            if (remaining_ == 0) {
+                state_ = kStateOp;
+            }
+            break;
+        }
+        case kStateAddLiterals: {
+            uint8_t base_value;
+            if (!ReadBase(base_offset_++, base_value) || !Output(base_value + data[pos++])) {
+                return false;
+            }
+            remaining_--;
+            if (--literals_ == 0) {
+                state_ = remaining_ > 0 ? kStateVarint : kStateOp;
+            }
+            break;
+        }
+        case kStateDone:
+            return Fail("data after the end record");
+        case kStateError:
+            return false;
+        }
+    }
+    return state_ != kStateError;
+}
+
+bool OtaDeltaPatcher::Finish() {
+    if (state_ == kStateError) {
+        return false;
+    }
+    if (state_ != kStateDone) {
+        return Fail("patch ended early");
+    }
+    if (output_total_ != target_size_) {
+        return Fail("output size does not match the target");
+    }
+    std::array<uint8_t, 32> sha256;
+    mbedtls_sha256_finish(&sha256_, sha256.data());
+    if (sha256 != target_sha256_) {
+        return Fail("output hash does not match the target");
+    }
+    ESP_LOGI(TAG, "Patched image verified, %lu bytes", output_total_);
+    return true;
+}
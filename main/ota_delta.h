@@ -0,0 +1,110 @@
+#ifndef OTA_DELTA_H
+#define OTA_DELTA_H
+
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#define OTA_DELTA_MAGIC "XZD1"
+#define OTA_DELTA_HEADER_SIZE 76
+#define OTA_DELTA_BASE_CACHE_SIZE 4096
+#define OTA_DELTA_OUTPUT_SIZE 4096
+
+/*
+ * Applies a delta firmware patch while it streams in, made by scripts/ota_delta.py from the
+ * image the device runs and the new image.
+ *
+ * Patch layout, little endian, lengths and offsets are LEB128 varints:
+ *   "XZD1", u32 base size, u8[32] base image hash, u32 target size, u8[32] target sha256
+ *   records until END:
+ *     0x01 COPY    base offset, length                 target bytes are base bytes
+ *     0x02 ADD     base offset, length, then (zero run, literal count, literals...) pairs
+ *                  covering length: target byte = base byte + literal, a zero run copies
+ *     0x03 INSERT  length, bytes
+ *     0x00 END
+ *
+ * The base hash is the SHA-256 appended to the base image, the one esp_partition_get_sha256()
+ * returns for the running partition, so a patch for another build is rejected by its header.
+ * Base bytes are read from flash through a small cache and the output is passed on in small
+ * blocks, so RAM use does not depend on the image size.
+ */
+class OtaDeltaPatcher {
+public:
+    // Receives the patched image in order, returning false aborts the patch
+    using OutputHandler = std::function<bool(const uint8_t* data, size_t size)>;
+
+    OtaDeltaPatcher(const esp_partition_t* base_partition, OutputHandler output_handler);
+    ~OtaDeltaPatcher();
+
+    // Next part of the patch, false if it is malformed, not for this base, or the output failed
+    bool Feed(const uint8_t* data, size_t size);
+    // After the last part: true if the patch ended and the image has the target size and hash
+    bool Finish();
+
+    size_t target_size() const { return target_size_; }
+
+private:
+    enum State {
+        kStateHeader,
+        kStateOp,
+        kStateVarint,
+        kStateInsert,
+        kStateAddLiterals,
+        kStateDone,
+        kStateError,
+    };
+    enum Op {
+        kOpEnd = 0x00,
+        kOpCopy = 0x01,
+        kOpAdd = 0x02,
+        kOpInsert = 0x03,
+    };
+
+    const esp_partition_t* base_partition_;
+    OutputHandler output_handler_;
+    State state_ = kStateHeader;
+
+    std::array<uint8_t, OTA_DELTA_HEADER_SIZE> header_ = {};
+    size_t header_size_ = 0;
+    uint32_t base_size_ = 0;
+    uint32_t target_size_ = 0;
+    std::array<uint8_t, 32> target_sha256_ = {};
+
+    // The record being parsed: its op and the varints read so far
+    uint8_t op_ = kOpEnd;
+    uint32_t fields_[2] = {};
+    int field_count_ = 0;
+    uint32_t varint_ = 0;
+    int varint_shift_ = 0;
+
+    // Position in the base image and bytes left in the current record
+    uint32_t base_offset_ = 0;
+    uint32_t remaining_ = 0;
+    // ADD: a zero run was read and the literal count comes next
+    bool add_have_zero_run_ = false;
+    uint32_t literals_ = 0;
+
+    uint8_t* base_cache_ = nullptr;
+    uint32_t base_cache_offset_ = 0;
+    size_t base_cache_size_ = 0;
+
+    uint8_t* output_ = nullptr;
+    size_t output_size_ = 0;
+    uint32_t output_total_ = 0;
+    mbedtls_sha256_context sha256_;
+
+    bool ParseHeader();
+    bool StartRecord();
+    bool OnVarint(uint32_t value);
+    bool ReadBase(uint32_t offset, uint8_t& value);
+    bool CopyBase(uint32_t length);
+    bool Output(uint8_t value);
+    bool FlushOutput();
+    bool Fail(const char* reason);
+};
+
+#endif // OTA_DELTA_H
@@ -0,0 +1,266 @@
+#include "ota_downloader.h"
+#include "board.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <mbedtls/sha256.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#define TAG "OtaDownloader"
+
+// Tells the write task that no more buffers follow
+#define END_OF_BODY -1
+
+OtaDownloader::OtaDownloader() {
+    free_queue_ = xQueueCreate(OTA_DOWNLOAD_BUFFERS, sizeof(int));
+    full_queue_ = xQueueCreate(OTA_DOWNLOAD_BUFFERS + 1, sizeof(int));
+    write_done_ = xSemaphoreCreateBinary();
+}
+
+OtaDownloader::~OtaDownloader() {
+    for (auto& buffer : buffers_) {
+        if (buffer.data != nullptr) {
+            heap_caps_free(buffer.data);
+        }
+    }
+    vQueueDelete(free_queue_);
+    vQueueDelete(full_queue_);
+    vSemaphoreDelete(write_done_);
+}
+
+bool OtaDownloader::AllocateBuffers() {
+    for (auto& buffer : buffers_) {
+        if (buffer.data != nullptr) {
+            continue;
+        }
+        // Keep internal RAM for the network stack if there is PSRAM, flash writes copy through a bounce buffer
+        buffer.data = (uint8_t*)heap_caps_aligned_alloc(4, OTA_DOWNLOAD_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
+        if (buffer.data == nullptr) {
+            buffer.data = (uint8_t*)heap_caps_aligned_alloc(4, OTA_DOWNLOAD_BUFFER_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+        if (buffer.data == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate the download buffers");
+            return false;
+        }
+    }
+    return true;
+}
+
+// What identifies the image a response is for, so a resumed request can ask for the same one with
+// If-Range. Weak ETags are not allowed there, Last-Modified is used instead.
+static std::string GetValidator(Http* http) {
+    std::string etag = http->GetResponseHeader("ETag");
+    if (!etag.empty() && etag.compare(0, 2, "W/") != 0) {
+        return etag;
+    }
+    return http->GetResponseHeader("Last-Modified");
+}
+
+std::string OtaDownloader::GetSha256Hex() const {
+    std::string hex;
+    hex.reserve(sha256_.size() * 2);
+    for (auto byte : sha256_) {
+        char buffer[3];
+        snprintf(buffer, sizeof(buffer), "%02x", byte);
+        hex += buffer;
+    }
+    return hex;
+}
+
+void OtaDownloader::WriteTask() {
+    int index;
+    while (xQueueReceive(full_queue_, &index, portMAX_DELAY) == pdTRUE && index != END_OF_BODY) {
+        auto& buffer = buffers_[index];
+        // After a failure the buffers still go back, so the receiving task does not block
+        if (!write_failed_ && !write_handler_(buffer.data, buffer.size)) {
+            write_failed_ = true;
+        }
+        xQueueSend(free_queue_, &index, portMAX_DELAY);
+    }
+    xSemaphoreGive(write_done_);
+}
+
+bool OtaDownloader::Download(const std::string& url, WriteHandler write_handler, ProgressHandler progress_handler) {
+    if (!AllocateBuffers()) {
+        return false;
+    }
+
+    write_handler_ = std::move(write_handler);
+    write_failed_ = false;
+    image_changed_ = false;
+    size_ = 0;
+    xQueueReset(free_queue_);
+    xQueueReset(full_queue_);
+    for (int i = 0; i < OTA_DOWNLOAD_BUFFERS; i++) {
+        xQueueSend(free_queue_, &i, 0);
+    }
+
+    if (xTaskCreate([](void* arg) {
+        ((OtaDownloader*)arg)->WriteTask();
+        vTaskDelete(NULL);
+    }, "ota_write", OTA_WRITE_TASK_STACK_SIZE, this, uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the write task");
+        return false;
+    }
+
+    mbedtls_sha256_context sha256;
+    mbedtls_sha256_init(&sha256);
+    mbedtls_sha256_starts(&sha256, 0);
+
+    auto network = Board::GetInstance().GetNetwork();
+    std::unique_ptr<Http> http;
+    size_t content_length = 0;
+    size_t offset = 0;      // Bytes received in order and hashed, a reconnect resumes from here
+    size_t skip = 0;        // Bytes of a full response that were already received before
+    std::string validator;  // ETag or Last-Modified of the first response, empty if it had neither
+    int retries = 0;
+    int reconnects = 0;
+    int index = END_OF_BODY;
+    bool completed = false;
+    size_t recent_read = 0;
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+
+    while (!write_failed_) {
+        if (!http) {
+            if (retries > 0) {
+                if (retries > OTA_DOWNLOAD_MAX_RETRIES) {
+                    ESP_LOGE(TAG, "Giving up after %d retries at %u/%u", OTA_DOWNLOAD_MAX_RETRIES, offset, content_length);
+                    break;
+                }
+                ESP_LOGW(TAG, "Resuming at %u/%u, retry %d", offset, content_length, retries);
+                vTaskDelay(pdMS_TO_TICKS(OTA_DOWNLOAD_RETRY_DELAY_MS * retries));
+                reconnects++;
+            }
+
+            http = network->CreateHttp(0);
+            if (offset > 0) {
+                http->SetHeader("Range", "bytes=" + std::to_string(offset) + "-");
+                // A server with a different image by now answers 200 with all of it instead
+                if (!validator.empty()) {
+                    http->SetHeader("If-Range", validator);
+                }
+            }
+            if (!http->Open("GET", url)) {
+                ESP_LOGE(TAG, "Failed to open HTTP connection");
+                http.reset();
+                retries++;
+                continue;
+            }
+
+            int status_code = http->GetStatusCode();
+            size_t body_length = http->GetBodyLength();
+            if (status_code == 200 && offset > 0 && GetValidator(http.get()) != validator) {
+                // The bytes passed on are from another image, only starting over can fix that
+                ESP_LOGW(TAG, "The image changed on the server at %u/%u", offset, content_length);
+                image_changed_ = true;
+                http->Close();
+                http.reset();
+                break;
+            }
+            if (status_code == 200 && (content_length == 0 || body_length == content_length)) {
+                if (content_length == 0) {
+                    validator = GetValidator(http.get());
+                }
+                content_length = body_length;
+                skip = offset;
+            } else if (status_code == 206 && offset > 0 && body_length == content_length - offset) {
+                skip = 0;
+            } else {
+                ESP_LOGE(TAG, "Unexpected response, status code: %d, body length: %u", status_code, body_length);
+                http->Close();
+                http.reset();
+                // A server error may go away, a missing file or a changed image will not
+                if (status_code >= 500) {
+                    retries++;
+                    continue;
+                }
+                break;
+            }
+            if (content_length == 0) {
+                ESP_LOGE(TAG, "Failed to get content length");
+                break;
+            }
+        }
+
+        if (index == END_OF_BODY) {
+            xQueueReceive(free_queue_, &index, portMAX_DELAY);
+            buffers_[index].size = 0;
+            if (write_failed_) {
+                break;
+            }
+        }
+
+        auto& buffer = buffers_[index];
+        size_t to_read = std::min(OTA_DOWNLOAD_BUFFER_SIZE - buffer.size, skip > 0 ? skip : content_length - offset);
+        int ret = http->Read((char*)buffer.data + buffer.size, to_read);
+        if (ret <= 0) {
+            // An early end of the body is a dropped connection as well
+            ESP_LOGW(TAG, "Connection lost at %u/%u: %d", offset, content_length, ret);
+            http->Close();
+            http.reset();
+            retries++;
+            continue;
+        }
+        retries = 0;
+        if (skip > 0) {
+            skip -= ret;
+            continue;
+        }
+
+        mbedtls_sha256_update(&sha256, buffer.data + buffer.size, ret);
+        buffer.size += ret;
+        offset += ret;
+        recent_read += ret;
+        if (buffer.size == OTA_DOWNLOAD_BUFFER_SIZE || offset == content_length) {
+            xQueueSend(full_queue_, &index, portMAX_DELAY);
+            index = END_OF_BODY;
+        }
+
+        // Calculate speed and progress every second
+        if (esp_timer_get_time() - last_calc_time >= 1000000 || offset == content_length) {
+            size_t progress = offset * 100 / content_length;
+            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, offset, content_length, recent_read);
+            if (progress_handler) {
+                progress_handler(progress, recent_read);
+            }
+            last_calc_time = esp_timer_get_time();
+            recent_read = 0;
+        }
+
+        if (offset == content_length) {
+            completed = true;
+            break;
+        }
+    }
+
+    if (http) {
+        http->Close();
+    }
+    if (index != END_OF_BODY) {
+        xQueueSend(free_queue_, &index, portMAX_DELAY);
+    }
+    int end = END_OF_BODY;
+    xQueueSend(full_queue_, &end, portMAX_DELAY);
+    xSemaphoreTake(write_done_, portMAX_DELAY);
+
+    mbedtls_sha256_finish(&sha256, sha256_.data());
+    mbedtls_sha256_free(&sha256);
+
+    if (write_failed_) {
+        ESP_LOGE(TAG, "Failed to write the download at %u/%u", offset, content_length);
+        return false;
+    }
+    if (!completed) {
+        return false;
+    }
+
+    size_ = content_length;
+    uint32_t elapsed_ms = (esp_timer_get_time() - start_time) / 1000;
+    ESP_LOGI(TAG, "Downloaded %u bytes in %lums (%lu KB/s), reconnects: %d, sha256: %s", size_, elapsed_ms,
+        (uint32_t)(size_ / std::max<uint32_t>(elapsed_ms, 1)), reconnects, GetSha256Hex().c_str());
+    return true;
+}
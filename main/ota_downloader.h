@@ -0,0 +1,78 @@
+#ifndef OTA_DOWNLOADER_H
+#define OTA_DOWNLOADER_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#define OTA_DOWNLOAD_BUFFER_SIZE (16 * 1024)
+#define OTA_DOWNLOAD_BUFFERS 2
+// Reconnects in a row without getting any data before the download is given up
+#define OTA_DOWNLOAD_MAX_RETRIES 5
+#define OTA_DOWNLOAD_RETRY_DELAY_MS 1000
+#define OTA_WRITE_TASK_STACK_SIZE (4096 * 2)
+
+/*
+ * Downloads an image over HTTP into a handler that writes it to flash, e.g. esp_ota_write().
+ *
+ * The calling task only receives: it fills one of two large buffers while the write task hands
+ * the other one to the handler, so flash erase and program overlap with the network instead of
+ * alternating with it every 512 bytes.
+ *
+ * When the connection drops, the download resumes with an HTTP Range request from the first byte
+ * that was not passed on yet, so the handler sees the body exactly once and in order. The request
+ * carries If-Range with the ETag or Last-Modified of the first response, so a server whose image
+ * changed in between sends the new one in full. That ends the download with image_changed() set,
+ * the caller has to start over. A server that ignores the range and sends the same image again
+ * is skipped up to that offset.
+ *
+ * The SHA-256 of the body is computed while it streams through, so an image can be checked
+ * against the hash the server announced before it is made bootable.
+ */
+class OtaDownloader {
+public:
+    // Called on the write task with the next part of the body, returning false aborts the download
+    using WriteHandler = std::function<bool(const uint8_t* data, size_t size)>;
+    using ProgressHandler = std::function<void(int progress, size_t speed)>;
+
+    OtaDownloader();
+    ~OtaDownloader();
+
+    bool Download(const std::string& url, WriteHandler write_handler, ProgressHandler progress_handler = nullptr);
+
+    size_t size() const { return size_; }
+    // The server replaced the image during the last Download(), which failed because of that
+    bool image_changed() const { return image_changed_; }
+    // SHA-256 of the body, valid after Download() returned true
+    const std::array<uint8_t, 32>& sha256() const { return sha256_; }
+    std::string GetSha256Hex() const;
+
+private:
+    struct Buffer {
+        uint8_t* data = nullptr;
+        size_t size = 0;
+    };
+
+    std::array<Buffer, OTA_DOWNLOAD_BUFFERS> buffers_;
+    QueueHandle_t free_queue_ = nullptr;
+    QueueHandle_t full_queue_ = nullptr;
+    SemaphoreHandle_t write_done_ = nullptr;
+    WriteHandler write_handler_;
+    std::atomic<bool> write_failed_ = false;
+    bool image_changed_ = false;
+
+    size_t size_ = 0;
+    std::array<uint8_t, 32> sha256_ = {};
+
+    bool AllocateBuffers();
+    void WriteTask();
+};
+
+#endif // OTA_DOWNLOADER_H
@@ -0,0 +1,222 @@
+#include "audio_channel_warmer.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+#define TAG "ChannelWarmer"
+
+AudioChannelWarmer::AudioChannelWarmer() {
+    event_group_ = xEventGroupCreate();
+}
+
+AudioChannelWarmer::~AudioChannelWarmer() {
+    if (warm_task_ != nullptr) {
+        vTaskDelete(warm_task_);
+    }
+    vEventGroupDelete(event_group_);
+}
+
+void AudioChannelWarmer::SetProtocol(Protocol* protocol) {
+    protocol_ = protocol;
+#if CONFIG_AUDIO_CHANNEL_PRECONNECT
+    if (warm_task_ == nullptr) {
+        // Same stack as the main event loop, which otherwise runs the TLS handshake
+        xTaskCreate([](void* arg) {
+            ((AudioChannelWarmer*)arg)->WarmTask();
+            vTaskDelete(NULL);
+        }, "channel_warmer", 2048 * 4, this, 2, &warm_task_);
+    }
+#endif
+}
+
+void AudioChannelWarmer::Warm(const char* reason) {
+#if CONFIG_AUDIO_CHANNEL_PRECONNECT
+    if (protocol_ == nullptr || warm_task_ == nullptr || speculating() || protocol_->IsAudioChannelOpened()) {
+        return;
+    }
+    if (!TakeBudget()) {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        budget_denied_++;
+        ESP_LOGD(TAG, "No budget left to warm up the channel (%s)", reason);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        warm_attempts_++;
+    }
+    ESP_LOGI(TAG, "Warming up the audio channel (%s)", reason);
+    warm_reason_ = reason;
+    xEventGroupClearBits(event_group_, AUDIO_CHANNEL_WARMER_DONE_EVENT);
+    speculating_.store(true, std::memory_order_release);
+    xTaskNotifyGive(warm_task_);
+#endif
+}
+
+void AudioChannelWarmer::WarmTask() {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        auto start_time = esp_timer_get_time();
+        bool opened = protocol_->OpenAudioChannel();
+        auto end_time = esp_timer_get_time();
+        uint32_t elapsed_ms = (end_time - start_time) / 1000;
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            if (opened) {
+                warm_connect_ms_.Record(elapsed_ms);
+            } else {
+                warm_failures_++;
+            }
+        }
+        ESP_LOGI(TAG, "Warm-up %s in %lu ms", opened ? "done" : "failed", elapsed_ms);
+
+        warm_channel_ = opened;
+        warm_opened_time_us_ = end_time;
+        speculating_.store(false, std::memory_order_release);
+        xEventGroupSetBits(event_group_, AUDIO_CHANNEL_WARMER_DONE_EVENT);
+        if (on_done_) {
+            on_done_();
+        }
+    }
+}
+
+bool AudioChannelWarmer::Wait(TickType_t timeout) {
+    if (!speculating()) {
+        return true;
+    }
+
+    auto start_time = esp_timer_get_time();
+    auto bits = xEventGroupWaitBits(event_group_, AUDIO_CHANNEL_WARMER_DONE_EVENT, pdFALSE, pdTRUE, timeout);
+    uint32_t waited_ms = (esp_timer_get_time() - start_time) / 1000;
+    if (!(bits & AUDIO_CHANNEL_WARMER_DONE_EVENT)) {
+        ESP_LOGW(TAG, "Warm-up still in flight after %lu ms", waited_ms);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    claim_wait_ms_.Record(waited_ms);
+    ESP_LOGI(TAG, "Waited %lu ms for the warm-up", waited_ms);
+    return true;
+}
+
+bool AudioChannelWarmer::Claim() {
+    if (protocol_ == nullptr) {
+        return false;
+    }
+
+    // The handshake may already be under way, waiting for it is never slower than starting over
+    Wait();
+
+    if (!protocol_->IsAudioChannelOpened()) {
+        warm_channel_ = false;
+        return false;
+    }
+
+    if (warm_channel_) {
+        warm_channel_ = false;
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        warm_hits_++;
+        ESP_LOGI(TAG, "Using the channel warmed up %ld ms ago (%s)",
+            (long)((esp_timer_get_time() - warm_opened_time_us_) / 1000), warm_reason_);
+    }
+    return true;
+}
+
+bool AudioChannelWarmer::Open() {
+    if (protocol_ == nullptr) {
+        return false;
+    }
+
+    auto start_time = esp_timer_get_time();
+    bool opened = protocol_->OpenAudioChannel();
+    if (opened) {
+        uint32_t elapsed_ms = (esp_timer_get_time() - start_time) / 1000;
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        cold_connect_ms_.Record(elapsed_ms);
+        ESP_LOGI(TAG, "Audio channel opened in %lu ms (p50=%lu p90=%lu)", elapsed_ms,
+            cold_connect_ms_.Percentile(50), cold_connect_ms_.Percentile(90));
+    }
+    return opened;
+}
+
+void AudioChannelWarmer::OnClockTick(bool idle) {
+#if CONFIG_AUDIO_CHANNEL_PRECONNECT
+    if (!idle || protocol_ == nullptr || speculating()) {
+        return;
+    }
+
+#if CONFIG_AUDIO_CHANNEL_KEEP_WARM
+    if (!protocol_->IsAudioChannelOpened()) {
+        Warm("keep warm");
+    }
+#else
+    if (warm_channel_ && esp_timer_get_time() - warm_opened_time_us_ >= CONFIG_AUDIO_CHANNEL_PRECONNECT_IDLE_TIMEOUT * 1000000LL) {
+        warm_channel_ = false;
+        if (protocol_->IsAudioChannelOpened()) {
+            ESP_LOGI(TAG, "Closing the unused warm channel (%s)", warm_reason_);
+            protocol_->CloseAudioChannel();
+        }
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        warm_expired_++;
+    }
+#endif
+#endif
+}
+
+bool AudioChannelWarmer::TakeBudget() {
+#if CONFIG_AUDIO_CHANNEL_PRECONNECT
+    const int max_tokens = CONFIG_AUDIO_CHANNEL_PRECONNECT_MAX_PER_HOUR;
+    const int64_t refill_interval_us = 3600LL * 1000000 / max_tokens;
+    auto now = esp_timer_get_time();
+    if (budget_refill_time_us_ == 0) {
+        budget_tokens_ = max_tokens;
+        budget_refill_time_us_ = now;
+    }
+
+    int refill = (now - budget_refill_time_us_) / refill_interval_us;
+    if (refill > 0) {
+        budget_tokens_ = std::min(max_tokens, budget_tokens_ + refill);
+        budget_refill_time_us_ += refill * refill_interval_us;
+    }
+    if (budget_tokens_ == max_tokens) {
+        // A full bucket does not save up time
+        budget_refill_time_us_ = now;
+    }
+
+    if (budget_tokens_ == 0) {
+        return false;
+    }
+    budget_tokens_--;
+    return true;
+#else
+    return false;
+#endif
+}
+
+cJSON* AudioChannelWarmer::GetStatsJson() {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddItemToObject(json, "cold_connect_ms", cold_connect_ms_.ToJson());
+    cJSON_AddItemToObject(json, "warm_connect_ms", warm_connect_ms_.ToJson());
+    cJSON_AddItemToObject(json, "claim_wait_ms", claim_wait_ms_.ToJson());
+    cJSON_AddNumberToObject(json, "warm_attempts", warm_attempts_);
+    cJSON_AddNumberToObject(json, "warm_failures", warm_failures_);
+    cJSON_AddNumberToObject(json, "warm_hits", warm_hits_);
+    cJSON_AddNumberToObject(json, "warm_expired", warm_expired_);
+    cJSON_AddNumberToObject(json, "budget_denied", budget_denied_);
+    return json;
+}
+
+void AudioChannelWarmer::LogStats() {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    if (cold_connect_ms_.count() == 0 && warm_attempts_ == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "Connect ms: cold n=%lu p50=%lu p90=%lu max=%lu, warm n=%lu p50=%lu p90=%lu, wait n=%lu p90=%lu",
+        cold_connect_ms_.count(), cold_connect_ms_.Percentile(50), cold_connect_ms_.Percentile(90), cold_connect_ms_.max(),
+        warm_connect_ms_.count(), warm_connect_ms_.Percentile(50), warm_connect_ms_.Percentile(90),
+        claim_wait_ms_.count(), claim_wait_ms_.Percentile(90));
+    ESP_LOGI(TAG, "Warm-ups: attempts=%lu failures=%lu hits=%lu expired=%lu denied=%lu",
+        warm_attempts_, warm_failures_, warm_hits_, warm_expired_, budget_denied_);
+}
@@ -0,0 +1,92 @@
+#ifndef AUDIO_CHANNEL_WARMER_H
+#define AUDIO_CHANNEL_WARMER_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/task.h>
+
+#include <cJSON.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+#include "protocol.h"
+#include "latency_histogram.h"
+
+#define AUDIO_CHANNEL_WARMER_DONE_EVENT (1 << 0)
+// How long shutdown paths such as a reboot wait for a warm-up in flight
+#define AUDIO_CHANNEL_WARMER_SHUTDOWN_WAIT_MS 3000
+
+/*
+ * Opens the audio channel before it is needed.
+ *
+ * With CONFIG_AUDIO_CHANNEL_PRECONNECT, Warm() opens the channel on a background task when
+ * speech may be starting, so a wake word that follows finds the handshake done or in flight.
+ * A warm channel nobody claims is closed after an idle timeout, and a token bucket caps how
+ * many speculative connects are made per hour. With CONFIG_AUDIO_CHANNEL_KEEP_WARM the channel
+ * is reopened whenever the device is idle without one, within the same budget.
+ *
+ * Every open of a conversation goes through Claim() / Open(), which also time the connects.
+ * Only the main event loop calls into this class, apart from the warm-up task. The warm-up
+ * task replaces the protocol's connection, so any other main loop call into the protocol
+ * has to wait until speculating() is false. Calls that can be put off are run from OnDone()
+ * instead of blocking the main loop in Wait().
+ */
+class AudioChannelWarmer {
+public:
+    AudioChannelWarmer();
+    ~AudioChannelWarmer();
+
+    void SetProtocol(Protocol* protocol);
+
+    // Start a speculative open if the policy allows it
+    void Warm(const char* reason);
+    // Waits for a warm-up in flight, if any, returns false if it is still in flight after the timeout
+    bool Wait(TickType_t timeout = portMAX_DELAY);
+    // Waits for a warm-up in flight, returns true if the channel is open and takes it over
+    bool Claim();
+    // Opens the channel for a conversation that could not claim a warm one
+    bool Open();
+    // True while the warm-up task is opening the channel
+    bool speculating() const { return speculating_.load(std::memory_order_acquire); }
+    // True when called from the warm-up task, its errors are not the user's
+    bool InWarmTask() const { return warm_task_ != nullptr && xTaskGetCurrentTaskHandle() == warm_task_; }
+
+    // Called every second from the main event loop
+    void OnClockTick(bool idle);
+    // Called from the warm-up task each time a warm-up has finished
+    void OnDone(std::function<void()> callback) { on_done_ = callback; }
+
+    cJSON* GetStatsJson();
+    // Prints the histograms, if there was any connect yet
+    void LogStats();
+
+private:
+    Protocol* protocol_ = nullptr;
+    EventGroupHandle_t event_group_ = nullptr;
+    TaskHandle_t warm_task_ = nullptr;
+    std::atomic<bool> speculating_ = false;
+    bool warm_channel_ = false;         // Opened by Warm() and not claimed yet
+    int64_t warm_opened_time_us_ = 0;
+    const char* warm_reason_ = "";
+    std::function<void()> on_done_;
+
+    // Power budget, one speculative connect per token
+    int budget_tokens_ = 0;
+    int64_t budget_refill_time_us_ = 0;
+
+    std::mutex stats_mutex_;
+    LatencyHistogram cold_connect_ms_;  // Opens the user had to wait for from the start
+    LatencyHistogram warm_connect_ms_;  // Speculative opens, in the background
+    LatencyHistogram claim_wait_ms_;    // Time spent waiting for a warm-up in flight
+    uint32_t warm_attempts_ = 0;
+    uint32_t warm_failures_ = 0;
+    uint32_t warm_hits_ = 0;
+    uint32_t warm_expired_ = 0;
+    uint32_t budget_denied_ = 0;
+
+    void WarmTask();
+    bool TakeBudget();
+};
+
+#endif // AUDIO_CHANNEL_WARMER_H
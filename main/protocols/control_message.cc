@@ -0,0 +1,211 @@
+#include "control_message.h"
+
+#include <cstdint>
+
+namespace {
+
+class Scanner {
+public:
+    Scanner(const char* data, size_t len, std::string& scratch) : p_(data), end_(data + len), scratch_(scratch) {}
+
+    void SkipSpace() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+            p_++;
+        }
+    }
+
+    bool Consume(char c) {
+        SkipSpace();
+        if (p_ < end_ && *p_ == c) {
+            p_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool AtEnd() {
+        SkipSpace();
+        return p_ == end_ || *p_ == '\0';
+    }
+
+    char Peek() {
+        SkipSpace();
+        return p_ < end_ ? *p_ : '\0';
+    }
+
+    // Strings without escapes are returned as a view of the input, others are decoded into scratch
+    bool ReadString(std::string_view& value) {
+        if (!Consume('"')) {
+            return false;
+        }
+        const char* start = p_;
+        while (p_ < end_ && *p_ != '"' && *p_ != '\\') {
+            p_++;
+        }
+        if (p_ == end_) {
+            return false;
+        }
+        if (*p_ == '"') {
+            value = std::string_view(start, p_ - start);
+            p_++;
+            return true;
+        }
+
+        // scratch was reserved for the whole message, so appending never moves earlier views
+        size_t offset = scratch_.size();
+        scratch_.append(start, p_ - start);
+        while (p_ < end_ && *p_ != '"') {
+            if (*p_ != '\\') {
+                scratch_.push_back(*p_++);
+                continue;
+            }
+            if (++p_ == end_) {
+                return false;
+            }
+            char c = *p_++;
+            switch (c) {
+            case '"': case '\\': case '/': scratch_.push_back(c); break;
+            case 'b': scratch_.push_back('\b'); break;
+            case 'f': scratch_.push_back('\f'); break;
+            case 'n': scratch_.push_back('\n'); break;
+            case 'r': scratch_.push_back('\r'); break;
+            case 't': scratch_.push_back('\t'); break;
+            case 'u':
+                if (!ReadUnicodeEscape()) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+            }
+        }
+        if (p_ == end_) {
+            return false;
+        }
+        p_++;
+        value = std::string_view(scratch_.data() + offset, scratch_.size() - offset);
+        return true;
+    }
+
+    // Numbers, true, false and null carry nothing we need
+    bool SkipLiteral() {
+        const char* start = p_;
+        while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ' ' && *p_ != '\n' && *p_ != '\r' && *p_ != '\t') {
+            if (*p_ == '"' || *p_ == '{' || *p_ == '[') {
+                return false;
+            }
+            p_++;
+        }
+        return p_ > start;
+    }
+
+private:
+    const char* p_;
+    const char* end_;
+    std::string& scratch_;
+
+    bool ReadHex4(uint32_t& code) {
+        if (end_ - p_ < 4) {
+            return false;
+        }
+        code = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *p_++;
+            code <<= 4;
+            if (c >= '0' && c <= '9') {
+                code |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                code |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                code |= c - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ReadUnicodeEscape() {
+        uint32_t code;
+        if (!ReadHex4(code)) {
+            return false;
+        }
+        if (code >= 0xD800 && code <= 0xDBFF) {
+            // Surrogate pair, the low half must follow
+            uint32_t low;
+            if (end_ - p_ < 6 || p_[0] != '\\' || p_[1] != 'u') {
+                return false;
+            }
+            p_ += 2;
+            if (!ReadHex4(low) || low < 0xDC00 || low > 0xDFFF) {
+                return false;
+            }
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        }
+
+        if (code < 0x80) {
+            scratch_.push_back(code);
+        } else if (code < 0x800) {
+            scratch_.push_back(0xC0 | (code >> 6));
+            scratch_.push_back(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            scratch_.push_back(0xE0 | (code >> 12));
+            scratch_.push_back(0x80 | ((code >> 6) & 0x3F));
+            scratch_.push_back(0x80 | (code & 0x3F));
+        } else {
+            scratch_.push_back(0xF0 | (code >> 18));
+            scratch_.push_back(0x80 | ((code >> 12) & 0x3F));
+            scratch_.push_back(0x80 | ((code >> 6) & 0x3F));
+            scratch_.push_back(0x80 | (code & 0x3F));
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+bool ParseControlMessage(const char* data, size_t len, std::string& scratch, ControlMessage& message) {
+    scratch.clear();
+    scratch.reserve(len);
+    message = ControlMessage();
+
+    Scanner scanner(data, len, scratch);
+    if (!scanner.Consume('{')) {
+        return false;
+    }
+    if (!scanner.Consume('}')) {
+        do {
+            std::string_view key;
+            if (!scanner.ReadString(key) || !scanner.Consume(':')) {
+                return false;
+            }
+            if (scanner.Peek() != '"') {
+                // Only the string fields matter, nested values go to cJSON
+                if (!scanner.SkipLiteral()) {
+                    return false;
+                }
+                continue;
+            }
+            std::string_view value;
+            if (!scanner.ReadString(value)) {
+                return false;
+            }
+            if (key == "type") {
+                message.type = value;
+            } else if (key == "state") {
+                message.state = value;
+            } else if (key == "text") {
+                message.text = value;
+            } else if (key == "emotion") {
+                message.emotion = value;
+            }
+        } while (scanner.Consume(','));
+        if (!scanner.Consume('}')) {
+            return false;
+        }
+    }
+    if (!scanner.AtEnd()) {
+        return false;
+    }
+    return message.type == "tts" || message.type == "stt" || message.type == "llm";
+}
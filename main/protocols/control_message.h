@@ -0,0 +1,28 @@
+#ifndef CONTROL_MESSAGE_H
+#define CONTROL_MESSAGE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/*
+ * The small tts / stt / llm messages that stream in while audio is downloading.
+ *
+ * Fields that are not present are empty. The views point into the received data, or into the
+ * scratch buffer passed to ParseControlMessage() for strings that had escapes.
+ */
+struct ControlMessage {
+    std::string_view type;
+    std::string_view state;
+    std::string_view text;
+    std::string_view emotion;
+};
+
+/*
+ * Scans a flat JSON object of the tts, stt or llm type without building a cJSON tree.
+ * Returns false for any other type, nested values or malformed input, which should then be
+ * parsed with cJSON as before.
+ */
+bool ParseControlMessage(const char* data, size_t len, std::string& scratch, ControlMessage& message);
+
+#endif // CONTROL_MESSAGE_H
@@ -91,6 +91,10 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
     });
 
     mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
+        if (DispatchControlMessage(payload.data(), payload.size())) {
+            last_incoming_time_ = std::chrono::steady_clock::now();
+            return;
+        }
         cJSON* root = cJSON_Parse(payload.c_str());
         if (root == nullptr) {
             ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
@@ -152,30 +156,54 @@ bool MqttProtocol::SendText(const std::string& text) {
     return true;
 }
 
-bool MqttProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+bool MqttProtocol::SendAudio(AudioStreamPacketPtr packet) {
     std::lock_guard<std::mutex> lock(channel_mutex_);
     if (udp_ == nullptr) {
         return false;
     }
 
-    std::string nonce(aes_nonce_);
-    *(uint16_t*)&nonce[2] = htons(packet->payload.size());
-    *(uint32_t*)&nonce[8] = htonl(packet->timestamp);
-    *(uint32_t*)&nonce[12] = htonl(++local_sequence_);
-
-    std::string encrypted;
-    encrypted.resize(aes_nonce_.size() + packet->payload.size());
-    memcpy(encrypted.data(), nonce.data(), nonce.size());
-
+    // Nonce followed by the ciphertext, built in a buffer that keeps its capacity between frames
+    size_t nonce_size = aes_nonce_.size();
+    send_buffer_.resize(nonce_size + packet->payload.size());
+    memcpy(send_buffer_.data(), aes_nonce_.data(), nonce_size);
+    *(uint16_t*)&send_buffer_[2] = htons(packet->payload.size());
+    *(uint32_t*)&send_buffer_[8] = htonl(packet->timestamp);
+    *(uint32_t*)&send_buffer_[12] = htonl(++local_sequence_);
+
+    // The counter block is advanced by mbedtls, so work on a copy of the nonce
+    uint8_t counter[16];
+    memcpy(counter, send_buffer_.data(), sizeof(counter));
     size_t nc_off = 0;
     uint8_t stream_block[16] = {0};
-    if (mbedtls_aes_crypt_ctr(&aes_ctx_, packet->payload.size(), &nc_off, (uint8_t*)nonce.c_str(), stream_block,
-        (uint8_t*)packet->payload.data(), (uint8_t*)&encrypted[nonce.size()]) != 0) {
+    if (mbedtls_aes_crypt_ctr(&aes_ctx_, packet->payload.size(), &nc_off, counter, stream_block,
+        packet->payload.data(), (uint8_t*)&send_buffer_[nonce_size]) != 0) {
         ESP_LOGE(TAG, "Failed to encrypt audio data");
         return false;
     }
 
-    return udp_->Send(encrypted) > 0;
+    return udp_->Send(send_buffer_) > 0;
+}
+
+// Sliding window replay check, like IPsec and DTLS. Reordered packets within the window are
+// accepted once, repeated and older ones are dropped.
+bool MqttProtocol::AcceptRemoteSequence(uint32_t sequence) {
+    if (sequence > remote_sequence_) {
+        uint32_t shift = sequence - remote_sequence_;
+        replay_window_ = shift >= MQTT_REPLAY_WINDOW_SIZE ? 0 : replay_window_ << shift;
+        replay_window_ |= 1;
+        remote_sequence_ = sequence;
+        return true;
+    }
+    uint32_t offset = remote_sequence_ - sequence;
+    if (offset >= MQTT_REPLAY_WINDOW_SIZE) {
+        return false;
+    }
+    uint64_t bit = 1ULL << offset;
+    if (replay_window_ & bit) {
+        return false;
+    }
+    replay_window_ |= bit;
+    return true;
 }
 
 void MqttProtocol::CloseAudioChannel() {
@@ -229,7 +257,7 @@ bool MqttProtocol::OpenAudioChannel() {
          * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
          * |payload payload_len|
          */
-        if (data.size() < sizeof(aes_nonce_)) {
+        if (data.size() < aes_nonce_.size()) {
             ESP_LOGE(TAG, "Invalid audio packet size: %u", data.size());
             return;
         }
@@ -239,25 +267,30 @@ bool MqttProtocol::OpenAudioChannel() {
         }
         uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
         uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
-        if (sequence < remote_sequence_) {
-            ESP_LOGW(TAG, "Received audio packet with old sequence: %lu, expected: %lu", sequence, remote_sequence_);
-            return;
-        }
+        // Out of order and missing packets are sorted out by the jitter buffer in the audio service
         if (sequence != remote_sequence_ + 1) {
-            ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
+            ESP_LOGD(TAG, "Received audio packet with sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
+        }
+        if (!AcceptRemoteSequence(sequence)) {
+            ESP_LOGW(TAG, "Dropped replayed or stale audio packet: %lu, latest: %lu", sequence, remote_sequence_);
+            return;
         }
 
+        // Decrypt straight into the pooled payload, leaving the received data untouched
         size_t decrypted_size = data.size() - aes_nonce_.size();
+        uint8_t counter[16];
+        memcpy(counter, data.data(), sizeof(counter));
         size_t nc_off = 0;
         uint8_t stream_block[16] = {0};
-        auto nonce = (uint8_t*)data.data();
-        auto encrypted = (uint8_t*)data.data() + aes_nonce_.size();
-        auto packet = std::make_unique<AudioStreamPacket>();
+        auto encrypted = (const uint8_t*)data.data() + aes_nonce_.size();
+        auto packet = GetAudioStreamPacketPool().Acquire();
         packet->sample_rate = server_sample_rate_;
         packet->frame_duration = server_frame_duration_;
         packet->timestamp = timestamp;
+        packet->sequence = sequence;
+        packet->trace.Start(esp_timer_get_time());
         packet->payload.resize(decrypted_size);
-        int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, nonce, stream_block, encrypted, (uint8_t*)packet->payload.data());
+        int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, counter, stream_block, encrypted, packet->payload.data());
         if (ret != 0) {
             ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
             return;
@@ -265,7 +298,6 @@ bool MqttProtocol::OpenAudioChannel() {
         if (on_incoming_audio_ != nullptr) {
             on_incoming_audio_(std::move(packet));
         }
-        remote_sequence_ = sequence;
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
@@ -294,6 +326,7 @@ std::string MqttProtocol::GetHelloMessage() {
     cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
     cJSON_AddNumberToObject(audio_params, "channels", 1);
     cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    cJSON_AddNumberToObject(audio_params, "complexity", Application::GetInstance().GetAudioService().GetEncoderComplexity());
     cJSON_AddItemToObject(root, "audio_params", audio_params);
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
@@ -345,6 +378,7 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
     mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key).c_str(), 128);
     local_sequence_ = 0;
     remote_sequence_ = 0;
+    replay_window_ = 0;
     xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 }
 
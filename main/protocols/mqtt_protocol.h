@@ -18,6 +18,8 @@
 
 #define MQTT_PING_INTERVAL_SECONDS 90
 #define MQTT_RECONNECT_INTERVAL_MS 60000
+// Reordered UDP audio packets this far behind the newest one are still accepted once
+#define MQTT_REPLAY_WINDOW_SIZE 64
 
 #define MQTT_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
@@ -27,7 +29,7 @@ public:
     ~MqttProtocol();
 
     bool Start() override;
-    bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) override;
+    bool SendAudio(AudioStreamPacketPtr packet) override;
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
@@ -46,11 +48,14 @@ private:
     int udp_port_;
     uint32_t local_sequence_;
     uint32_t remote_sequence_;
+    uint64_t replay_window_ = 0;    // Bit n is set if remote_sequence_ - n has been received
+    std::string send_buffer_;       // Only touched under channel_mutex_
     esp_timer_handle_t reconnect_timer_;
 
     bool StartMqttClient(bool report_error=false);
     void ParseServerHello(const cJSON* root);
     std::string DecodeHexString(const std::string& hex_string);
+    bool AcceptRemoteSequence(uint32_t sequence);
 
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
@@ -4,11 +4,20 @@
 
 #define TAG "Protocol"
 
+ObjectPool<AudioStreamPacket>& GetAudioStreamPacketPool() {
+    static ObjectPool<AudioStreamPacket> pool(AUDIO_STREAM_PACKET_POOL_SIZE);
+    return pool;
+}
+
 void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
     on_incoming_json_ = callback;
 }
 
-void Protocol::OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback) {
+void Protocol::OnIncomingControl(std::function<void(const ControlMessage& message)> callback) {
+    on_incoming_control_ = callback;
+}
+
+void Protocol::OnIncomingAudio(std::function<void(AudioStreamPacketPtr packet)> callback) {
     on_incoming_audio_ = callback;
 }
 
@@ -32,6 +41,19 @@ void Protocol::OnDisconnected(std::function<void()> callback) {
     on_disconnected_ = callback;
 }
 
+// Returns true if the message was handled without parsing it into a cJSON tree
+bool Protocol::DispatchControlMessage(const char* data, size_t len) {
+    if (on_incoming_control_ == nullptr) {
+        return false;
+    }
+    ControlMessage message;
+    if (!ParseControlMessage(data, len, control_scratch_, message)) {
+        return false;
+    }
+    on_incoming_control_(message);
+    return true;
+}
+
 void Protocol::SetError(const std::string& message) {
     error_occurred_ = true;
     if (on_network_error_ != nullptr) {
@@ -7,13 +7,26 @@
 #include <chrono>
 #include <vector>
 
+#include "object_pool.h"
+#include "control_message.h"
+#include "audio_latency_tracer.h"
+
+// Enough for full decode, jitter buffer and send queues, plus the packets in flight
+#define AUDIO_STREAM_PACKET_POOL_SIZE 120
+
 struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
+    uint32_t sequence = 0;  // 0 if the transport has no sequence numbers
     std::vector<uint8_t> payload;
+    AudioFrameTrace trace;  // Local latency tracing, never sent
 };
 
+// Packets go back to the pool with their payload capacity when the pointer is destroyed
+using AudioStreamPacketPtr = PooledPtr<AudioStreamPacket>;
+ObjectPool<AudioStreamPacket>& GetAudioStreamPacketPool();
+
 struct BinaryProtocol2 {
     uint16_t version;
     uint16_t type;          // Message type (0: OPUS, 1: JSON)
@@ -55,8 +68,10 @@ public:
         return session_id_;
     }
 
-    void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
+    void OnIncomingAudio(std::function<void(AudioStreamPacketPtr packet)> callback);
     void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    // tts / stt / llm messages that could be read without cJSON, the rest go to OnIncomingJson
+    void OnIncomingControl(std::function<void(const ControlMessage& message)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -67,16 +82,19 @@ public:
     virtual bool OpenAudioChannel() = 0;
     virtual void CloseAudioChannel() = 0;
     virtual bool IsAudioChannelOpened() const = 0;
-    virtual bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) = 0;
+    virtual bool SendAudio(AudioStreamPacketPtr packet) = 0;
     virtual void SendWakeWordDetected(const std::string& wake_word);
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
     virtual void SendMcpMessage(const std::string& message);
+    // Called every second from the main event loop, while no other task uses the protocol
+    virtual void KeepAlive() {}
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
-    std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
+    std::function<void(const ControlMessage& message)> on_incoming_control_;
+    std::function<void(AudioStreamPacketPtr packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
     std::function<void(const std::string& message)> on_network_error_;
@@ -88,10 +106,12 @@ protected:
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
+    std::string control_scratch_;
 
     virtual bool SendText(const std::string& text) = 0;
     virtual void SetError(const std::string& message);
     virtual bool IsTimeout() const;
+    bool DispatchControlMessage(const char* data, size_t len);
 };
 
 #endif // PROTOCOL_H
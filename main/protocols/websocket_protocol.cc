@@ -4,9 +4,11 @@
 #include "application.h"
 #include "settings.h"
 
+#include <algorithm>
 #include <cstring>
 #include <cJSON.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <arpa/inet.h>
 #include "assets/lang_config.h"
 
@@ -21,42 +23,59 @@ WebsocketProtocol::~WebsocketProtocol() {
 }
 
 bool WebsocketProtocol::Start() {
+    Settings settings("websocket", false);
+    url_ = settings.GetString("url");
+    std::string token = settings.GetString("token");
+    int version = settings.GetInt("version");
+    if (version != 0) {
+        version_ = version;
+    }
+    if (!token.empty()) {
+        // If token not has a space, add "Bearer " prefix
+        if (token.find(" ") == std::string::npos) {
+            token = "Bearer " + token;
+        }
+        authorization_ = token;
+    }
+
     // Only connect to server when audio channel is needed
     return true;
 }
 
-bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+bool WebsocketProtocol::SendAudio(AudioStreamPacketPtr packet) {
     if (websocket_ == nullptr || !websocket_->IsConnected()) {
         return false;
     }
 
     if (version_ == 2) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol2) + packet->payload.size());
-        auto bp2 = (BinaryProtocol2*)serialized.data();
-        bp2->version = htons(version_);
-        bp2->type = 0;
-        bp2->reserved = 0;
-        bp2->timestamp = htonl(packet->timestamp);
-        bp2->payload_size = htonl(packet->payload.size());
-        memcpy(bp2->payload, packet->payload.data(), packet->payload.size());
-
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        BinaryProtocol2 bp2;
+        bp2.version = htons(version_);
+        bp2.type = 0;
+        bp2.reserved = 0;
+        bp2.timestamp = htonl(packet->timestamp);
+        bp2.payload_size = htonl(packet->payload.size());
+        return SendBinaryFrame(&bp2, sizeof(bp2), packet->payload.data(), packet->payload.size());
     } else if (version_ == 3) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol3) + packet->payload.size());
-        auto bp3 = (BinaryProtocol3*)serialized.data();
-        bp3->type = 0;
-        bp3->reserved = 0;
-        bp3->payload_size = htons(packet->payload.size());
-        memcpy(bp3->payload, packet->payload.data(), packet->payload.size());
-
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        BinaryProtocol3 bp3;
+        bp3.type = 0;
+        bp3.reserved = 0;
+        bp3.payload_size = htons(packet->payload.size());
+        return SendBinaryFrame(&bp3, sizeof(bp3), packet->payload.data(), packet->payload.size());
     } else {
+        // No header, the payload goes out as is
         return websocket_->Send(packet->payload.data(), packet->payload.size(), true);
     }
 }
 
+bool WebsocketProtocol::SendBinaryFrame(const void* header, size_t header_size, const uint8_t* payload, size_t payload_size) {
+    // WebSocket::Send() takes one contiguous buffer, so the parts are gathered into a buffer that
+    // keeps its capacity between frames. Only the main task sends audio.
+    frame_buffer_.resize(header_size + payload_size);
+    memcpy(frame_buffer_.data(), header, header_size);
+    memcpy(frame_buffer_.data() + header_size, payload, payload_size);
+    return websocket_->Send(reinterpret_cast<const char*>(frame_buffer_.data()), frame_buffer_.size(), true);
+}
+
 bool WebsocketProtocol::SendText(const std::string& text) {
     if (websocket_ == nullptr || !websocket_->IsConnected()) {
         return false;
@@ -72,24 +91,114 @@ bool WebsocketProtocol::SendText(const std::string& text) {
 }
 
 bool WebsocketProtocol::IsAudioChannelOpened() const {
-    return websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
+    return websocket_ != nullptr && websocket_->IsConnected() && session_opened_ && !error_occurred_ && !IsTimeout();
 }
 
 void WebsocketProtocol::CloseAudioChannel() {
+    if (persistent_ && websocket_ != nullptr && websocket_->IsConnected() && session_opened_.exchange(false)) {
+        // End the session only, the next OpenAudioChannel() skips the TCP and TLS handshakes
+        std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"goodbye\"}";
+        SendText(message);
+        OnSessionClosed();
+        return;
+    }
+    session_opened_ = false;
     websocket_.reset();
 }
 
 bool WebsocketProtocol::OpenAudioChannel() {
-    Settings settings("websocket", false);
-    std::string url = settings.GetString("url");
-    std::string token = settings.GetString("token");
-    int version = settings.GetInt("version");
-    if (version != 0) {
-        version_ = version;
+    error_occurred_ = false;
+
+    if (persistent_ && websocket_ != nullptr && websocket_->IsConnected() && !IsTimeout()) {
+        ESP_LOGI(TAG, "Starting a new session on the open connection");
+        xEventGroupClearBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
+        if (websocket_->Send(GetHelloMessage()) && WaitForServerHello(WEBSOCKET_PROTOCOL_REUSE_HELLO_TIMEOUT_MS)) {
+            return OnSessionOpened();
+        }
+        ESP_LOGW(TAG, "The open connection did not answer, reconnecting");
     }
 
-    error_occurred_ = false;
+    session_opened_ = false;
+    DropConnection();
+    if (!Connect()) {
+        return false;
+    }
+
+    // Send hello message to describe the client
+    auto message = GetHelloMessage();
+    if (!SendText(message)) {
+        return false;
+    }
+
+    // Wait for server hello
+    if (!WaitForServerHello()) {
+        ESP_LOGE(TAG, "Failed to receive server hello");
+        session_opened_ = false;
+        SetError(Lang::Strings::SERVER_TIMEOUT);
+        return false;
+    }
+
+    return OnSessionOpened();
+}
 
+bool WebsocketProtocol::WaitForServerHello(int timeout_ms) {
+    EventBits_t bits = xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(timeout_ms));
+    return bits & WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT;
+}
+
+// Closes the connection without reporting a closed audio channel, no session is open on it
+void WebsocketProtocol::DropConnection() {
+    websocket_.reset();
+    persistent_ = false;
+    ping_pending_ = false;
+}
+
+void WebsocketProtocol::KeepAlive() {
+    if (!persistent_ || session_opened_ || websocket_ == nullptr || !websocket_->IsConnected()) {
+        return;
+    }
+
+    // Without traffic a NAT or proxy may forget the connection silently, the server answers a ping
+    auto now = std::chrono::steady_clock::now();
+    if (now - idle_since_ >= std::chrono::seconds(WEBSOCKET_PROTOCOL_IDLE_CLOSE_S)) {
+        ESP_LOGI(TAG, "Closing the connection, idle for %d seconds", WEBSOCKET_PROTOCOL_IDLE_CLOSE_S);
+        DropConnection();
+        return;
+    }
+    if (ping_pending_) {
+        if (last_incoming_time_ >= ping_time_) {
+            ping_pending_ = false;
+        } else if (now - ping_time_ >= std::chrono::seconds(WEBSOCKET_PROTOCOL_KEEPALIVE_TIMEOUT_S)) {
+            ESP_LOGW(TAG, "No answer to the keepalive ping, dropping the connection");
+            DropConnection();
+            return;
+        } else {
+            return;
+        }
+    }
+    if (now - last_incoming_time_ >= std::chrono::seconds(WEBSOCKET_PROTOCOL_KEEPALIVE_INTERVAL_S)) {
+        ping_time_ = now;
+        ping_pending_ = websocket_->Send("{\"type\":\"ping\"}");
+    }
+}
+
+bool WebsocketProtocol::OnSessionOpened() {
+    if (on_audio_channel_opened_ != nullptr) {
+        on_audio_channel_opened_();
+    }
+    return true;
+}
+
+// Called once session_opened_ was cleared, on the main event loop
+void WebsocketProtocol::OnSessionClosed() {
+    idle_since_ = std::chrono::steady_clock::now();
+    ping_pending_ = false;
+    if (on_audio_channel_closed_ != nullptr) {
+        on_audio_channel_closed_();
+    }
+}
+
+bool WebsocketProtocol::Connect() {
     auto network = Board::GetInstance().GetNetwork();
     websocket_ = network->CreateWebSocket(1);
     if (websocket_ == nullptr) {
@@ -97,60 +206,70 @@ bool WebsocketProtocol::OpenAudioChannel() {
         return false;
     }
 
-    if (!token.empty()) {
-        // If token not has a space, add "Bearer " prefix
-        if (token.find(" ") == std::string::npos) {
-            token = "Bearer " + token;
-        }
-        websocket_->SetHeader("Authorization", token.c_str());
+    if (!authorization_.empty()) {
+        websocket_->SetHeader("Authorization", authorization_.c_str());
     }
     websocket_->SetHeader("Protocol-Version", std::to_string(version_).c_str());
     websocket_->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
     websocket_->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
 
     websocket_->OnData([this](const char* data, size_t len, bool binary) {
+        last_incoming_time_ = std::chrono::steady_clock::now();
         if (binary) {
-            if (on_incoming_audio_ != nullptr) {
+            // Late audio of an ended session must not reach the decoder
+            if (on_incoming_audio_ != nullptr && session_opened_) {
+                auto packet = GetAudioStreamPacketPool().Acquire();
+                packet->sample_rate = server_sample_rate_;
+                packet->frame_duration = server_frame_duration_;
+                packet->sequence = 0;
+                packet->trace.Start(esp_timer_get_time());
+                // Read the header without touching the receive buffer, and never trust its payload size
                 if (version_ == 2) {
-                    BinaryProtocol2* bp2 = (BinaryProtocol2*)data;
-                    bp2->version = ntohs(bp2->version);
-                    bp2->type = ntohs(bp2->type);
-                    bp2->timestamp = ntohl(bp2->timestamp);
-                    bp2->payload_size = ntohl(bp2->payload_size);
-                    auto payload = (uint8_t*)bp2->payload;
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = bp2->timestamp,
-                        .payload = std::vector<uint8_t>(payload, payload + bp2->payload_size)
-                    }));
+                    BinaryProtocol2 bp2;
+                    if (len < sizeof(bp2)) {
+                        ESP_LOGE(TAG, "Binary frame too short: %u", (unsigned)len);
+                        return;
+                    }
+                    memcpy(&bp2, data, sizeof(bp2));
+                    size_t payload_size = std::min<size_t>(ntohl(bp2.payload_size), len - sizeof(bp2));
+                    auto payload = (const uint8_t*)data + sizeof(bp2);
+                    packet->timestamp = ntohl(bp2.timestamp);
+                    packet->payload.assign(payload, payload + payload_size);
                 } else if (version_ == 3) {
-                    BinaryProtocol3* bp3 = (BinaryProtocol3*)data;
-                    bp3->type = bp3->type;
-                    bp3->payload_size = ntohs(bp3->payload_size);
-                    auto payload = (uint8_t*)bp3->payload;
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = 0,
-                        .payload = std::vector<uint8_t>(payload, payload + bp3->payload_size)
-                    }));
+                    BinaryProtocol3 bp3;
+                    if (len < sizeof(bp3)) {
+                        ESP_LOGE(TAG, "Binary frame too short: %u", (unsigned)len);
+                        return;
+                    }
+                    memcpy(&bp3, data, sizeof(bp3));
+                    size_t payload_size = std::min<size_t>(ntohs(bp3.payload_size), len - sizeof(bp3));
+                    auto payload = (const uint8_t*)data + sizeof(bp3);
+                    packet->timestamp = 0;
+                    packet->payload.assign(payload, payload + payload_size);
                 } else {
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = 0,
-                        .payload = std::vector<uint8_t>((uint8_t*)data, (uint8_t*)data + len)
-                    }));
+                    packet->timestamp = 0;
+                    packet->payload.assign((const uint8_t*)data, (const uint8_t*)data + len);
                 }
+                on_incoming_audio_(std::move(packet));
             }
-        } else {
-            // Parse JSON data
+        } else if (!session_opened_ || !DispatchControlMessage(data, len)) {
+            // Parse JSON data, only the hello is taken outside a session
             auto root = cJSON_Parse(data);
             auto type = cJSON_GetObjectItem(root, "type");
             if (cJSON_IsString(type)) {
                 if (strcmp(type->valuestring, "hello") == 0) {
                     ParseServerHello(root);
+                } else if (strcmp(type->valuestring, "pong") == 0) {
+                    // Answer to the keepalive ping, its arrival time is all that matters
+                } else if (!session_opened_) {
+                    ESP_LOGW(TAG, "Dropped a %s message outside a session", type->valuestring);
+                } else if (strcmp(type->valuestring, "goodbye") == 0 && persistent_) {
+                    // The server ended the session but keeps the connection, what follows is dropped
+                    ESP_LOGI(TAG, "Received goodbye message");
+                    session_opened_ = false;
+                    Application::GetInstance().Schedule([this]() {
+                        OnSessionClosed();
+                    });
                 } else {
                     if (on_incoming_json_ != nullptr) {
                         on_incoming_json_(root);
@@ -161,41 +280,24 @@ bool WebsocketProtocol::OpenAudioChannel() {
             }
             cJSON_Delete(root);
         }
-        last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
     websocket_->OnDisconnected([this]() {
         ESP_LOGI(TAG, "Websocket disconnected");
-        if (on_audio_channel_closed_ != nullptr) {
+        // An idle persistent connection going away ends no session
+        bool session_opened = session_opened_.exchange(false);
+        if ((session_opened || !persistent_) && on_audio_channel_closed_ != nullptr) {
             on_audio_channel_closed_();
         }
     });
 
-    ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", url.c_str(), version_);
-    if (!websocket_->Connect(url.c_str())) {
+    connect_count_++;
+    ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d (connect #%d)", url_.c_str(), version_, connect_count_);
+    if (!websocket_->Connect(url_.c_str())) {
         ESP_LOGE(TAG, "Failed to connect to websocket server");
         SetError(Lang::Strings::SERVER_NOT_CONNECTED);
         return false;
     }
-
-    // Send hello message to describe the client
-    auto message = GetHelloMessage();
-    if (!SendText(message)) {
-        return false;
-    }
-
-    // Wait for server hello
-    EventBits_t bits = xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
-    if (!(bits & WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT)) {
-        ESP_LOGE(TAG, "Failed to receive server hello");
-        SetError(Lang::Strings::SERVER_TIMEOUT);
-        return false;
-    }
-
-    if (on_audio_channel_opened_ != nullptr) {
-        on_audio_channel_opened_();
-    }
-
     return true;
 }
 
@@ -209,6 +311,7 @@ std::string WebsocketProtocol::GetHelloMessage() {
     cJSON_AddBoolToObject(features, "aec", true);
 #endif
     cJSON_AddBoolToObject(features, "mcp", true);
+    cJSON_AddBoolToObject(features, "persistent", true);
     cJSON_AddItemToObject(root, "features", features);
     cJSON_AddStringToObject(root, "transport", "websocket");
     cJSON* audio_params = cJSON_CreateObject();
@@ -216,6 +319,7 @@ std::string WebsocketProtocol::GetHelloMessage() {
     cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
     cJSON_AddNumberToObject(audio_params, "channels", 1);
     cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    cJSON_AddNumberToObject(audio_params, "complexity", Application::GetInstance().GetAudioService().GetEncoderComplexity());
     cJSON_AddItemToObject(root, "audio_params", audio_params);
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
@@ -237,6 +341,10 @@ void WebsocketProtocol::ParseServerHello(const cJSON* root) {
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
+    auto features = cJSON_GetObjectItem(root, "features");
+    auto persistent = cJSON_GetObjectItem(features, "persistent");
+    persistent_ = cJSON_IsTrue(persistent);
+
     auto audio_params = cJSON_GetObjectItem(root, "audio_params");
     if (cJSON_IsObject(audio_params)) {
         auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
@@ -249,5 +357,7 @@ void WebsocketProtocol::ParseServerHello(const cJSON* root) {
         }
     }
 
+    // Before waking the opener, so the messages right after the hello are not dropped
+    session_opened_ = true;
     xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
 }
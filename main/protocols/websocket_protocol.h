@@ -8,7 +8,18 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 
+#include <atomic>
+#include <chrono>
+
 #define WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
+#define WEBSOCKET_PROTOCOL_HELLO_TIMEOUT_MS 10000
+// A reused connection that stays silent this long was dropped on the way, reconnect
+#define WEBSOCKET_PROTOCOL_REUSE_HELLO_TIMEOUT_MS 2000
+// An idle persistent connection is pinged after this long without data, and dropped without a pong
+#define WEBSOCKET_PROTOCOL_KEEPALIVE_INTERVAL_S 30
+#define WEBSOCKET_PROTOCOL_KEEPALIVE_TIMEOUT_S 10
+// An idle persistent connection is closed after this long without a session
+#define WEBSOCKET_PROTOCOL_IDLE_CLOSE_S 900
 
 class WebsocketProtocol : public Protocol {
 public:
@@ -16,18 +27,39 @@ public:
     ~WebsocketProtocol();
 
     bool Start() override;
-    bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) override;
+    bool SendAudio(AudioStreamPacketPtr packet) override;
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    void KeepAlive() override;
 
 private:
     EventGroupHandle_t event_group_handle_;
     std::unique_ptr<WebSocket> websocket_;
     int version_ = 1;
+    // Read from NVS once in Start()
+    std::string url_;
+    std::string authorization_;
+    // The server keeps the connection open between sessions, see docs/websocket.md
+    std::atomic<bool> persistent_ = false;
+    // Set by the server hello on the websocket task, frames outside a session are dropped
+    std::atomic<bool> session_opened_ = false;
+    int connect_count_ = 0;
+    // Main event loop only
+    std::chrono::steady_clock::time_point idle_since_;
+    std::chrono::steady_clock::time_point ping_time_;
+    bool ping_pending_ = false;
+    // Reused for every binary frame, so sending audio does not allocate
+    std::vector<uint8_t> frame_buffer_;
 
+    bool Connect();
+    bool WaitForServerHello(int timeout_ms = WEBSOCKET_PROTOCOL_HELLO_TIMEOUT_MS);
+    void DropConnection();
+    bool OnSessionOpened();
+    void OnSessionClosed();
     void ParseServerHello(const cJSON* root);
     bool SendText(const std::string& text) override;
+    bool SendBinaryFrame(const void* header, size_t header_size, const uint8_t* payload, size_t payload_size);
     std::string GetHelloMessage();
 };
 
@@ -0,0 +1,173 @@
+// Checks main/audio/audio_channels.cc against scalar references and times it on 60 ms frames.
+//
+// ExtractChannel is checked for 1 to 4 channels, every channel, odd and even lengths, aligned and
+// misaligned buffers, in place and out of place. ApplyGain is checked against a 64-bit reference
+// for gains from silence up to 100x, over the full int16 range. run.sh also runs the checks under
+// AddressSanitizer and UndefinedBehaviorSanitizer, which catch out of bounds words and overflowing
+// products.
+//
+// The timed rows compare the left channel extraction the call sites did before commit 9fda052
+// (a new vector filled sample by sample per frame) with the in-place kernel, and the kernel with
+// word access against a plain scalar loop. run.sh builds a second time without auto-vectorization,
+// which is closer to what the Xtensa compiler does with these loops.
+//
+//   ./run.sh [frames]
+
+#include "audio_channels.h"
+// AddressSanitizer replaces malloc itself, the checks run without the heap counter
+#ifndef __SANITIZE_ADDRESS__
+#include "heap_counter.h"
+#else
+#include <atomic>
+struct HeapCounter {
+    static std::atomic<uint64_t>& allocations() {
+        static std::atomic<uint64_t> count{0};
+        return count;
+    }
+};
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define FRAME_SAMPLES 960  // 60 ms at 16 kHz
+
+static int failures = 0;
+
+static void Check(bool ok, const char* what, size_t frames, int channels, int channel, size_t offset) {
+    if (!ok) {
+        printf("FAIL: %s, %zu frames, %d channels, channel %d, offset %zu\n", what, frames, channels, channel,
+            offset);
+        failures++;
+    }
+}
+
+static int16_t Sample(size_t i) {
+    return (int16_t)(i * 2654435761u >> 16);
+}
+
+static void CheckExtractChannel() {
+    for (int channels = 1; channels <= 4; channels++) {
+        for (int channel = 0; channel < channels; channel++) {
+            for (size_t frames : {0, 1, 2, 3, 7, 960, 961}) {
+                // Offsets of one sample leave the buffers misaligned for word access
+                for (size_t offset = 0; offset < 2; offset++) {
+                    std::vector<int16_t> input(frames * channels + offset);
+                    for (size_t i = 0; i < input.size(); i++) {
+                        input[i] = Sample(i);
+                    }
+                    std::vector<int16_t> expected(frames);
+                    for (size_t i = 0; i < frames; i++) {
+                        expected[i] = input[offset + i * channels + channel];
+                    }
+
+                    std::vector<int16_t> output(frames + offset);
+                    audio_channels::ExtractChannel(input.data() + offset, frames, channels, channel,
+                        output.data() + offset);
+                    Check(std::equal(expected.begin(), expected.end(), output.begin() + offset), "out of place",
+                        frames, channels, channel, offset);
+
+                    audio_channels::ExtractChannel(input.data() + offset, frames, channels, channel,
+                        input.data() + offset);
+                    Check(std::equal(expected.begin(), expected.end(), input.begin() + offset), "in place",
+                        frames, channels, channel, offset);
+                }
+            }
+        }
+    }
+}
+
+static void CheckApplyGain() {
+    static const double kGains[] = {0, 0.25, 0.5, 1, 1.5, 2, 15.99, 16, 20, 100};
+    std::vector<int16_t> samples;
+    for (int value = INT16_MIN; value <= INT16_MAX; value++) {
+        samples.push_back(value);
+    }
+    // An odd count, so the tail loop runs as well
+    samples.push_back(INT16_MAX);
+    for (double gain : kGains) {
+        int32_t gain_q12 = (int32_t)(gain * AUDIO_GAIN_UNITY);
+        std::vector<int16_t> output = samples;
+        audio_channels::ApplyGain(output.data(), output.size(), gain_q12);
+        bool ok = true;
+        for (size_t i = 0; i < samples.size(); i++) {
+            int64_t expected = std::clamp<int64_t>((int64_t)samples[i] * gain_q12 >> 12, INT16_MIN, INT16_MAX);
+            ok = ok && output[i] == expected;
+        }
+        if (!ok) {
+            printf("FAIL: ApplyGain with a gain of %.2f\n", gain);
+            failures++;
+        }
+    }
+}
+
+// Median nanoseconds per frame of step, and its heap allocations per frame
+template <typename Step>
+static void Time(const char* name, int frames, Step step) {
+    std::vector<int16_t> stereo(FRAME_SAMPLES * 2);
+    for (size_t i = 0; i < stereo.size(); i++) {
+        stereo[i] = Sample(i);
+    }
+    std::vector<int16_t> data;
+    data.reserve(stereo.size());
+    std::vector<double> ns;
+    ns.reserve(frames);
+    uint64_t allocations = 0;
+    for (int f = 0; f < frames + 10; f++) {
+        // Read into the same buffer every frame, as the audio input task does
+        data.assign(stereo.begin(), stereo.end());
+        uint64_t allocations_before = HeapCounter::allocations().load();
+        auto start = std::chrono::steady_clock::now();
+        step(data);
+        auto end = std::chrono::steady_clock::now();
+        if (f >= 10) {
+            ns.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+            allocations += HeapCounter::allocations().load() - allocations_before;
+        }
+    }
+    std::nth_element(ns.begin(), ns.begin() + frames / 2, ns.end());
+    printf("%-26s %10.2f %8.2f\n", name, ns[frames / 2] / 1000, (double)allocations / frames);
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 20000;
+    CheckExtractChannel();
+    CheckApplyGain();
+
+    if (frames > 0) {
+        printf("%-26s %10s %8s\n", "60 ms stereo frame", "us/frame", "allocs");
+        Time("copy into new vector", frames, [](std::vector<int16_t>& data) {
+            auto mono = std::vector<int16_t>(data.size() / 2);
+            for (size_t i = 0, j = 0; i < mono.size(); ++i, j += 2) {
+                mono[i] = data[j];
+            }
+            data = std::move(mono);
+        });
+        Time("scalar in place", frames, [](std::vector<int16_t>& data) {
+            size_t count = data.size() / 2;
+            for (size_t i = 0; i < count; i++) {
+                data[i] = data[i * 2];
+            }
+            data.resize(count);
+        });
+        Time("ExtractChannel in place", frames, [](std::vector<int16_t>& data) {
+            size_t count = data.size() / 2;
+            audio_channels::ExtractChannel(data.data(), count, 2, 0, data.data());
+            data.resize(count);
+        });
+        Time("ApplyGain 2x", frames, [](std::vector<int16_t>& data) {
+            audio_channels::ApplyGain(data.data(), data.size(), 2 * AUDIO_GAIN_UNITY);
+        });
+    }
+
+    if (failures == 0) {
+        printf("PASS\n");
+    } else {
+        printf("%d checks failed\n", failures);
+    }
+    return failures == 0 ? 0 : 1;
+}
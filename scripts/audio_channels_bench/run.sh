@@ -0,0 +1,19 @@
+#!/bin/sh
+# Checks main/audio/audio_channels.cc under the sanitizers, then times it with and without
+# auto-vectorization
+set -e
+cd "$(dirname "$0")"
+ROOT=../..
+BUILD=$(mktemp -d)
+trap 'rm -rf "$BUILD"' EXIT
+FLAGS="-std=c++17 -Wall -Wno-format -I../host_stubs -I$ROOT/main/audio"
+SOURCES="audio_channels_bench.cc $ROOT/main/audio/audio_channels.cc"
+${CXX:-c++} $FLAGS -O1 -g -fsanitize=address,undefined -fno-sanitize-recover=all -o "$BUILD/check" $SOURCES
+${CXX:-c++} $FLAGS -O2 -o "$BUILD/bench" $SOURCES
+${CXX:-c++} $FLAGS -O2 -fno-tree-vectorize -o "$BUILD/bench_scalar" $SOURCES
+echo "sanitizers:"
+"$BUILD/check" 0
+echo "-O2:"
+"$BUILD/bench" "$@"
+echo "-O2 -fno-tree-vectorize:"
+"$BUILD/bench_scalar" "$@"
@@ -0,0 +1,89 @@
+/*
+ * Writes trace.log: the serial output of main/audio/audio_latency_tracer.cc built for the host,
+ * with CONFIG_AUDIO_LATENCY_TRACE_LOG, for three seeded conversations. Each one ends with the
+ * LogStats() summary the device prints when it goes idle.
+ *
+ * The stage latencies are drawn to look like a device log: a steady base with jitter, a few
+ * frames held back by the network or the processor, and some frames that miss a trace point
+ * and are not recorded. Each conversation also plays prompt sounds: predecoded ones, which only
+ * wait for the decode task to wake up, and decoded ones, which wait for the decoder and for the
+ * answer frames queued ahead of them.
+ */
+#include "audio_latency_tracer.h"
+
+#include <cstdint>
+#include <cstdio>
+
+long long g_log_time_ms = 0;
+
+cJSON* cJSON_CreateObject() { return nullptr; }
+cJSON* cJSON_AddNumberToObject(cJSON*, const char*, double) { return nullptr; }
+cJSON* cJSON_AddStringToObject(cJSON*, const char*, const char*) { return nullptr; }
+void cJSON_AddItemToObject(cJSON*, const char*, cJSON*) {}
+
+static uint32_t g_seed = 0x5eed1a7e;
+
+static uint32_t Random(uint32_t range) {
+    g_seed = g_seed * 1664525u + 1013904223u;
+    return (g_seed >> 8) % range;
+}
+
+// base plus up to jitter, and one frame in spike_every held back by up to spike more
+static int64_t Stage(uint32_t base, uint32_t jitter, uint32_t spike_every, uint32_t spike) {
+    int64_t value = base + Random(jitter + 1);
+    if (spike_every > 0 && Random(spike_every) == 0) {
+        value += Random(spike + 1);
+    }
+    return value;
+}
+
+static void Conversation(AudioLatencyTracer& tracer, int uplink_frames, int downlink_frames) {
+    int64_t now = g_log_time_ms * 1000;
+    for (int i = 0; i < uplink_frames; i++) {
+        // A popup or vibration now and then while listening
+        if (i % 8 == 0) {
+            tracer.RecordPromptStart(Stage(40, 300, 25, 20000), true);
+        }
+        now += 60000;
+        g_log_time_ms = now / 1000;
+        AudioFrameTrace trace;
+        trace.Start(now);
+        int64_t t = now + Stage(30000, 4000, 20, 120000);
+        trace.Mark(kUplinkProcessed, t);
+        t += Stage(200, 800, 10, 20000);
+        trace.Mark(kUplinkEncodeStart, t);
+        t += Stage(9000, 3000, 0, 0);
+        // A frame the encoder dropped never reaches the send queue
+        trace.Mark(kUplinkEncoded, Random(50) == 0 ? 0 : t);
+        t += Stage(500, 1500, 8, 60000);
+        tracer.RecordUplink(trace, t);
+    }
+    for (int i = 0; i < downlink_frames; i++) {
+        // A sound that is not kept decoded, queued behind the answer
+        if (i % 20 == 10) {
+            tracer.RecordPromptStart(Stage(6000, 4000, 4, 240000), false);
+        }
+        now += 60000;
+        g_log_time_ms = now / 1000;
+        AudioFrameTrace trace;
+        trace.Start(now);
+        int64_t t = now + Stage(60000, 40000, 15, 400000);
+        trace.Mark(kDownlinkDecodeStart, t);
+        t += Stage(4000, 2000, 0, 0);
+        trace.Mark(kDownlinkDecoded, t);
+        t += Stage(1000, 60000, 0, 0);
+        trace.Mark(kDownlinkOutputStart, t);
+        t += Stage(58000, 4000, 30, 10000);
+        tracer.RecordDownlink(trace, t);
+    }
+    g_log_time_ms = now / 1000 + 500;
+    tracer.LogStats();
+}
+
+int main() {
+    AudioLatencyTracer tracer;
+    Conversation(tracer, 80, 120);
+    Conversation(tracer, 40, 300);
+    Conversation(tracer, 150, 60);
+    return 0;
+}
@@ -0,0 +1,11 @@
+// Declarations only, the generator never builds the JSON statistics
+#ifndef CJSON_STUB_H
+#define CJSON_STUB_H
+
+typedef struct cJSON cJSON;
+cJSON* cJSON_CreateObject();
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number);
+cJSON* cJSON_AddStringToObject(cJSON* object, const char* name, const char* string);
+void cJSON_AddItemToObject(cJSON* object, const char* name, cJSON* item);
+
+#endif
@@ -0,0 +1,11 @@
+// Prints like the ESP-IDF console, with the trace time of the generator as the timestamp
+#ifndef ESP_LOG_STUB_H
+#define ESP_LOG_STUB_H
+
+#include <cstdio>
+
+extern long long g_log_time_ms;
+
+#define ESP_LOGI(tag, format, ...) printf("I (%lld) %s: " format "\n", g_log_time_ms, tag, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Rebuilds trace.log from main/audio/audio_latency_tracer.cc, fails if the committed copy is out of
+# date, then checks the percentiles of scripts/audio_latency_replay.py against the logged summaries
+set -e
+cd "$(dirname "$0")"
+ROOT=../..
+BUILD=$(mktemp -d)
+trap 'rm -rf "$BUILD"' EXIT
+# uint32_t is unsigned long on the ESP32 toolchain, an int on the host
+sed 's/%lu/%u/g' $ROOT/main/audio/audio_latency_tracer.cc > "$BUILD/audio_latency_tracer.cc"
+${CXX:-c++} -std=c++17 -O2 -Wall -DCONFIG_AUDIO_LATENCY_TRACE_LOG=1 -Iinclude -I$ROOT/main -I$ROOT/main/audio \
+    -o "$BUILD/generate" generate.cc "$BUILD/audio_latency_tracer.cc"
+"$BUILD/generate" > "$BUILD/trace.log"
+if [ "$1" = "--update" ]; then
+    cp "$BUILD/trace.log" trace.log
+fi
+diff -u trace.log "$BUILD/trace.log"
+${PYTHON:-python3} ../audio_latency_replay.py --check trace.log
@@ -0,0 +1,152 @@
+import argparse
+import re
+import sys
+
+
+'''
+  Replay the audio latency traces printed with CONFIG_AUDIO_LATENCY_TRACE_LOG.
+
+  Every "AudioLatency: trace U|D total s1 s2 s3 s4" line of a captured serial log is one frame,
+  in microseconds, and every "AudioLatency: trace P predecoded|decoded us" line is the time from
+  PlaySound() to the first frame of the prompt in the playback queue. The percentiles are computed the way main/latency_histogram.h does on the
+  device (half-octave buckets), next to the exact ones, so a log can be checked against
+  self.audio.get_latency_stats or compared between builds.
+
+  With --check, every "AudioLatency: Uplink|Downlink <stage> us: n=.. p50=.. p90=.. p99=.. max=.."
+  and "AudioLatency: Prompt start <kind> us: n=.. p50=.. p90=.. max=.." summary the device printed
+  is compared with the percentiles of the trace lines before it, and
+  the exit status is 1 on any difference. audio_latency_fixture/run.sh runs it on trace.log, the
+  output of the tracer source built for the host.
+'''
+
+STAGES = {
+    'U': ('uplink', ['total', 'process', 'encode_queue', 'encode', 'send']),
+    'D': ('downlink', ['total', 'buffer', 'decode', 'playback_queue', 'output']),
+}
+TRACE_RE = re.compile(r'AudioLatency: trace ([UD]) (\d+) (\d+) (\d+) (\d+) (\d+)')
+SUMMARY_RE = re.compile(r'AudioLatency: (Uplink|Downlink) (\w+) us: n=(\d+) p50=(\d+) p90=(\d+) p99=(\d+) max=(\d+)')
+PROMPT_KINDS = ['predecoded', 'decoded']
+PROMPT_TRACE_RE = re.compile(r'AudioLatency: trace P (predecoded|decoded) (\d+)')
+PROMPT_SUMMARY_RE = re.compile(r'AudioLatency: Prompt start (predecoded|decoded) us: n=(\d+) p50=(\d+) p90=(\d+) max=(\d+)')
+BUCKETS = 48
+
+
+def bucket_of(value):
+    if value < 4:
+        return value
+    msb = value.bit_length() - 1
+    return min(msb * 2 + ((value >> (msb - 1)) & 1), BUCKETS - 1)
+
+
+def lower_bound(index):
+    if index < 4:
+        return index
+    msb = index // 2
+    return (1 << msb) | ((index & 1) << (msb - 1))
+
+
+def histogram_percentile(values, percentile):
+    buckets = [0] * BUCKETS
+    for value in values:
+        buckets[bucket_of(value)] += 1
+    rank = (len(values) * percentile + 99) // 100
+    seen = 0
+    for i, count in enumerate(buckets):
+        seen += count
+        if seen >= rank and count > 0:
+            return min(lower_bound(i + 1) - 1, max(values)) if i + 1 < BUCKETS else max(values)
+    return max(values)
+
+
+def exact_percentile(values, percentile):
+    ordered = sorted(values)
+    rank = max((len(ordered) * percentile + 99) // 100, 1)
+    return ordered[rank - 1]
+
+
+def check_summary(samples, match):
+    direction = match.group(1)[0]
+    stages = STAGES[direction][1]
+    if match.group(2) not in stages:
+        return True
+    values = samples[direction][stages.index(match.group(2))]
+    expected = [int(value) for value in match.groups()[2:]]
+    replayed = [len(values)] + [histogram_percentile(values, p) if values else 0 for p in (50, 90, 99)] + \
+        [max(values, default=0)]
+    if replayed == expected:
+        return True
+    print(f"mismatch {match.group(1)} {match.group(2)}: device n/p50/p90/p99/max={expected} replay={replayed}")
+    return False
+
+
+def check_prompt_summary(prompts, match):
+    values = prompts[match.group(1)]
+    expected = [int(value) for value in match.groups()[1:]]
+    replayed = [len(values)] + [histogram_percentile(values, p) if values else 0 for p in (50, 90)] + \
+        [max(values, default=0)]
+    if replayed == expected:
+        return True
+    print(f"mismatch prompt start {match.group(1)}: device n/p50/p90/max={expected} replay={replayed}")
+    return False
+
+
+def main(log_file, check):
+    samples = {direction: [[] for _ in stages] for direction, (_, stages) in STAGES.items()}
+    prompts = {kind: [] for kind in PROMPT_KINDS}
+    summaries = 0
+    mismatches = 0
+    for line in log_file:
+        match = TRACE_RE.search(line)
+        if match:
+            for i, value in enumerate(match.groups()[1:]):
+                samples[match.group(1)][i].append(int(value))
+            continue
+        match = PROMPT_TRACE_RE.search(line)
+        if match:
+            prompts[match.group(1)].append(int(match.group(2)))
+        elif check:
+            match = SUMMARY_RE.search(line)
+            if match:
+                summaries += 1
+                mismatches += 0 if check_summary(samples, match) else 1
+            match = PROMPT_SUMMARY_RE.search(line)
+            if match:
+                summaries += 1
+                mismatches += 0 if check_prompt_summary(prompts, match) else 1
+
+    for direction, (name, stages) in STAGES.items():
+        if not samples[direction][0]:
+            continue
+        print(f"{name} ({len(samples[direction][0])} frames, us, histogram / exact)")
+        for stage, values in zip(stages, samples[direction]):
+            columns = []
+            for percentile in (50, 90, 99):
+                columns.append(f"p{percentile}={histogram_percentile(values, percentile)}"
+                               f"/{exact_percentile(values, percentile)}")
+            print(f"  {stage:<15} {' '.join(columns)} max={max(values)}")
+
+    if any(prompts.values()):
+        print("prompt start (us, histogram / exact)")
+        for kind, values in prompts.items():
+            if values:
+                columns = [f"p{percentile}={histogram_percentile(values, percentile)}"
+                           f"/{exact_percentile(values, percentile)}" for percentile in (50, 90)]
+                print(f"  {kind:<15} {' '.join(columns)} max={max(values)} n={len(values)}")
+
+    if check:
+        print(f"check: {summaries - mismatches} of {summaries} device summaries match the replay")
+        if summaries == 0 or mismatches > 0:
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Audio latency trace replay')
+    parser.add_argument('log', nargs='?', help='Captured serial log, stdin if omitted')
+    parser.add_argument('--check', action='store_true', help='compare with the summaries printed by the device')
+    args = parser.parse_args()
+    if args.log:
+        with open(args.log, encoding='utf-8', errors='replace') as f:
+            sys.exit(main(f, args.check))
+    else:
+        sys.exit(main(sys.stdin, args.check))
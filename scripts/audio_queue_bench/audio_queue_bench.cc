@@ -0,0 +1,204 @@
+// Runs the four AudioService pipelines (decode, send, encode, playback) at once, each with its own
+// producer and consumer thread, through two queue designs:
+//
+//   mutex: one mutex and one condition variable shared by all deques, as before the SPSC rings
+//   spsc:  main/audio/spsc_ring.h with one "not empty" / "not full" event per queue
+//
+// and prints the throughput, the push and pop latency and how often a thread found the lock taken.
+//
+//   ./run.sh [items per queue]
+
+#include "spsc_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define QUEUES 4
+#define QUEUE_CAPACITY 40   // MAX_DECODE_PACKETS_IN_QUEUE
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    double seconds = 0;
+    std::vector<uint32_t> op_ns;        // Push and pop latency, sampled
+    std::atomic<uint64_t> contended{0}; // Lock attempts that found it taken
+    std::atomic<uint64_t> waits{0};     // Times a thread went to sleep on a full or empty queue
+};
+
+static uint32_t NsSince(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+template <typename Mutex>
+static std::unique_lock<Mutex> Lock(Mutex& mutex, Result& result) {
+    std::unique_lock<Mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        result.contended.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+    }
+    return lock;
+}
+
+// The design before the rings: every push and pop takes the one mutex and wakes every waiter
+class MutexQueues {
+public:
+    bool Push(int queue, uint32_t item, Result& result) {
+        auto lock = Lock(mutex_, result);
+        if (queues_[queue].size() >= QUEUE_CAPACITY) {
+            result.waits.fetch_add(1, std::memory_order_relaxed);
+            cv_.wait(lock, [&]() { return queues_[queue].size() < QUEUE_CAPACITY; });
+        }
+        queues_[queue].push_back(item);
+        cv_.notify_all();
+        return true;
+    }
+
+    uint32_t Pop(int queue, Result& result) {
+        auto lock = Lock(mutex_, result);
+        if (queues_[queue].empty()) {
+            result.waits.fetch_add(1, std::memory_order_relaxed);
+            cv_.wait(lock, [&]() { return !queues_[queue].empty(); });
+        }
+        uint32_t item = queues_[queue].front();
+        queues_[queue].pop_front();
+        cv_.notify_all();
+        return item;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<uint32_t> queues_[QUEUES];
+};
+
+// An event group bit: setting it takes a short critical section, like xEventGroupSetBits()
+class EventBit {
+public:
+    void Set(Result& result) {
+        if (set_.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        auto lock = Lock(mutex_, result);
+        cv_.notify_all();
+    }
+    void Clear() { set_.store(false, std::memory_order_release); }
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return set_.load(std::memory_order_acquire); });
+    }
+
+private:
+    std::atomic<bool> set_{false};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+// The current design: a lock-free ring per queue, a producer only wakes the consumer of its queue
+class SpscQueues {
+public:
+    bool Push(int queue, uint32_t item, Result& result) {
+        while (!rings_[queue].Push(std::move(item))) {
+            not_full_[queue].Clear();
+            if (rings_[queue].Full()) {
+                result.waits.fetch_add(1, std::memory_order_relaxed);
+                not_full_[queue].Wait();
+            }
+        }
+        not_empty_[queue].Set(result);
+        return true;
+    }
+
+    uint32_t Pop(int queue, Result& result) {
+        uint32_t item;
+        while (!rings_[queue].Pop(item)) {
+            not_empty_[queue].Clear();
+            if (rings_[queue].Empty()) {
+                result.waits.fetch_add(1, std::memory_order_relaxed);
+                not_empty_[queue].Wait();
+            }
+        }
+        not_full_[queue].Set(result);
+        return item;
+    }
+
+private:
+    SpscRing<uint32_t, QUEUE_CAPACITY> rings_[QUEUES];
+    EventBit not_empty_[QUEUES];
+    EventBit not_full_[QUEUES];
+};
+
+template <typename Queues>
+static void Run(uint32_t items, Result& result) {
+    Queues queues;
+    std::vector<std::thread> threads;
+    std::vector<std::vector<uint32_t>> samples(QUEUES * 2);
+    std::atomic<bool> order_ok{true};
+    auto start = Clock::now();
+    for (int q = 0; q < QUEUES; q++) {
+        threads.emplace_back([&, q]() {
+            auto& ns = samples[q * 2];
+            for (uint32_t i = 0; i < items; i++) {
+                auto op_start = Clock::now();
+                queues.Push(q, i, result);
+                if ((i & 63) == 0) {
+                    ns.push_back(NsSince(op_start));
+                }
+            }
+        });
+        threads.emplace_back([&, q]() {
+            auto& ns = samples[q * 2 + 1];
+            for (uint32_t i = 0; i < items; i++) {
+                auto op_start = Clock::now();
+                if (queues.Pop(q, result) != i) {
+                    order_ok = false;
+                }
+                if ((i & 63) == 0) {
+                    ns.push_back(NsSince(op_start));
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (auto& ns : samples) {
+        result.op_ns.insert(result.op_ns.end(), ns.begin(), ns.end());
+    }
+    std::sort(result.op_ns.begin(), result.op_ns.end());
+    if (!order_ok) {
+        printf("FAIL: items out of order\n");
+        exit(1);
+    }
+}
+
+static void Print(const char* name, uint32_t items, const Result& result) {
+    auto percentile = [&](int p) {
+        return result.op_ns[std::min(result.op_ns.size() - 1, result.op_ns.size() * p / 100)];
+    };
+    uint64_t total = (uint64_t)items * QUEUES;
+    printf("%-6s %8.2f Mitems/s %8.1f ns/item  push/pop p50=%u p99=%u max=%u ns  contended=%llu waits=%llu\n",
+        name, total / result.seconds / 1e6, result.seconds * 1e9 / total, percentile(50), percentile(99),
+        result.op_ns.back(), (unsigned long long)result.contended.load(), (unsigned long long)result.waits.load());
+}
+
+int main(int argc, char** argv) {
+    uint32_t items = argc > 1 ? atoi(argv[1]) : 500000;
+    printf("%d queues of %d, %u items each, %u hardware threads\n", QUEUES, QUEUE_CAPACITY, items,
+        std::thread::hardware_concurrency());
+    Result mutex_result;
+    Run<MutexQueues>(items, mutex_result);
+    Print("mutex", items, mutex_result);
+    Result spsc_result;
+    Run<SpscQueues>(items, spsc_result);
+    Print("spsc", items, spsc_result);
+    return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/sh
+# Builds the benchmark against main/audio/spsc_ring.h and compares it with the shared mutex
+set -e
+cd "$(dirname "$0")"
+ROOT=../..
+BUILD=$(mktemp -d)
+trap 'rm -rf "$BUILD"' EXIT
+${CXX:-c++} -std=c++17 -O2 -Wall -pthread -I$ROOT/main/audio -o "$BUILD/audio_queue_bench" audio_queue_bench.cc
+"$BUILD/audio_queue_bench" "$@"
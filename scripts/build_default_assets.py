@@ -11,6 +11,7 @@ Usage:
 """
 
 import argparse
+import hashlib
 import io
 import os
 import shutil
@@ -339,6 +340,11 @@ def compute_checksum(data):
     return checksum
 
 
+# Per-file SHA-256 read by the firmware (main/assets.h): each asset is checked when it is first
+# used, and an update downloads only the files whose hash changed
+MANIFEST_NAME = 'assets.sha256'
+
+
 def sort_key(filename):
     basename, extension = os.path.splitext(filename)
     return extension, basename
@@ -350,7 +356,8 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
     """
     merged_data = bytearray()
     file_info_list = []
-    skip_files = ['config.json']
+    file_hashes = []
+    skip_files = ['config.json', MANIFEST_NAME]
 
     # Ensure output directory exists
     os.makedirs(os.path.dirname(out_file), exist_ok=True)
@@ -376,6 +383,16 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
             bin_data = bin_file.read()
 
         merged_data.extend(bin_data)
+        file_hashes.append((file_name, hashlib.sha256(bin_data).digest()))
+
+    # The manifest goes last: name padded like in the table, then the hash
+    manifest = bytearray()
+    for file_name, digest in file_hashes:
+        manifest.extend(file_name.ljust(max_name_len, '\0')[:max_name_len].encode('utf-8'))
+        manifest.extend(digest)
+    file_info_list.append((MANIFEST_NAME, len(merged_data), len(manifest), 0, 0))
+    merged_data.extend(b'\x5A' * 2)
+    merged_data.extend(manifest)
 
     total_files = len(file_info_list)
 
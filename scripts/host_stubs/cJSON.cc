@@ -0,0 +1,430 @@
+// A small cJSON work-alike for host builds: same tree layout, malloc'ed nodes and strings, and
+// the same number and string formatting, so printed JSON matches the device byte for byte.
+#include "cJSON.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static char* Duplicate(const char* s) {
+    size_t n = strlen(s) + 1;
+    char* copy = (char*)malloc(n);
+    memcpy(copy, s, n);
+    return copy;
+}
+
+static cJSON* NewItem(int type) {
+    cJSON* item = (cJSON*)calloc(1, sizeof(cJSON));
+    item->type = type;
+    return item;
+}
+
+void cJSON_Delete(cJSON* item) {
+    while (item != nullptr) {
+        cJSON* next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
+
+void cJSON_free(void* object) {
+    free(object);
+}
+
+cJSON* cJSON_GetObjectItem(const cJSON* object, const char* string) {
+    if (object == nullptr || string == nullptr) {
+        return nullptr;
+    }
+    for (cJSON* child = object->child; child != nullptr; child = child->next) {
+        if (child->string != nullptr && strcasecmp(child->string, string) == 0) {
+            return child;
+        }
+    }
+    return nullptr;
+}
+
+cJSON* cJSON_GetArrayItem(const cJSON* array, int index) {
+    cJSON* child = array != nullptr ? array->child : nullptr;
+    while (child != nullptr && index-- > 0) {
+        child = child->next;
+    }
+    return child;
+}
+
+int cJSON_GetArraySize(const cJSON* array) {
+    int size = 0;
+    for (cJSON* child = array != nullptr ? array->child : nullptr; child != nullptr; child = child->next) {
+        size++;
+    }
+    return size;
+}
+
+cJSON_bool cJSON_IsFalse(const cJSON* item) { return item != nullptr && (item->type & 0xFF) == cJSON_False; }
+cJSON_bool cJSON_IsTrue(const cJSON* item) { return item != nullptr && (item->type & 0xFF) == cJSON_True; }
+cJSON_bool cJSON_IsBool(const cJSON* item) { return item != nullptr && (item->type & (cJSON_True | cJSON_False)) != 0; }
+cJSON_bool cJSON_IsNull(const cJSON* item) { return item != nullptr && (item->type & 0xFF) == cJSON_NULL; }
+cJSON_bool cJSON_IsNumber(const cJSON* item) { return item != nullptr && (item->type & 0xFF) == cJSON_Number; }
+cJSON_bool cJSON_IsString(const cJSON* item) { return item != nullptr && (item->type & 0xFF) == cJSON_String; }
+cJSON_bool cJSON_IsArray(const cJSON* item) { return item != nullptr && (item->type & 0xFF) == cJSON_Array; }
+cJSON_bool cJSON_IsObject(const cJSON* item) { return item != nullptr && (item->type & 0xFF) == cJSON_Object; }
+
+cJSON* cJSON_CreateNull(void) { return NewItem(cJSON_NULL); }
+cJSON* cJSON_CreateArray(void) { return NewItem(cJSON_Array); }
+cJSON* cJSON_CreateObject(void) { return NewItem(cJSON_Object); }
+
+cJSON* cJSON_CreateBool(cJSON_bool boolean) {
+    // Parsed booleans carry valueint too, the firmware reads it
+    cJSON* item = NewItem(boolean ? cJSON_True : cJSON_False);
+    item->valueint = boolean ? 1 : 0;
+    return item;
+}
+
+cJSON* cJSON_CreateNumber(double num) {
+    cJSON* item = NewItem(cJSON_Number);
+    item->valuedouble = num;
+    if (num >= 2147483647.0) {
+        item->valueint = 2147483647;
+    } else if (num <= -2147483648.0) {
+        item->valueint = -2147483647 - 1;
+    } else {
+        item->valueint = (int)num;
+    }
+    return item;
+}
+
+cJSON* cJSON_CreateString(const char* string) {
+    cJSON* item = NewItem(cJSON_String);
+    item->valuestring = Duplicate(string);
+    return item;
+}
+
+cJSON_bool cJSON_AddItemToArray(cJSON* array, cJSON* item) {
+    if (array == nullptr || item == nullptr) {
+        return 0;
+    }
+    if (array->child == nullptr) {
+        array->child = item;
+        item->prev = item;
+    } else {
+        // Like cJSON, the head's prev points to the tail
+        cJSON* tail = array->child->prev;
+        tail->next = item;
+        item->prev = tail;
+        array->child->prev = item;
+    }
+    item->next = nullptr;
+    return 1;
+}
+
+cJSON_bool cJSON_AddItemToObject(cJSON* object, const char* string, cJSON* item) {
+    if (object == nullptr || string == nullptr || item == nullptr) {
+        return 0;
+    }
+    free(item->string);
+    item->string = Duplicate(string);
+    return cJSON_AddItemToArray(object, item);
+}
+
+cJSON* cJSON_AddNullToObject(cJSON* object, const char* name) {
+    cJSON* item = cJSON_CreateNull();
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON* cJSON_AddBoolToObject(cJSON* object, const char* name, cJSON_bool boolean) {
+    cJSON* item = cJSON_CreateBool(boolean);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number) {
+    cJSON* item = cJSON_CreateNumber(number);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON* cJSON_AddStringToObject(cJSON* object, const char* name, const char* string) {
+    cJSON* item = cJSON_CreateString(string);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+// Printing
+
+static void PrintString(std::string& out, const char* s) {
+    out += '"';
+    for (const unsigned char* p = (const unsigned char*)s; *p != 0; p++) {
+        switch (*p) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (*p < 32) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", *p);
+                out += escaped;
+            } else {
+                out += (char)*p;
+            }
+        }
+    }
+    out += '"';
+}
+
+static void PrintNumber(std::string& out, double d) {
+    char buffer[32];
+    if (std::isnan(d) || std::isinf(d)) {
+        snprintf(buffer, sizeof(buffer), "null");
+    } else if (d == (double)(int)d) {
+        snprintf(buffer, sizeof(buffer), "%d", (int)d);
+    } else {
+        // The shortest of 15 or 17 digits that reads back the same, as cJSON does
+        snprintf(buffer, sizeof(buffer), "%1.15g", d);
+        if (strtod(buffer, nullptr) != d) {
+            snprintf(buffer, sizeof(buffer), "%1.17g", d);
+        }
+    }
+    out += buffer;
+}
+
+static void PrintValue(std::string& out, const cJSON* item, bool format, int depth);
+
+static void PrintChildren(std::string& out, const cJSON* item, bool object, bool format, int depth) {
+    out += object ? '{' : '[';
+    bool first = true;
+    for (const cJSON* child = item->child; child != nullptr; child = child->next) {
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+        if (format && object) {
+            out += '\n';
+            out.append(depth + 1, '\t');
+        }
+        if (object) {
+            PrintString(out, child->string);
+            out += ':';
+            if (format) {
+                out += '\t';
+            }
+        }
+        PrintValue(out, child, format, depth + 1);
+    }
+    if (format && object) {
+        out += '\n';
+        out.append(depth, '\t');
+    }
+    out += object ? '}' : ']';
+}
+
+static void PrintValue(std::string& out, const cJSON* item, bool format, int depth) {
+    switch (item->type & 0xFF) {
+    case cJSON_False: out += "false"; break;
+    case cJSON_True: out += "true"; break;
+    case cJSON_NULL: out += "null"; break;
+    case cJSON_Number: PrintNumber(out, item->valuedouble); break;
+    case cJSON_String: PrintString(out, item->valuestring != nullptr ? item->valuestring : ""); break;
+    case cJSON_Array: PrintChildren(out, item, false, format, depth); break;
+    case cJSON_Object: PrintChildren(out, item, true, format, depth); break;
+    default: break;
+    }
+}
+
+static char* Print(const cJSON* item, bool format) {
+    if (item == nullptr) {
+        return nullptr;
+    }
+    std::string out;
+    PrintValue(out, item, format, 0);
+    return Duplicate(out.c_str());
+}
+
+char* cJSON_PrintUnformatted(const cJSON* item) { return Print(item, false); }
+char* cJSON_Print(const cJSON* item) { return Print(item, true); }
+
+// Parsing
+
+struct Parser {
+    const char* p;
+    const char* end;
+
+    void SkipSpace() {
+        while (p < end && (unsigned char)*p <= 32) {
+            p++;
+        }
+    }
+    bool Match(const char* literal) {
+        size_t n = strlen(literal);
+        if ((size_t)(end - p) >= n && strncmp(p, literal, n) == 0) {
+            p += n;
+            return true;
+        }
+        return false;
+    }
+    static void AppendUtf8(std::string& out, unsigned code) {
+        if (code < 0x80) {
+            out += (char)code;
+        } else if (code < 0x800) {
+            out += (char)(0xC0 | (code >> 6));
+            out += (char)(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += (char)(0xE0 | (code >> 12));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        } else {
+            out += (char)(0xF0 | (code >> 18));
+            out += (char)(0x80 | ((code >> 12) & 0x3F));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        }
+    }
+    bool Hex4(unsigned& code) {
+        if (end - p < 4) {
+            return false;
+        }
+        char digits[5] = {p[0], p[1], p[2], p[3], 0};
+        char* tail;
+        code = strtoul(digits, &tail, 16);
+        p += 4;
+        return tail == digits + 4;
+    }
+    char* String() {
+        if (p >= end || *p != '"') {
+            return nullptr;
+        }
+        p++;
+        std::string out;
+        while (p < end && *p != '"') {
+            if (*p != '\\') {
+                out += *p++;
+                continue;
+            }
+            if (++p >= end) {
+                return nullptr;
+            }
+            char c = *p++;
+            switch (c) {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned code;
+                if (!Hex4(code)) {
+                    return nullptr;
+                }
+                if (code >= 0xD800 && code < 0xDC00 && Match("\\u")) {
+                    unsigned low;
+                    if (!Hex4(low)) {
+                        return nullptr;
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                AppendUtf8(out, code);
+                break;
+            }
+            default: out += c; break;
+            }
+        }
+        if (p >= end) {
+            return nullptr;
+        }
+        p++;
+        return Duplicate(out.c_str());
+    }
+    cJSON* Value() {
+        SkipSpace();
+        if (p >= end) {
+            return nullptr;
+        }
+        if (Match("null")) {
+            return cJSON_CreateNull();
+        }
+        if (Match("false")) {
+            return cJSON_CreateBool(0);
+        }
+        if (Match("true")) {
+            return cJSON_CreateBool(1);
+        }
+        if (*p == '"') {
+            char* s = String();
+            if (s == nullptr) {
+                return nullptr;
+            }
+            cJSON* item = NewItem(cJSON_String);
+            item->valuestring = s;
+            return item;
+        }
+        if (*p == '-' || (*p >= '0' && *p <= '9')) {
+            std::string digits;
+            while (p < end && strchr("+-0123456789.eE", *p) != nullptr) {
+                digits += *p++;
+            }
+            return cJSON_CreateNumber(strtod(digits.c_str(), nullptr));
+        }
+        if (*p == '[' || *p == '{') {
+            bool object = *p++ == '{';
+            cJSON* item = NewItem(object ? cJSON_Object : cJSON_Array);
+            SkipSpace();
+            if (p < end && *p == (object ? '}' : ']')) {
+                p++;
+                return item;
+            }
+            while (true) {
+                char* name = nullptr;
+                if (object) {
+                    SkipSpace();
+                    name = String();
+                    SkipSpace();
+                    if (name == nullptr || p >= end || *p++ != ':') {
+                        free(name);
+                        cJSON_Delete(item);
+                        return nullptr;
+                    }
+                }
+                cJSON* child = Value();
+                if (child == nullptr) {
+                    free(name);
+                    cJSON_Delete(item);
+                    return nullptr;
+                }
+                child->string = name;
+                cJSON_AddItemToArray(item, child);
+                SkipSpace();
+                if (p < end && *p == ',') {
+                    p++;
+                    continue;
+                }
+                if (p < end && *p == (object ? '}' : ']')) {
+                    p++;
+                    return item;
+                }
+                cJSON_Delete(item);
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+};
+
+cJSON* cJSON_ParseWithLength(const char* value, size_t length) {
+    if (value == nullptr) {
+        return nullptr;
+    }
+    Parser parser{value, value + length};
+    return parser.Value();
+}
+
+cJSON* cJSON_Parse(const char* value) {
+    return value != nullptr ? cJSON_ParseWithLength(value, strlen(value)) : nullptr;
+}
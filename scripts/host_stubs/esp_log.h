@@ -0,0 +1,12 @@
+// Logs are compiled out in host builds. The firmware prints uint32_t with %lu, which is not
+// portable to a 64-bit host.
+#ifndef ESP_LOG_HOST_H
+#define ESP_LOG_HOST_H
+
+#define ESP_LOGE(tag, format, ...) ((void)(tag))
+#define ESP_LOGW(tag, format, ...) ((void)(tag))
+#define ESP_LOGI(tag, format, ...) ((void)(tag))
+#define ESP_LOGD(tag, format, ...) ((void)(tag))
+#define ESP_LOGV(tag, format, ...) ((void)(tag))
+
+#endif
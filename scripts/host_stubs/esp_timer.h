@@ -0,0 +1,31 @@
+// esp_timer_get_time() on the host monotonic clock. Timers can be created but never fire.
+#ifndef ESP_TIMER_HOST_H
+#define ESP_TIMER_HOST_H
+
+#include <chrono>
+#include <cstdint>
+
+typedef void (*esp_timer_cb_t)(void* arg);
+typedef struct esp_timer* esp_timer_handle_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    const char* name;
+} esp_timer_create_args_t;
+
+inline int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline int esp_timer_create(const esp_timer_create_args_t*, esp_timer_handle_t* handle) {
+    *handle = nullptr;
+    return 0;
+}
+inline int esp_timer_start_once(esp_timer_handle_t, uint64_t) { return 0; }
+inline int esp_timer_start_periodic(esp_timer_handle_t, uint64_t) { return 0; }
+inline int esp_timer_stop(esp_timer_handle_t) { return 0; }
+inline int esp_timer_delete(esp_timer_handle_t) { return 0; }
+
+#endif
@@ -0,0 +1,49 @@
+// Counts every heap allocation of a host benchmark, including those of libstdc++ and the cJSON
+// stub. Include it in exactly one translation unit of the program.
+#ifndef HEAP_COUNTER_H
+#define HEAP_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+extern "C" void __libc_free(void* pointer);
+
+struct HeapCounter {
+    static std::atomic<uint64_t>& allocations() {
+        static std::atomic<uint64_t> count{0};
+        return count;
+    }
+    static std::atomic<uint64_t>& bytes() {
+        static std::atomic<uint64_t> count{0};
+        return count;
+    }
+};
+
+extern "C" void* malloc(size_t size) {
+    HeapCounter::allocations().fetch_add(1, std::memory_order_relaxed);
+    HeapCounter::bytes().fetch_add(size, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    HeapCounter::allocations().fetch_add(1, std::memory_order_relaxed);
+    HeapCounter::bytes().fetch_add(count * size, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) {
+    HeapCounter::allocations().fetch_add(1, std::memory_order_relaxed);
+    HeapCounter::bytes().fetch_add(size, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void* pointer) {
+    __libc_free(pointer);
+}
+
+#endif
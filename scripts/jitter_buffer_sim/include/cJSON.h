@@ -0,0 +1,9 @@
+// Declarations only, the simulator never builds the JSON statistics
+#ifndef CJSON_STUB_H
+#define CJSON_STUB_H
+
+typedef struct cJSON cJSON;
+cJSON* cJSON_CreateObject();
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number);
+
+#endif
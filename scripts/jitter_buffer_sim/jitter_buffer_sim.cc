@@ -0,0 +1,273 @@
+/*
+ * Replays lossy arrival traces through main/audio/jitter_buffer.cc, deterministically.
+ *
+ * Each trace is a list of packet arrivals generated from a fixed seed. The simulated opus decode
+ * task moves arrivals into the buffer as they happen and takes one frame per frame duration, like
+ * the playback clock of the device. Every trace checks that sequenced packets are played in order
+ * and that each packet is played, counted as late or as a duplicate, and then its own expectations.
+ *
+ * Usage: ./run.sh [-v]   prints one line per trace, exits 1 if a check failed
+ */
+#include "jitter_buffer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+ObjectPool<AudioStreamPacket>& GetAudioStreamPacketPool() {
+    static ObjectPool<AudioStreamPacket> pool(AUDIO_STREAM_PACKET_POOL_SIZE);
+    return pool;
+}
+
+#define FRAME_US 60000
+#define PROMPT_ID_BASE 100000
+
+struct Arrival {
+    int64_t time_us;
+    uint32_t sequence;  // 0 for a packet without one
+    uint32_t id;        // Carried in the timestamp, to see what was played
+};
+
+struct Result {
+    std::vector<int64_t> played;    // Ids, -1 for a concealed frame
+    JitterBufferStatistics stats;
+    uint32_t arrived = 0;
+    uint32_t stalls = 0;            // Frames the output clock found nothing to play
+};
+
+// Same numbers on every platform
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+    uint32_t Next() {
+        state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+        return state_ >> 33;
+    }
+    int64_t Uniform(int64_t max) { return max > 0 ? Next() % (max + 1) : 0; }
+    bool Chance(int percent) { return Next() % 100 < (uint32_t)percent; }
+
+private:
+    uint64_t state_;
+};
+
+static Result Replay(std::vector<Arrival> arrivals) {
+    std::stable_sort(arrivals.begin(), arrivals.end(), [](const Arrival& a, const Arrival& b) {
+        return a.time_us < b.time_us;
+    });
+
+    JitterBuffer buffer;
+    Result result;
+    result.arrived = arrivals.size();
+    size_t next = 0;
+    int64_t next_output_us = -1;
+    int64_t end_us = arrivals.empty() ? 0 : arrivals.back().time_us + 2000000;
+    for (int64_t now = 0; now <= end_us; now += 1000) {
+        while (next < arrivals.size() && arrivals[next].time_us <= now && !buffer.Full()) {
+            auto packet = GetAudioStreamPacketPool().Acquire();
+            packet->sequence = arrivals[next].sequence;
+            packet->timestamp = arrivals[next].id;
+            packet->frame_duration = FRAME_US / 1000;
+            buffer.Put(std::move(packet), now);
+            next++;
+        }
+
+        if (next_output_us >= 0 && now < next_output_us) {
+            continue;
+        }
+        AudioStreamPacketPtr packet;
+        auto got = buffer.Get(packet, now);
+        if (got == kJitterBufferNotReady) {
+            if (next_output_us >= 0 && now == next_output_us && !buffer.Empty()) {
+                result.stalls++;
+            }
+            continue;
+        }
+        result.played.push_back(got == kJitterBufferPacket ? (int64_t)packet->timestamp : -1);
+        next_output_us = now + FRAME_US;
+    }
+    result.stats = buffer.statistics();
+    return result;
+}
+
+// A sequenced stream of count packets sent every frame from t=0, before loss and delay
+static std::vector<Arrival> Stream(uint32_t count, int64_t base_delay_us, int64_t jitter_us, int loss_percent, Random& random) {
+    std::vector<Arrival> arrivals;
+    for (uint32_t sequence = 1; sequence <= count; sequence++) {
+        if (random.Chance(loss_percent)) {
+            continue;
+        }
+        arrivals.push_back({sequence * (int64_t)FRAME_US + base_delay_us + random.Uniform(jitter_us), sequence, sequence});
+    }
+    return arrivals;
+}
+
+// A local prompt is pushed in one go
+static void AddPrompt(std::vector<Arrival>& arrivals, int64_t time_us, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        arrivals.push_back({time_us, 0, PROMPT_ID_BASE + i});
+    }
+}
+
+struct Trace {
+    const char* name;
+    std::function<std::vector<Arrival>(Random&)> generate;
+    std::function<std::string(const std::vector<Arrival>&, const Result&)> check;
+};
+
+static uint32_t Count(const std::vector<int64_t>& played, std::function<bool(int64_t)> predicate) {
+    return std::count_if(played.begin(), played.end(), predicate);
+}
+
+static bool IsSequenced(int64_t id) { return id > 0 && id < PROMPT_ID_BASE; }
+static bool IsPrompt(int64_t id) { return id >= PROMPT_ID_BASE; }
+
+// Checks that hold for every trace, empty if all pass
+static std::string CheckCommon(const std::vector<Arrival>& arrivals, const Result& result) {
+    int64_t last = 0;
+    for (auto id : result.played) {
+        if (IsSequenced(id)) {
+            if (id <= last) {
+                return "sequenced packets played out of order";
+            }
+            last = id;
+        }
+    }
+    uint32_t packets = Count(result.played, [](int64_t id) { return id >= 0; });
+    if (packets + result.stats.late + result.stats.duplicate != result.arrived) {
+        return "played + late + duplicate != arrived";
+    }
+    if (Count(result.played, [](int64_t id) { return id < 0; }) != result.stats.lost) {
+        return "concealed frames != lost";
+    }
+    return "";
+}
+
+static uint32_t Missing(const std::vector<Arrival>& arrivals, uint32_t count) {
+    uint32_t arrived = std::count_if(arrivals.begin(), arrivals.end(), [](const Arrival& a) { return a.sequence != 0; });
+    return count - arrived;
+}
+
+int main(int argc, char* argv[]) {
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    std::vector<Trace> traces = {
+        {"clean", [](Random& r) { return Stream(200, 20000, 0, 0, r); },
+            [](auto& a, auto& res) -> std::string {
+                return res.stats.lost == 0 && res.stats.late == 0 && res.stats.target_depth == 1 ? "" : "loss or depth on a clean link";
+            }},
+        {"jitter 80 ms", [](Random& r) { return Stream(300, 20000, 80000, 0, r); },
+            [](auto& a, auto& res) -> std::string {
+                // The estimate needs a few packets to grow, later ones must all make it
+                return res.stats.lost + res.stats.late <= 3 ? "" : "too many frames lost to jitter";
+            }},
+        {"loss 5%", [](Random& r) { return Stream(300, 20000, 20000, 5, r); },
+            [](auto& a, auto& res) -> std::string {
+                return res.stats.lost >= Missing(a, 300) - 1 && res.stats.late == 0 ? "" : "missing packets not concealed";
+            }},
+        {"burst loss", [](Random& r) {
+                auto arrivals = Stream(200, 20000, 10000, 0, r);
+                arrivals.erase(std::remove_if(arrivals.begin(), arrivals.end(), [](const Arrival& a) {
+                    return a.sequence >= 100 && a.sequence < 108;
+                }), arrivals.end());
+                return arrivals;
+            },
+            [](auto& a, auto& res) -> std::string {
+                return res.stats.lost == 8 && res.stats.late == 0 ? "" : "burst not concealed frame by frame";
+            }},
+        {"reorder", [](Random& r) {
+                auto arrivals = Stream(200, 20000, 0, 0, r);
+                for (auto& arrival : arrivals) {
+                    if (arrival.sequence % 10 == 5) {
+                        arrival.time_us += FRAME_US + 10000;  // Overtaken by the next packet
+                    }
+                }
+                return arrivals;
+            },
+            [](auto& a, auto& res) -> std::string {
+                return res.stats.late == 0 ? "" : "reordered packets came too late";
+            }},
+        {"late spike", [](Random& r) {
+                auto arrivals = Stream(200, 20000, 0, 0, r);
+                arrivals[99].time_us += 600000;
+                return arrivals;
+            },
+            [](auto& a, auto& res) -> std::string {
+                return res.stats.late == 1 && res.stats.lost == 1 ? "" : "the spiked packet is not late and concealed";
+            }},
+        {"prompt during stream", [](Random& r) {
+                auto arrivals = Stream(200, 20000, 20000, 0, r);
+                AddPrompt(arrivals, 100 * FRAME_US, 10);
+                return arrivals;
+            },
+            [](auto& a, auto& res) -> std::string {
+                if (res.stats.duplicate != 0) {
+                    return "a prompt took the sequence of a stream packet";
+                }
+                if (Count(res.played, IsPrompt) != 10 || Count(res.played, IsSequenced) != 200) {
+                    return "prompt or stream packets missing";
+                }
+                return "";
+            }},
+        {"prompt before stream", [](Random& r) {
+                auto arrivals = Stream(100, 200000, 0, 0, r);
+                AddPrompt(arrivals, 0, 10);
+                return arrivals;
+            },
+            [](auto& a, auto& res) -> std::string {
+                auto first_stream = std::find_if(res.played.begin(), res.played.end(), IsSequenced);
+                if (std::count_if(res.played.begin(), first_stream, IsPrompt) != 10) {
+                    return "the prompt did not play ahead of the stream";
+                }
+                return Count(res.played, IsSequenced) == 100 ? "" : "stream packets missing";
+            }},
+        {"unsequenced stream", [](Random& r) {
+                // Websocket: no sequence numbers, packets keep their order on TCP
+                auto arrivals = Stream(200, 20000, 0, 0, r);
+                int64_t last = 0;
+                for (auto& arrival : arrivals) {
+                    arrival.time_us = std::max(last, arrival.time_us + r.Uniform(60000));
+                    last = arrival.time_us;
+                    arrival.sequence = 0;
+                }
+                return arrivals;
+            },
+            [](auto& a, auto& res) -> std::string {
+                int64_t last = 0;
+                for (auto id : res.played) {
+                    if (id >= 0 && id <= last) {
+                        return "not played in arrival order";
+                    }
+                    last = std::max(last, id);
+                }
+                return res.stats.lost == 0 && Count(res.played, [](int64_t id) { return id > 0; }) == 200 ? "" : "packets lost";
+            }},
+    };
+
+    int failures = 0;
+    for (auto& trace : traces) {
+        Random random(20240601);
+        auto arrivals = trace.generate(random);
+        auto result = Replay(arrivals);
+        auto error = CheckCommon(arrivals, result);
+        if (error.empty()) {
+            error = trace.check(arrivals, result);
+        }
+        printf("%-22s %s  arrived=%lu played=%lu late=%lu duplicate=%lu lost=%lu stalls=%lu target_depth=%lu jitter=%lums%s%s\n",
+            trace.name, error.empty() ? "PASS" : "FAIL", (unsigned long)result.arrived,
+            (unsigned long)Count(result.played, [](int64_t id) { return id >= 0; }), (unsigned long)result.stats.late,
+            (unsigned long)result.stats.duplicate, (unsigned long)result.stats.lost, (unsigned long)result.stalls,
+            (unsigned long)result.stats.target_depth, (unsigned long)result.stats.jitter_ms,
+            error.empty() ? "" : "  ", error.c_str());
+        if (verbose) {
+            for (auto id : result.played) {
+                printf(" %lld", (long long)id);
+            }
+            printf("\n");
+        }
+        failures += !error.empty();
+    }
+    return failures == 0 ? 0 : 1;
+}
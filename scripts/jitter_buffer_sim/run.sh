@@ -0,0 +1,8 @@
+#!/bin/sh
+# Builds the simulator against main/audio/jitter_buffer.cc and replays every trace
+set -e
+cd "$(dirname "$0")"
+ROOT=../..
+${CXX:-c++} -std=c++17 -O2 -Wall -Iinclude -I$ROOT/main -I$ROOT/main/audio -I$ROOT/main/protocols \
+    -o jitter_buffer_sim jitter_buffer_sim.cc $ROOT/main/audio/jitter_buffer.cc
+./jitter_buffer_sim "$@"
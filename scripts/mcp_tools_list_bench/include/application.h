@@ -0,0 +1,46 @@
+// Only what mcp_server.cc calls. Replies are kept in a reused buffer instead of being sent.
+#ifndef APPLICATION_HOST_H
+#define APPLICATION_HOST_H
+
+#include <cJSON.h>
+#include <freertos/FreeRTOS.h>
+#include <string>
+#include <utility>
+
+#include "assets.h"
+#include "ota.h"
+
+class Application {
+public:
+    static Application& GetInstance() {
+        static Application instance;
+        return instance;
+    }
+
+    void SendMcpMessage(const std::string& payload) {
+        last_reply_.assign(payload);
+        replies_++;
+    }
+    template <typename F>
+    void Schedule(F&& callback, int priority = 0) { callback(); }
+    void Reboot() {}
+    bool UpgradeFirmware(Ota& ota, const std::string& url = "") { return false; }
+
+    struct StatsSource {
+        cJSON* GetStatsJson() { return cJSON_CreateObject(); }
+        StatsSource& GetLatencyTracer() { return *this; }
+    };
+    StatsSource& GetAudioChannelWarmer() { return stats_; }
+    StatsSource& GetAudioService() { return stats_; }
+
+    const std::string& last_reply() const { return last_reply_; }
+    size_t replies() const { return replies_; }
+    void ReserveReply(size_t size) { last_reply_.reserve(size); }
+
+private:
+    std::string last_reply_;
+    size_t replies_ = 0;
+    StatsSource stats_;
+};
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef ASSETS_HOST_H
+#define ASSETS_HOST_H
+
+class Assets {
+public:
+    static Assets& GetInstance() {
+        static Assets instance;
+        return instance;
+    }
+    bool partition_valid() const { return false; }
+};
+
+#endif
@@ -0,0 +1,44 @@
+// A board with a speaker and a backlight, no camera and no display
+#ifndef BOARD_HOST_H
+#define BOARD_HOST_H
+
+#include <string>
+
+class AudioCodec {
+public:
+    void SetOutputVolume(int volume) {}
+};
+
+class Backlight {
+public:
+    void SetBrightness(int brightness, bool permanent = false) {}
+};
+
+class Camera {
+public:
+    void SetExplainUrl(const std::string& url, const std::string& token) {}
+    bool Capture() { return false; }
+    std::string Explain(const std::string& question) { return ""; }
+};
+
+class Display {};
+
+class Board {
+public:
+    static Board& GetInstance() {
+        static Board instance;
+        return instance;
+    }
+    std::string GetDeviceStatusJson() { return "{}"; }
+    std::string GetSystemInfoJson() { return "{}"; }
+    AudioCodec* GetAudioCodec() { return &codec_; }
+    Backlight* GetBacklight() { return &backlight_; }
+    Camera* GetCamera() { return nullptr; }
+    Display* GetDisplay() { return nullptr; }
+
+private:
+    AudioCodec codec_;
+    Backlight backlight_;
+};
+
+#endif
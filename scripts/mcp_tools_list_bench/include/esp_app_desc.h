@@ -0,0 +1,13 @@
+#ifndef ESP_APP_DESC_HOST_H
+#define ESP_APP_DESC_HOST_H
+
+typedef struct {
+    char version[32];
+} esp_app_desc_t;
+
+inline const esp_app_desc_t* esp_app_get_description() {
+    static const esp_app_desc_t desc = {"host"};
+    return &desc;
+}
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef FREERTOS_HOST_H
+#define FREERTOS_HOST_H
+
+#define pdMS_TO_TICKS(ms) (ms)
+inline void vTaskDelay(int ticks) {}
+
+#endif
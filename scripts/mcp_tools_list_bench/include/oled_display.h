@@ -0,0 +1 @@
+// Not used without HAVE_LVGL
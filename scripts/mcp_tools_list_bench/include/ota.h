@@ -0,0 +1,6 @@
+#ifndef OTA_HOST_H
+#define OTA_HOST_H
+
+class Ota {};
+
+#endif
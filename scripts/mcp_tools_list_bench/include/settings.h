@@ -0,0 +1,12 @@
+#ifndef SETTINGS_HOST_H
+#define SETTINGS_HOST_H
+
+#include <string>
+
+class Settings {
+public:
+    Settings(const std::string& ns, bool read_write = false) {}
+    void SetString(const std::string& key, const std::string& value) {}
+};
+
+#endif
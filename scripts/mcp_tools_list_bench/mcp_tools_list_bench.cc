@@ -0,0 +1,137 @@
+/*
+ * Cycles and heap allocations per MCP tools/list request, with the 44 tools of a board that has
+ * a speaker, a backlight, lights, a motor and a few sensors. run.sh builds it once against the
+ * current main/mcp_server.cc and once against the baseline one, so the two can be compared.
+ *
+ * A request is one McpServer::ParseMessage() call with an already parsed request, so it covers
+ * the lookup or the build of the page and the reply, not the JSON parsing of the request.
+ */
+#include "mcp_server.h"
+#include "application.h"
+#include "heap_counter.h"
+
+#include <x86intrin.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static ReturnValue Done(const PropertyList& properties) {
+    return true;
+}
+
+static void AddBoardTools(McpServer& server) {
+    const char* lights[] = {"desk", "ceiling", "strip", "night", "porch", "kitchen"};
+    for (auto light : lights) {
+        std::string name = std::string("self.light.") + light;
+        server.AddTool(name + ".turn_on", std::string("Turn on the ") + light + " light", PropertyList(), Done);
+        server.AddTool(name + ".turn_off", std::string("Turn off the ") + light + " light", PropertyList(), Done);
+        server.AddTool(name + ".set_rgb", std::string("Set the color of the ") + light + " light, each channel from 0 to 255",
+            PropertyList({
+                Property("r", kPropertyTypeInteger, 0, 255),
+                Property("g", kPropertyTypeInteger, 0, 255),
+                Property("b", kPropertyTypeInteger, 0, 255),
+            }), Done);
+        server.AddTool(name + ".set_brightness", std::string("Set the brightness of the ") + light + " light in percent",
+            PropertyList({Property("brightness", kPropertyTypeInteger, 0, 100)}), Done);
+    }
+    const char* sensors[] = {"temperature", "humidity", "pressure", "air_quality", "illuminance", "battery"};
+    for (auto sensor : sensors) {
+        server.AddTool(std::string("self.sensor.get_") + sensor,
+            std::string("Read the current ") + sensor + " from the on-board sensor. Returns the value and its unit, "
+            "use it to answer questions about the room or the device.", PropertyList(), Done);
+    }
+    server.AddTool("self.motor.move", "Move the motor to a position in degrees, at a speed in percent. "
+        "A negative speed turns the other way.",
+        PropertyList({
+            Property("position", kPropertyTypeInteger, 0, 360),
+            Property("speed", kPropertyTypeInteger, 50, -100, 100),
+            Property("smooth", kPropertyTypeBoolean, true),
+        }), Done);
+    server.AddTool("self.motor.stop", "Stop the motor right away", PropertyList(), Done);
+    server.AddTool("self.alarm.set", "Set an alarm, the label is spoken when it rings",
+        PropertyList({
+            Property("hour", kPropertyTypeInteger, 0, 23),
+            Property("minute", kPropertyTypeInteger, 0, 59),
+            Property("label", kPropertyTypeString, std::string("")),
+        }), Done);
+    server.AddTool("self.alarm.cancel", "Cancel the alarm with the given label",
+        PropertyList({Property("label", kPropertyTypeString)}), Done);
+    server.AddTool("self.music.play", "Play a song by name, or resume the current one if the name is empty",
+        PropertyList({Property("name", kPropertyTypeString, std::string(""))}), Done);
+    server.AddTool("self.music.pause", "Pause the music", PropertyList(), Done);
+    server.AddTool("self.music.next", "Skip to the next song", PropertyList(), Done);
+    server.AddTool("self.music.set_mode", "Set the play mode: 0 in order, 1 repeat one, 2 shuffle",
+        PropertyList({Property("mode", kPropertyTypeInteger, 0, 2)}), Done);
+}
+
+static cJSON* Request(const std::string& cursor, bool with_user_tools) {
+    std::string text = "{\"jsonrpc\":\"2.0\",\"id\":7,\"method\":\"tools/list\",\"params\":{\"cursor\":\"" + cursor +
+        "\",\"withUserTools\":" + (with_user_tools ? "true" : "false") + "}}";
+    return cJSON_Parse(text.c_str());
+}
+
+// The requests that walk every page of a view, following nextCursor
+static std::vector<cJSON*> WalkPages(McpServer& server, bool with_user_tools, size_t& reply_bytes) {
+    auto& app = Application::GetInstance();
+    std::vector<cJSON*> requests;
+    std::string cursor;
+    reply_bytes = 0;
+    while (true) {
+        requests.push_back(Request(cursor, with_user_tools));
+        server.ParseMessage(requests.back());
+        const std::string& reply = app.last_reply();
+        reply_bytes += reply.size();
+        auto next = reply.find("\"nextCursor\":\"");
+        if (next == std::string::npos) {
+            break;
+        }
+        next += strlen("\"nextCursor\":\"");
+        cursor = reply.substr(next, reply.find('"', next) - next);
+    }
+    return requests;
+}
+
+int main() {
+    auto& server = McpServer::GetInstance();
+    auto& app = Application::GetInstance();
+    app.ReserveReply(16384);
+    server.AddCommonTools();
+    AddBoardTools(server);
+    server.AddUserOnlyTools();
+
+    for (bool with_user_tools : {false, true}) {
+        // The first walk builds the pages of a cached implementation
+        uint64_t heap_start = HeapCounter::allocations().load();
+        uint64_t tsc_start = __rdtsc();
+        size_t reply_bytes;
+        auto requests = WalkPages(server, with_user_tools, reply_bytes);
+        uint64_t first_cycles = __rdtsc() - tsc_start;
+        uint64_t first_heap = HeapCounter::allocations().load() - heap_start;
+
+        const int rounds = 2000;
+        heap_start = HeapCounter::allocations().load();
+        auto time_start = std::chrono::steady_clock::now();
+        tsc_start = __rdtsc();
+        for (int i = 0; i < rounds; i++) {
+            for (auto request : requests) {
+                server.ParseMessage(request);
+            }
+        }
+        uint64_t cycles = __rdtsc() - tsc_start;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - time_start).count();
+        uint64_t heap = HeapCounter::allocations().load() - heap_start;
+        size_t count = rounds * requests.size();
+
+        printf("%-5s view: %zu pages, %zu bytes | first walk %8.0f cycles %5.1f allocs per request | "
+            "then %8.0f cycles %6.0f ns %5.1f allocs per request\n",
+            with_user_tools ? "user" : "AI", requests.size(), reply_bytes,
+            (double)first_cycles / requests.size(), (double)first_heap / requests.size(),
+            (double)cycles / count, (double)ns / count, (double)heap / count);
+        for (auto request : requests) {
+            cJSON_Delete(request);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+#!/bin/sh
+# Builds the benchmark against the current main/mcp_server.cc and against the one of the given
+# commit (the baseline by default), and prints cycles and heap allocations per tools/list
+set -e
+cd "$(dirname "$0")"
+ROOT=$(cd ../.. && pwd)
+BASE=${1:-$(git -C "$ROOT" rev-list --max-parents=0 HEAD)}
+BUILD=$(mktemp -d)
+trap 'rm -rf "$BUILD"' EXIT
+# Copied out of main/, so its quoted includes find the stubs and not the firmware headers
+mkdir -p "$BUILD/base" "$BUILD/current"
+git -C "$ROOT" show "$BASE:main/mcp_server.h" > "$BUILD/base/mcp_server.h"
+git -C "$ROOT" show "$BASE:main/mcp_server.cc" > "$BUILD/base/mcp_server.cc"
+cp "$ROOT/main/mcp_server.h" "$ROOT/main/mcp_server.cc" "$BUILD/current/"
+
+FLAGS="-std=c++17 -O2 -w -DBOARD_NAME=\"host\" -Iinclude -I../host_stubs"
+for variant in base current; do
+    SRC="$BUILD/$variant"
+    ${CXX:-c++} $FLAGS -I"$SRC" -o "$BUILD/bench_$variant" mcp_tools_list_bench.cc "$SRC/mcp_server.cc" ../host_stubs/cJSON.cc
+done
+echo "baseline ($(git -C "$ROOT" rev-parse --short "$BASE")):"
+"$BUILD/bench_base"
+echo "current:"
+"$BUILD/bench_current"
@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+import argparse
+import hashlib
+import struct
+import sys
+
+
+'''
+  Make and check delta firmware patches for main/ota_delta.cc.
+
+  ota_delta.py diff base.bin target.bin patch.bin   # base.bin is the image the devices run
+  ota_delta.py apply base.bin patch.bin out.bin     # what the device does, to check a patch
+
+  Both images are the app .bin files from build/. The device recognizes its base image by the
+  SHA-256 that esp_image appends to every app image.
+  Serve the patch next to the full image and list it in the OTA response:
+    "firmware": { ..., "deltas": [ { "base": "<version of base.bin>", "url": "<patch url>" } ] }
+'''
+
+MAGIC = b'XZD1'
+OP_END, OP_COPY, OP_ADD, OP_INSERT = 0, 1, 2, 3
+BLOCK = 16              # Bytes hashed to find a match
+MIN_MATCH = 24          # Shorter matches are cheaper as inserts
+WINDOW = 32             # An ADD stops when less than half of the last WINDOW bytes match
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def read_varint(data, pos):
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def encode_add(base, target, base_off, target_off, length):
+    '''COPY if the bytes are equal, otherwise ADD with zero runs and literal differences'''
+    diff = bytes((target[target_off + i] - base[base_off + i]) & 0xFF for i in range(length))
+    if not any(diff):
+        return bytes([OP_COPY]) + varint(base_off) + varint(length)
+    out = bytearray([OP_ADD]) + varint(base_off) + varint(length)
+    i = 0
+    while i < length:
+        zeros = 0
+        while i + zeros < length and diff[i + zeros] == 0:
+            zeros += 1
+        i += zeros
+        # Literals run until two zero bytes in a row, a single zero is cheaper inline
+        literal_end = i
+        while literal_end < length and (diff[literal_end] != 0 or
+                                        (literal_end + 1 < length and diff[literal_end + 1] != 0)):
+            literal_end += 1
+        out += varint(zeros) + varint(literal_end - i) + diff[i:literal_end]
+        i = literal_end
+    return bytes(out)
+
+
+def extend(base, target, base_off, target_off):
+    '''Length of the region from a match on, allowing scattered differences (moved addresses)'''
+    length = 0
+    misses = []
+    while base_off + length < len(base) and target_off + length < len(target):
+        if base[base_off + length] != target[target_off + length]:
+            misses.append(length)
+            while misses and misses[0] < length - WINDOW:
+                misses.pop(0)
+            if len(misses) > WINDOW // 2:
+                break
+        length += 1
+    # Do not end on differences
+    while length > 0 and base[base_off + length - 1] != target[target_off + length - 1]:
+        length -= 1
+    return length
+
+
+def diff(base, target):
+    index = {}
+    for off in range(0, len(base) - BLOCK + 1, BLOCK // 2):
+        index.setdefault(base[off:off + BLOCK], off)
+
+    records = bytearray()
+    insert_start = 0
+    pos = 0
+    last_delta = None   # base_off - target_off of the last region, tried first
+    while pos + BLOCK <= len(target):
+        base_off = None
+        if last_delta is not None and 0 <= pos + last_delta <= len(base) - BLOCK and \
+                base[pos + last_delta:pos + last_delta + BLOCK] == target[pos:pos + BLOCK]:
+            base_off = pos + last_delta
+        else:
+            base_off = index.get(target[pos:pos + BLOCK])
+        if base_off is None:
+            pos += 1
+            continue
+        # Grow the match backwards into the bytes not covered yet
+        back = 0
+        while pos - back > insert_start and base_off - back > 0 and \
+                base[base_off - back - 1] == target[pos - back - 1]:
+            back += 1
+        start_base, start_target = base_off - back, pos - back
+        length = extend(base, target, start_base, start_target)
+        if length < MIN_MATCH:
+            pos += 1
+            continue
+        if start_target > insert_start:
+            records += bytes([OP_INSERT]) + varint(start_target - insert_start) + target[insert_start:start_target]
+        records += encode_add(base, target, start_base, start_target, length)
+        last_delta = start_base - start_target
+        pos = insert_start = start_target + length
+    if len(target) > insert_start:
+        records += bytes([OP_INSERT]) + varint(len(target) - insert_start) + target[insert_start:]
+    records.append(OP_END)
+
+    header = MAGIC + struct.pack('<I', len(base)) + base[-32:] + \
+        struct.pack('<I', len(target)) + hashlib.sha256(target).digest()
+    return header + bytes(records)
+
+
+def apply(base, patch):
+    if patch[:4] != MAGIC:
+        raise ValueError('not a delta patch')
+    base_size, = struct.unpack_from('<I', patch, 4)
+    if base_size != len(base) or patch[8:40] != base[-32:]:
+        raise ValueError('patch is for another base image')
+    target_size, = struct.unpack_from('<I', patch, 40)
+    target_sha256 = patch[44:76]
+    out = bytearray()
+    pos = 76
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op == OP_INSERT:
+            length, pos = read_varint(patch, pos)
+            out += patch[pos:pos + length]
+            pos += length
+            continue
+        base_off, pos = read_varint(patch, pos)
+        length, pos = read_varint(patch, pos)
+        if op == OP_COPY:
+            out += base[base_off:base_off + length]
+            continue
+        if op != OP_ADD:
+            raise ValueError(f'unknown record {op}')
+        end = base_off + length
+        while base_off < end:
+            zeros, pos = read_varint(patch, pos)
+            out += base[base_off:base_off + zeros]
+            base_off += zeros
+            literals, pos = read_varint(patch, pos)
+            for i in range(literals):
+                out.append((base[base_off + i] + patch[pos + i]) & 0xFF)
+            base_off += literals
+            pos += literals
+    if len(out) != target_size or hashlib.sha256(out).digest() != target_sha256:
+        raise ValueError('patched image does not match the target')
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Delta firmware patches')
+    sub = parser.add_subparsers(dest='command', required=True)
+    p = sub.add_parser('diff')
+    p.add_argument('base')
+    p.add_argument('target')
+    p.add_argument('patch')
+    p = sub.add_parser('apply')
+    p.add_argument('base')
+    p.add_argument('patch')
+    p.add_argument('output')
+    args = parser.parse_args()
+
+    if args.command == 'diff':
+        base = open(args.base, 'rb').read()
+        target = open(args.target, 'rb').read()
+        patch = diff(base, target)
+        # Check it the way the device will read it before it is served
+        apply(base, patch)
+        open(args.patch, 'wb').write(patch)
+        print(f'{args.patch}: {len(patch)} bytes, {len(patch) * 100 / len(target):.1f}% of the target')
+    else:
+        base = open(args.base, 'rb').read()
+        open(args.output, 'wb').write(apply(base, open(args.patch, 'rb').read()))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
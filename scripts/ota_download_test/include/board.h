@@ -0,0 +1,146 @@
+// A blocking HTTP/1.1 client over a plain socket, for http://host:port/path URLs and bodies with
+// a Content-Length, which is all the stand-in server sends. Opens are counted, each one after the
+// first of a download is a reconnect.
+#ifndef BOARD_HOST_H
+#define BOARD_HOST_H
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+
+class Http {
+public:
+    static inline int opens = 0;
+
+    ~Http() { Close(); }
+
+    void SetHeader(const std::string& key, const std::string& value) { request_headers_[key] = value; }
+
+    bool Open(const std::string& method, const std::string& url) {
+        opens++;
+        if (url.compare(0, 7, "http://") != 0) {
+            return false;
+        }
+        size_t slash = url.find('/', 7);
+        std::string authority = url.substr(7, slash - 7);
+        std::string path = slash == std::string::npos ? "/" : url.substr(slash);
+        size_t colon = authority.find(':');
+        std::string host = authority.substr(0, colon);
+        std::string port = colon == std::string::npos ? "80" : authority.substr(colon + 1);
+
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* address = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &address) != 0) {
+            return false;
+        }
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        bool connected = fd_ >= 0 && connect(fd_, address->ai_addr, address->ai_addrlen) == 0;
+        freeaddrinfo(address);
+        if (!connected) {
+            Close();
+            return false;
+        }
+
+        std::string request = method + " " + path + " HTTP/1.1\r\nHost: " + authority + "\r\nConnection: close\r\n";
+        for (auto& [key, value] : request_headers_) {
+            request += key + ": " + value + "\r\n";
+        }
+        request += "\r\n";
+        if (send(fd_, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t)request.size()) {
+            Close();
+            return false;
+        }
+
+        // The header byte by byte, so nothing of the body is read ahead
+        std::string head;
+        char c;
+        while (head.size() < 4 || head.compare(head.size() - 4, 4, "\r\n\r\n") != 0) {
+            if (recv(fd_, &c, 1, 0) != 1) {
+                Close();
+                return false;
+            }
+            head += c;
+        }
+        status_code_ = atoi(head.c_str() + head.find(' ') + 1);
+        size_t line = head.find("\r\n") + 2;
+        while (line < head.size() - 2) {
+            size_t end = head.find("\r\n", line);
+            size_t separator = head.find(':', line);
+            if (separator < end) {
+                size_t value = head.find_first_not_of(' ', separator + 1);
+                response_headers_[head.substr(line, separator - line)] = head.substr(value, end - value);
+            }
+            line = end + 2;
+        }
+        body_length_ = strtoul(GetResponseHeader("Content-Length").c_str(), nullptr, 10);
+        remaining_ = body_length_;
+        return true;
+    }
+
+    void Close() {
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    int GetStatusCode() { return status_code_; }
+    size_t GetBodyLength() { return body_length_; }
+
+    std::string GetResponseHeader(const std::string& key) const {
+        for (auto& [name, value] : response_headers_) {
+            if (strcasecmp(name.c_str(), key.c_str()) == 0) {
+                return value;
+            }
+        }
+        return "";
+    }
+
+    int Read(char* buffer, size_t buffer_size) {
+        if (remaining_ == 0) {
+            return 0;
+        }
+        ssize_t ret = recv(fd_, buffer, std::min(buffer_size, remaining_), 0);
+        if (ret > 0) {
+            remaining_ -= ret;
+        }
+        return ret;
+    }
+
+private:
+    int fd_ = -1;
+    int status_code_ = 0;
+    size_t body_length_ = 0;
+    size_t remaining_ = 0;
+    std::map<std::string, std::string> request_headers_;
+    std::map<std::string, std::string> response_headers_;
+};
+
+class NetworkInterface {
+public:
+    std::unique_ptr<Http> CreateHttp(int) { return std::make_unique<Http>(); }
+};
+
+class Board {
+public:
+    static Board& GetInstance() {
+        static Board instance;
+        return instance;
+    }
+    NetworkInterface* GetNetwork() { return &network_; }
+
+private:
+    NetworkInterface network_;
+};
+
+#endif
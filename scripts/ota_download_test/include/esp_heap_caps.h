@@ -0,0 +1,19 @@
+// One kind of memory on the host, every capability gets the same heap
+#ifndef ESP_HEAP_CAPS_HOST_H
+#define ESP_HEAP_CAPS_HOST_H
+
+#include <cstdlib>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+inline void* heap_caps_aligned_alloc(size_t alignment, size_t size, unsigned int) {
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+inline void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+#endif
@@ -0,0 +1,107 @@
+// Queues, binary semaphores and tasks on std::thread, enough for the download and write tasks
+#ifndef FREERTOS_HOST_H
+#define FREERTOS_HOST_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* arg);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdMS_TO_TICKS(ms) (ms)
+#define portMAX_DELAY 0xffffffffu
+
+// Every wait is forever, the downloader never waits with a timeout
+struct QueueDefinition {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t item_size;
+};
+typedef QueueDefinition* QueueHandle_t;
+typedef QueueDefinition* SemaphoreHandle_t;
+
+inline QueueHandle_t xQueueCreate(size_t length, size_t item_size) {
+    auto queue = new QueueDefinition;
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+inline void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+inline BaseType_t xQueueReset(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->items.clear();
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    queue->changed.wait(lock, [queue] { return queue->items.size() < queue->length; });
+    auto bytes = (const uint8_t*)item;
+    queue->items.emplace_back(bytes, bytes + queue->item_size);
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    queue->changed.wait(lock, [queue] { return !queue->items.empty(); });
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xQueueCreate(1, 1);
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    uint8_t token = 0;
+    return xQueueSend(semaphore, &token, 0);
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t) {
+    uint8_t token;
+    return xQueueReceive(semaphore, &token, portMAX_DELAY);
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char*, uint32_t, void* arg, UBaseType_t,
+        TaskHandle_t*) {
+    std::thread(function, arg).detach();
+    return pdPASS;
+}
+
+inline UBaseType_t uxTaskPriorityGet(TaskHandle_t) {
+    return 5;
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline void vTaskDelete(TaskHandle_t) {}
+
+#endif
@@ -0,0 +1,26 @@
+// mbedtls SHA-256 on OpenSSL
+#ifndef MBEDTLS_SHA256_HOST_H
+#define MBEDTLS_SHA256_HOST_H
+
+#include <openssl/sha.h>
+
+#include <cstddef>
+
+typedef SHA256_CTX mbedtls_sha256_context;
+
+inline void mbedtls_sha256_init(mbedtls_sha256_context*) {}
+inline void mbedtls_sha256_free(mbedtls_sha256_context*) {}
+
+inline int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224) {
+    return is224 ? -1 : SHA256_Init(ctx) == 1 ? 0 : -1;
+}
+
+inline int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t length) {
+    return SHA256_Update(ctx, input, length) == 1 ? 0 : -1;
+}
+
+inline int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char output[32]) {
+    return SHA256_Final(output, ctx) == 1 ? 0 : -1;
+}
+
+#endif
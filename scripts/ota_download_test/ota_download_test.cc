@@ -0,0 +1,120 @@
+/*
+ * Downloads an image with main/ota_downloader.cc from scripts/ota_stand_in_server.py and checks
+ * that the bytes handed to the write handler are exactly the served image, in order, once.
+ *
+ * Each case gets its own server, started by run.sh with the options in the comment of the case.
+ * The expected hash is the one the server announces at firmware.sha256. When the image changes
+ * during a download, the downloader has to fail with image_changed() instead of splicing the two
+ * builds, and a second download from the start, as Ota::Upgrade() makes it, has to get the new
+ * one. Every case reports the reconnects and the throughput, including the retry delays.
+ *
+ * Usage: ./run.sh
+ */
+#include "ota_downloader.h"
+#include "board.h"
+
+#include <openssl/sha.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static int failures = 0;
+
+static void Check(bool ok, const char* name, const char* what) {
+    if (!ok) {
+        printf("FAIL: %s: %s\n", name, what);
+        failures++;
+    }
+}
+
+static std::string Sha256Hex(const std::string& data) {
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256((const unsigned char*)data.data(), data.size(), digest);
+    char hex[SHA256_DIGEST_LENGTH * 2 + 1];
+    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+        snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    }
+    return hex;
+}
+
+// The hash the server announces for the image it serves right now
+static std::string GetAnnouncedSha256(const std::string& url) {
+    Http http;
+    std::string body;
+    std::string sha256_url = url.substr(0, url.rfind('.')) + ".sha256";
+    if (http.Open("GET", sha256_url) && http.GetStatusCode() == 200) {
+        char buffer[128];
+        int ret;
+        while ((ret = http.Read(buffer, sizeof(buffer))) > 0) {
+            body.append(buffer, ret);
+        }
+    }
+    return body;
+}
+
+struct Attempt {
+    bool downloaded;
+    bool image_changed;
+    std::string written;
+    std::string sha256;
+};
+
+static Attempt Download(const std::string& url) {
+    OtaDownloader downloader;
+    Attempt attempt;
+    attempt.downloaded = downloader.Download(url, [&attempt](const uint8_t* data, size_t size) {
+        attempt.written.append((const char*)data, size);
+        return true;
+    });
+    attempt.image_changed = downloader.image_changed();
+    attempt.sha256 = downloader.GetSha256Hex();
+    Check(!attempt.downloaded || downloader.size() == attempt.written.size(), url.c_str(),
+        "size() is what was written");
+    return attempt;
+}
+
+static void Run(const char* name, const std::string& url, bool image_changes) {
+    std::string expected = GetAnnouncedSha256(url);
+    if (expected.size() != 64) {
+        Check(false, name, "no firmware.sha256 from the server");
+        return;
+    }
+    Http::opens = 0;
+    auto start = std::chrono::steady_clock::now();
+    Attempt attempt = Download(url);
+    size_t bytes = attempt.written.size();
+    if (image_changes) {
+        Check(!attempt.downloaded && attempt.image_changed, name, "the changed image ends the download");
+        std::string replaced = GetAnnouncedSha256(url);
+        Check(replaced != expected, name, "the server replaced the image");
+        expected = replaced;
+        attempt = Download(url);
+        bytes += attempt.written.size();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%-14s %8zu bytes  %2d reconnects  %6.2f s  %7.2f MB/s\n", name, bytes,
+        Http::opens - (image_changes ? 2 : 1), seconds, bytes / seconds / 1e6);
+    Check(attempt.downloaded && !attempt.image_changed, name, "downloads");
+    Check(Sha256Hex(attempt.written) == expected, name, "writes the announced image");
+    Check(attempt.sha256 == expected, name, "GetSha256Hex() is the announced hash");
+}
+
+int main(int argc, char** argv) {
+    if (argc != 5) {
+        printf("usage: %s <clean url> <drops url> <changed url> <ignore-range url>\n", argv[0]);
+        return 2;
+    }
+    // No options
+    Run("clean", argv[1], false);
+    // --drop: resumes with Range and gets 206
+    Run("drops", argv[2], false);
+    // --drop --change-after: If-Range gets 200 with the new build
+    Run("image_changed", argv[3], true);
+    // --drop --ignore-range: gets 200 with the same ETag, skips what it has
+    Run("ignore_range", argv[4], false);
+    printf(failures == 0 ? "PASS\n" : "%d checks failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
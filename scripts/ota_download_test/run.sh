@@ -0,0 +1,43 @@
+#!/bin/sh
+# Builds main/ota_downloader.cc on the host and downloads from scripts/ota_stand_in_server.py with
+# dropped connections and a replaced image, then once more under the sanitizers
+set -e
+cd "$(dirname "$0")"
+ROOT=../..
+BUILD=$(mktemp -d)
+PIDS=""
+trap 'kill $PIDS 2> /dev/null; rm -rf "$BUILD"' EXIT
+PORT=${PORT:-18080}
+# The logs are compiled out, which leaves variables only they use
+FLAGS="-std=c++17 -Wall -Wno-format -Wno-unused-variable -Wno-deprecated-declarations -Iinclude -I../host_stubs -I$ROOT/main"
+SOURCES="ota_download_test.cc $ROOT/main/ota_downloader.cc"
+${CXX:-c++} $FLAGS -O2 -o "$BUILD/test" $SOURCES -lcrypto -lpthread
+${CXX:-c++} $FLAGS -O1 -g -fsanitize=address,undefined -fno-sanitize-recover=all -o "$BUILD/test_sanitized" \
+    $SOURCES -lcrypto -lpthread
+
+# Fresh servers for every run, the replaced image only changes once
+start_server() {
+    python3 ../ota_stand_in_server.py --host 127.0.0.1 --port $1 --seed $1 $2 > "$BUILD/$1.log" &
+    PIDS="$PIDS $!"
+    until grep -q Listening "$BUILD/$1.log" 2> /dev/null; do
+        sleep 0.1
+    done
+}
+
+run() {
+    kill $PIDS 2> /dev/null || true
+    PIDS=""
+    URLS=""
+    i=0
+    for options in "" "--drop 0.03" "--drop 0.03 --change-after 1500000" "--drop 0.03 --ignore-range"; do
+        port=$((PORT + i))
+        start_server $port "--size 4194304 $options"
+        URLS="$URLS http://127.0.0.1:$port/firmware.bin"
+        i=$((i + 1))
+    done
+    "$@" $URLS
+}
+
+run "$BUILD/test"
+echo "sanitizers:"
+run "$BUILD/test_sanitized"
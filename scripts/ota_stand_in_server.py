@@ -0,0 +1,163 @@
+import argparse
+import hashlib
+import random
+import threading
+import time
+from email.utils import formatdate
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+'''
+  A stand-in for the OTA firmware server, to check how main/ota_downloader.cc resumes a download
+  over a bad link without the real backend.
+
+  It serves a random image of --size bytes at any path ending in .bin, and its SHA-256 in hex at
+  the same path ending in .sha256, like the firmware.sha256 that CheckVersion() may announce.
+  Responses carry an ETag and a Last-Modified, a Range request is answered with 206 unless an
+  If-Range names another image. After each response the bytes sent and the rate are printed:
+
+    200 0-4194303 sent=4194304 2.310s 1.82 MB/s
+
+  Options make the server misbehave the way a real one or the link to it can:
+    --drop P           cut the connection in the middle of each 64 KB with probability P
+    --rate KBPS        send at most this many KB per second
+    --change-after N   replace the image with a new build once N bytes of it were sent, and cut
+                       that connection; a resume must not splice the two builds
+    --ignore-range     always answer 200 with the whole image, like a server without ranges
+    --no-validators    send neither ETag nor Last-Modified
+
+  Only the standard library is used.
+'''
+
+CHUNK_SIZE = 64 * 1024
+
+
+class Image:
+    def __init__(self, size, seed, build):
+        self.build = build
+        self.data = random.Random(seed * 1000 + build).randbytes(size)
+        self.sha256 = hashlib.sha256(self.data).hexdigest()
+        self.etag = f'"{self.sha256[:16]}"'
+        self.last_modified = formatdate(1700000000 + build, usegmt=True)
+
+
+class State:
+    def __init__(self, args):
+        self.args = args
+        self.lock = threading.Lock()
+        self.random = random.Random(args.seed)
+        self.image = Image(args.size, args.seed, 1)
+        self.sent = 0   # Bytes of the current image sent, for --change-after
+
+    def drop(self):
+        with self.lock:
+            return self.args.drop > 0 and self.random.random() < self.args.drop
+
+    def count(self, image, length):
+        # Returns True when the image was replaced just now and the connection has to be cut
+        with self.lock:
+            if image is not self.image:
+                return False
+            self.sent += length
+            if self.args.change_after > 0 and self.sent >= self.args.change_after and image.build == 1:
+                self.image = Image(self.args.size, self.args.seed, image.build + 1)
+                self.sent = 0
+                print(f'image replaced by build {self.image.build}, sha256 {self.image.sha256}', flush=True)
+                return True
+            return False
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def log_message(self, format, *args):
+        pass
+
+    def do_GET(self):
+        state = self.server.state
+        args = state.args
+        image = state.image
+        self.close_connection = True
+        if self.path.endswith('.sha256'):
+            body = image.sha256.encode()
+            self.send_response(200)
+            self.send_header('Content-Length', str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+            return
+        if not self.path.endswith('.bin'):
+            self.send_error(404)
+            return
+
+        start = 0
+        range_header = self.headers.get('Range', '')
+        if_range = self.headers.get('If-Range')
+        if range_header.startswith('bytes=') and not args.ignore_range:
+            start = int(range_header[6:].split('-')[0])
+            if if_range is not None and if_range not in (image.etag, image.last_modified):
+                start = 0
+        if start >= len(image.data):
+            self.send_error(416)
+            return
+
+        self.send_response(206 if start > 0 else 200)
+        if start > 0:
+            self.send_header('Content-Range', f'bytes {start}-{len(image.data) - 1}/{len(image.data)}')
+        self.send_header('Content-Length', str(len(image.data) - start))
+        self.send_header('Content-Type', 'application/octet-stream')
+        if not args.no_validators:
+            self.send_header('ETag', image.etag)
+            self.send_header('Last-Modified', image.last_modified)
+        self.end_headers()
+
+        begin = time.monotonic()
+        position = start
+        try:
+            while position < len(image.data):
+                chunk = image.data[position:position + CHUNK_SIZE]
+                if state.drop():
+                    chunk = chunk[:state.random.randint(1, len(chunk) - 1)]
+                    self.wfile.write(chunk)
+                    position += len(chunk)
+                    break
+                self.wfile.write(chunk)
+                position += len(chunk)
+                if state.count(image, len(chunk)):
+                    break
+                if args.rate > 0:
+                    # Time spent blocked on a slow receiver earns no credit
+                    time.sleep(max(0, begin + (position - start) / (args.rate * 1024) - time.monotonic()))
+        except ConnectionError:
+            pass
+        elapsed = max(time.monotonic() - begin, 1e-6)
+        sent = position - start
+        print(f'{206 if start > 0 else 200} {start}-{len(image.data) - 1} sent={sent} {elapsed:.3f}s '
+              f'{sent / elapsed / 1e6:.2f} MB/s', flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Stand-in OTA server that drops connections and reports MB/s')
+    parser.add_argument('--host', default='0.0.0.0')
+    parser.add_argument('--port', type=int, default=8080)
+    parser.add_argument('--size', type=int, default=4 * 1024 * 1024, help='image size in bytes')
+    parser.add_argument('--seed', type=int, default=1, help='seed of the image contents and the drops')
+    parser.add_argument('--drop', type=float, default=0, help='chance to cut the connection per 64 KB')
+    parser.add_argument('--rate', type=float, default=0, help='send at most this many KB per second')
+    parser.add_argument('--change-after', type=int, default=0, help='replace the image after this many bytes')
+    parser.add_argument('--ignore-range', action='store_true', help='answer every request with the whole image')
+    parser.add_argument('--no-validators', action='store_true', help='send neither ETag nor Last-Modified')
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer((args.host, args.port), Handler)
+    server.daemon_threads = True
+    server.state = State(args)
+    print(f'Listening on http://{args.host}:{args.port}/firmware.bin, sha256 {server.state.image.sha256}',
+          flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,267 @@
+/*
+ * Runs main/audio/playback_dsp.cc over generated speech, clicks and full-scale tones and compares
+ * the output frame by frame with the golden files, bit exact.
+ *
+ * The input is generated with integer arithmetic only, so it is the same on every host. Each
+ * golden line holds one 60 ms output frame: its peak, its mean absolute level, the loudness gain
+ * after it and a CRC32 of its samples. On top of the golden comparison every case checks that the
+ * limiter holds the ceiling, and the speech cases check the level they settle at.
+ *
+ * Usage: ./run.sh [--update]   --update rewrites the golden files from the current output
+ */
+#include "playback_dsp.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FRAME_DURATION_MS 60
+#define CLICK_LENGTH 48
+
+#if CONFIG_PLAYBACK_LOUDNESS_NORMALIZATION
+#define GOLDEN_DIR "golden/normalized"
+#else
+#define GOLDEN_DIR "golden/limiter_only"
+#endif
+
+static int failures = 0;
+
+static void Check(bool ok, const std::string& name, const char* what) {
+    if (!ok) {
+        printf("FAIL: %s: %s\n", name.c_str(), what);
+        failures++;
+    }
+}
+
+static uint32_t Crc32(const int16_t* samples, size_t count) {
+    uint32_t crc = 0xFFFFFFFF;
+    auto bytes = (const uint8_t*)samples;
+    for (size_t i = 0; i < count * sizeof(int16_t); i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+// A voiced sawtooth at 180 Hz through a one-pole low-pass, shaped into 250 ms syllables with a
+// pause after every third one. Peaks reach about amplitude.
+class SpeechGenerator {
+public:
+    SpeechGenerator(int sample_rate, int amplitude) : sample_rate_(sample_rate), amplitude_(amplitude) {}
+
+    int16_t Next() {
+        phase_ = (phase_ + 180 * 65536 / sample_rate_) & 0xFFFF;
+        int32_t saw = (int32_t)phase_ - 32768;
+        filtered_ += (saw - filtered_) / 4;
+
+        int syllable_samples = sample_rate_ / 4;
+        int syllable = position_ / syllable_samples;
+        int32_t in_syllable = position_ % syllable_samples;
+        position_++;
+        if (syllable % 4 == 3) {
+            return 0;
+        }
+        // Triangle envelope over the syllable, in Q15
+        int32_t envelope = std::min(in_syllable, syllable_samples - in_syllable) * 65536 / syllable_samples;
+        return (int16_t)((int64_t)filtered_ * amplitude_ / 32768 * envelope / 32768);
+    }
+
+private:
+    int sample_rate_;
+    int amplitude_;
+    uint32_t phase_ = 0;
+    int32_t filtered_ = 0;
+    int32_t position_ = 0;
+};
+
+struct Case {
+    std::string name;
+    int sample_rate;
+    int duration_ms;
+    // Fills the input, frame by frame, and may reset the DSP between frames
+    std::function<void(PlaybackDsp& dsp, int frame, std::vector<int16_t>& pcm)> input;
+    bool check_level;   // Whether the last second has to settle at the target level
+};
+
+static std::vector<Case> Cases() {
+    std::vector<Case> cases;
+    for (int amplitude : {1500, 5000, 20000}) {
+        auto generator = std::make_shared<SpeechGenerator>(24000, amplitude);
+        cases.push_back({"speech_" + std::to_string(amplitude), 24000, 4000,
+            [generator](PlaybackDsp&, int, std::vector<int16_t>& pcm) {
+                for (auto& sample : pcm) {
+                    sample = generator->Next();
+                }
+            }, true});
+    }
+
+    auto speech_16k = std::make_shared<SpeechGenerator>(16000, 5000);
+    cases.push_back({"speech_5000_16k", 16000, 2000, [speech_16k](PlaybackDsp&, int, std::vector<int16_t>& pcm) {
+        for (auto& sample : pcm) {
+            sample = speech_16k->Next();
+        }
+    }, true});
+
+    // A full-scale click after a second of silence, the limiter has to be down before it is played
+    cases.push_back({"click_after_silence", 24000, 2000, [](PlaybackDsp&, int frame, std::vector<int16_t>& pcm) {
+        std::fill(pcm.begin(), pcm.end(), 0);
+        if (frame == 1000 / FRAME_DURATION_MS) {
+            for (int i = 0; i < CLICK_LENGTH; i++) {
+                pcm[100 + i] = i % 2 == 0 ? INT16_MAX : INT16_MIN;
+            }
+        }
+    }, false});
+
+    // A full-scale square wave keeps the limiter engaged the whole time
+    cases.push_back({"full_scale_square", 24000, 1000, [](PlaybackDsp&, int frame, std::vector<int16_t>& pcm) {
+        for (size_t i = 0; i < pcm.size(); i++) {
+            pcm[i] = ((frame * pcm.size() + i) / 60) % 2 == 0 ? INT16_MAX : INT16_MIN;
+        }
+    }, false});
+
+    // A loud answer, then the decoder is reset and a quiet one follows with the loudness kept
+    auto loud = std::make_shared<SpeechGenerator>(24000, 20000);
+    auto quiet = std::make_shared<SpeechGenerator>(24000, 3000);
+    cases.push_back({"reset_between_answers", 24000, 3000,
+        [loud, quiet](PlaybackDsp& dsp, int frame, std::vector<int16_t>& pcm) {
+            int reset_frame = 1500 / FRAME_DURATION_MS;
+            if (frame == reset_frame) {
+                dsp.Reset();
+            }
+            for (auto& sample : pcm) {
+                sample = frame < reset_frame ? loud->Next() : quiet->Next();
+            }
+        }, false});
+    return cases;
+}
+
+static std::vector<std::string> ReadLines(const std::string& path) {
+    std::vector<std::string> lines;
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return lines;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        lines.push_back(line);
+    }
+    fclose(file);
+    return lines;
+}
+
+static void Run(const Case& c, bool update) {
+    PlaybackDsp dsp;
+    dsp.Configure(c.sample_rate);
+    size_t frame_samples = c.sample_rate / 1000 * FRAME_DURATION_MS;
+    int frames = c.duration_ms / FRAME_DURATION_MS;
+    int settle_from = frames - 1000 / FRAME_DURATION_MS;
+
+    std::vector<std::string> output;
+    output.push_back("# frame peak mean gain crc32\n");
+    std::vector<int16_t> pcm(frame_samples);
+    int32_t max_peak = 0;
+    int64_t input_sum = 0;
+    int64_t settled_sum = 0;
+    int settled_frames = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        pcm.resize(frame_samples);
+        c.input(dsp, frame, pcm);
+        int64_t frame_input_sum = 0;
+        for (int16_t sample : pcm) {
+            frame_input_sum += std::abs((int32_t)sample);
+        }
+        dsp.Process(pcm);
+
+        int32_t peak = 0;
+        int64_t sum = 0;
+        for (int16_t sample : pcm) {
+            peak = std::max(peak, std::abs((int32_t)sample));
+            sum += std::abs((int32_t)sample);
+        }
+        int32_t mean = sum / pcm.size();
+        max_peak = std::max(max_peak, peak);
+        if (frame >= settle_from && mean >= PLAYBACK_DSP_GATE_LEVEL) {
+            input_sum += frame_input_sum / (int64_t)pcm.size();
+            settled_sum += mean;
+            settled_frames++;
+        }
+        char line[128];
+        snprintf(line, sizeof(line), "%d %d %d %d %08x\n", frame, peak, mean, dsp.gain(),
+            Crc32(pcm.data(), pcm.size()));
+        output.push_back(line);
+    }
+
+    int32_t settled_level = settled_frames > 0 ? settled_sum / settled_frames : 0;
+    printf("%-24s peak %5d  settled level %5d  gain %5d\n", c.name.c_str(), max_peak, settled_level, dsp.gain());
+    Check(max_peak <= PLAYBACK_DSP_CEILING, c.name, "peaks are held below the ceiling");
+#if CONFIG_PLAYBACK_LOUDNESS_NORMALIZATION
+    if (c.check_level) {
+        // A voice too quiet for the highest gain stays below the target
+        int32_t input_level = settled_frames > 0 ? input_sum / settled_frames : 0;
+        int32_t expected = std::min<int32_t>(PLAYBACK_DSP_TARGET_LEVEL,
+            input_level * PLAYBACK_DSP_MAX_GAIN / PLAYBACK_DSP_UNITY);
+        Check(std::abs(settled_level - expected) <= expected / 10, c.name,
+            "settles within 10% of the target level");
+    }
+#endif
+
+    std::string path = std::string(GOLDEN_DIR) + "/" + c.name + ".txt";
+    if (update) {
+        FILE* file = fopen(path.c_str(), "w");
+        for (auto& line : output) {
+            fputs(line.c_str(), file);
+        }
+        fclose(file);
+        return;
+    }
+    auto golden = ReadLines(path);
+    if (golden.empty()) {
+        Check(false, c.name, "golden file missing, run with --update");
+        return;
+    }
+    for (size_t i = 0; i < std::max(golden.size(), output.size()); i++) {
+        if (i >= golden.size() || i >= output.size() || golden[i] != output[i]) {
+            printf("  expected: %s  actual:   %s", i < golden.size() ? golden[i].c_str() : "(end)\n",
+                i < output.size() ? output[i].c_str() : "(end)\n");
+            Check(false, c.name, "output differs from the golden file");
+            break;
+        }
+    }
+}
+
+// The limiter delays the output by two blocks, an impulse comes out exactly that much later
+static void CheckDelay() {
+    for (int sample_rate : {16000, 24000, 48000}) {
+        PlaybackDsp dsp;
+        dsp.Configure(sample_rate);
+        std::vector<int16_t> pcm(sample_rate / 1000 * FRAME_DURATION_MS, 0);
+        pcm[10] = 1000;
+        dsp.Process(pcm);
+        size_t expected = 10 + 2 * (sample_rate * PLAYBACK_DSP_BLOCK_MS / 1000);
+        auto it = std::find_if(pcm.begin(), pcm.end(), [](int16_t sample) { return sample != 0; });
+        Check(it != pcm.end() && (size_t)(it - pcm.begin()) == expected, std::to_string(sample_rate) + " Hz",
+            "delay is two limiter blocks");
+    }
+}
+
+int main(int argc, char** argv) {
+    bool update = argc > 1 && strcmp(argv[1], "--update") == 0;
+    printf("%s\n", GOLDEN_DIR);
+    CheckDelay();
+    for (auto& c : Cases()) {
+        Run(c, update);
+    }
+    if (failures == 0) {
+        printf(update ? "updated\n" : "PASS\n");
+    } else {
+        printf("%d checks failed\n", failures);
+    }
+    return failures == 0 ? 0 : 1;
+}
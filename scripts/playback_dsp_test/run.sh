@@ -0,0 +1,20 @@
+#!/bin/sh
+# Builds main/audio/playback_dsp.cc with and without CONFIG_PLAYBACK_LOUDNESS_NORMALIZATION and
+# compares both with their golden files, the normalized build also under the sanitizers
+set -e
+cd "$(dirname "$0")"
+ROOT=../..
+BUILD=$(mktemp -d)
+trap 'rm -rf "$BUILD"' EXIT
+FLAGS="-std=c++17 -Wall -Wno-format -I../host_stubs -I$ROOT/main/audio"
+SOURCES="playback_dsp_test.cc $ROOT/main/audio/playback_dsp.cc"
+${CXX:-c++} $FLAGS -O2 -DCONFIG_PLAYBACK_LOUDNESS_NORMALIZATION=1 -o "$BUILD/normalized" $SOURCES
+${CXX:-c++} $FLAGS -O2 -o "$BUILD/limiter_only" $SOURCES
+${CXX:-c++} $FLAGS -O1 -g -fsanitize=address,undefined -fno-sanitize-recover=all \
+    -DCONFIG_PLAYBACK_LOUDNESS_NORMALIZATION=1 -o "$BUILD/normalized_sanitized" $SOURCES
+mkdir -p golden/normalized golden/limiter_only
+"$BUILD/normalized" "$@"
+"$BUILD/limiter_only" "$@"
+if [ "$1" != "--update" ]; then
+    "$BUILD/normalized_sanitized" > /dev/null
+fi
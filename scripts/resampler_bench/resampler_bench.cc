@@ -0,0 +1,223 @@
+// Cycles per output sample and in-band SNR of main/audio/polyphase_resampler.cc for the rate pairs the
+// boards use, fed 60 ms frames like AudioService.
+//
+// SNR is measured per test tone by a least-squares fit of the tone to the output, everything
+// left over is noise, distortion and images. The reported figures are the worst tone up to
+// 3.4 kHz (voice) and up to 85% of the lower Nyquist frequency (band).
+//
+// "old" rows time the data movement ReadAudioData and the decode task did before commit
+// 90e0dba: de-interleave the mic and the reference into temporaries, resample each with its own
+// resampler into new vectors and re-interleave, or resample into a separate buffer and copy it
+// back. They use PolyphaseResampler as the per-channel resampler, the libopus SILK resampler the
+// firmware used then is internal to libopus and not available to a host build.
+//
+//   ./run.sh [frames]
+
+#include "polyphase_resampler.h"
+#include "heap_counter.h"
+
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define FRAME_DURATION_MS 60
+
+struct RatePair {
+    int input_rate;
+    int output_rate;
+    int channels;
+    const char* use;
+};
+
+static const RatePair kRatePairs[] = {
+    {24000, 16000, 1, "mic"},
+    {24000, 16000, 2, "mic + ref"},
+    {44100, 16000, 2, "mic + ref"},
+    {48000, 16000, 1, "mic"},
+    {48000, 16000, 2, "mic + ref"},
+    {16000, 24000, 1, "playback"},
+    {16000, 44100, 1, "playback"},
+    {16000, 48000, 1, "playback"},
+    {24000, 48000, 1, "playback"},
+};
+
+static int16_t ToPcm(double value) {
+    return (int16_t)std::lround(std::clamp(value, -32768.0, 32767.0));
+}
+
+// Worst SNR over tones spread up to band_edge, every channel gets its own tone
+static double MeasureSnr(const RatePair& pair, double band_edge) {
+    double worst = 1e9;
+    for (double frequency = 100; frequency <= band_edge; frequency += band_edge / 12) {
+        PolyphaseResampler resampler;
+        resampler.Configure(pair.input_rate, pair.output_rate, pair.channels);
+        size_t frame_frames = pair.input_rate / 1000 * FRAME_DURATION_MS;
+        std::vector<std::vector<double>> output(pair.channels);
+        std::vector<int16_t> frame(frame_frames * pair.channels);
+        size_t position = 0;
+        for (int f = 0; f < 20; f++) {
+            for (size_t i = 0; i < frame_frames; i++, position++) {
+                for (int c = 0; c < pair.channels; c++) {
+                    double tone = frequency * (1.0 + 0.1 * c);
+                    double phase = 2 * M_PI * tone * position / pair.input_rate;
+                    frame[i * pair.channels + c] = ToPcm(16000 * std::sin(phase));
+                }
+            }
+            std::vector<int16_t> data = frame;
+            resampler.Process(data);
+            for (size_t i = 0; i < data.size(); i++) {
+                output[i % pair.channels].push_back(data[i]);
+            }
+        }
+
+        for (int c = 0; c < pair.channels; c++) {
+            // Skip the filter's start-up, then fit a * sin + b * cos + dc at the output rate
+            double tone = frequency * (1.0 + 0.1 * c);
+            if (tone > band_edge) {
+                continue;
+            }
+            auto& y = output[c];
+            size_t start = pair.output_rate / 10;
+            double s[3][3] = {}, r[3] = {};
+            for (size_t n = start; n < y.size(); n++) {
+                double w = 2 * M_PI * tone * n / pair.output_rate;
+                double basis[3] = {std::sin(w), std::cos(w), 1.0};
+                for (int i = 0; i < 3; i++) {
+                    r[i] += basis[i] * y[n];
+                    for (int j = 0; j < 3; j++) {
+                        s[i][j] += basis[i] * basis[j];
+                    }
+                }
+            }
+            // Solve the 3x3 normal equations by Cramer's rule
+            auto det = [](double m[3][3]) {
+                return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                    m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                    m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+            };
+            double d = det(s);
+            double coefficient[3];
+            for (int k = 0; k < 3; k++) {
+                double m[3][3];
+                for (int i = 0; i < 3; i++) {
+                    for (int j = 0; j < 3; j++) {
+                        m[i][j] = (j == k) ? r[i] : s[i][j];
+                    }
+                }
+                coefficient[k] = det(m) / d;
+            }
+            double signal = 0, noise = 0;
+            for (size_t n = start; n < y.size(); n++) {
+                double w = 2 * M_PI * tone * n / pair.output_rate;
+                double fit = coefficient[0] * std::sin(w) + coefficient[1] * std::cos(w) + coefficient[2];
+                signal += (fit - coefficient[2]) * (fit - coefficient[2]);
+                noise += (y[n] - fit) * (y[n] - fit);
+            }
+            worst = std::min(worst, 10 * std::log10(signal / std::max(noise, 1e-9)));
+        }
+    }
+    return worst;
+}
+
+struct Timing {
+    double cycles_per_sample;
+    double allocations_per_frame;
+};
+
+template <typename Step>
+static Timing Time(const RatePair& pair, int frames, Step step) {
+    size_t frame_samples = pair.input_rate / 1000 * FRAME_DURATION_MS * pair.channels;
+    std::vector<int16_t> input(frame_samples);
+    for (size_t i = 0; i < input.size(); i++) {
+        input[i] = ToPcm(8000 * std::sin(i * 0.05) + 4000 * std::sin(i * 0.31));
+    }
+    std::vector<int16_t> data;
+    data.reserve(frame_samples * 4);
+    std::vector<double> cycles_per_sample;
+    cycles_per_sample.reserve(frames);
+    uint64_t allocations = 0;
+    for (int f = 0; f < frames + 10; f++) {
+        // Read into the same buffer every frame, as ReadAudioData and the pooled tasks do
+        data.assign(input.begin(), input.end());
+        uint64_t allocations_before = HeapCounter::allocations().load();
+        uint64_t start = __rdtsc();
+        step(data);
+        uint64_t end = __rdtsc();
+        // The first frames warm up the buffers
+        if (f >= 10) {
+            cycles_per_sample.push_back((double)(end - start) / data.size());
+            allocations += HeapCounter::allocations().load() - allocations_before;
+        }
+    }
+    // The median frame, so a preempted frame on a busy host does not skew it
+    std::nth_element(cycles_per_sample.begin(), cycles_per_sample.begin() + frames / 2, cycles_per_sample.end());
+    return {cycles_per_sample[frames / 2], (double)allocations / frames};
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 2000;
+    printf("%-6s %-6s %-10s %14s %8s %8s %8s %11s\n", "in", "out", "use", "cycles/sample", "old", "SNR dB",
+        "band", "old allocs");
+    for (auto& pair : kRatePairs) {
+        PolyphaseResampler current;
+        current.Configure(pair.input_rate, pair.output_rate, pair.channels);
+        Timing now = Time(pair, frames, [&](std::vector<int16_t>& data) {
+            current.Process(data);
+        });
+
+        Timing old;
+        std::vector<PolyphaseResampler> per_channel(pair.channels);
+        for (auto& resampler : per_channel) {
+            resampler.Configure(pair.input_rate, pair.output_rate, 1);
+        }
+        if (pair.channels == 2) {
+            old = Time(pair, frames, [&](std::vector<int16_t>& data) {
+                auto mic_channel = std::vector<int16_t>(data.size() / 2);
+                auto reference_channel = std::vector<int16_t>(data.size() / 2);
+                for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
+                    mic_channel[i] = data[j];
+                    reference_channel[i] = data[j + 1];
+                }
+                auto resampled_mic = std::vector<int16_t>(per_channel[0].GetOutputSamples(mic_channel.size()));
+                auto resampled_reference = std::vector<int16_t>(
+                    per_channel[1].GetOutputSamples(reference_channel.size()));
+                per_channel[0].Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
+                per_channel[1].Process(reference_channel.data(), reference_channel.size(),
+                    resampled_reference.data());
+                data.resize(resampled_mic.size() + resampled_reference.size());
+                for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
+                    data[j] = resampled_mic[i];
+                    data[j + 1] = resampled_reference[i];
+                }
+            });
+        } else if (pair.input_rate < pair.output_rate) {
+            std::vector<int16_t> output_resample_buffer;
+            old = Time(pair, frames, [&](std::vector<int16_t>& data) {
+                int target_size = per_channel[0].GetOutputSamples(data.size());
+                output_resample_buffer.resize(target_size);
+                per_channel[0].Process(data.data(), data.size(), output_resample_buffer.data());
+                data.assign(output_resample_buffer.begin(), output_resample_buffer.end());
+            });
+        } else {
+            old = Time(pair, frames, [&](std::vector<int16_t>& data) {
+                auto resampled = std::vector<int16_t>(per_channel[0].GetOutputSamples(data.size()));
+                per_channel[0].Process(data.data(), data.size(), resampled.data());
+                data = std::move(resampled);
+            });
+        }
+
+        double band_edge = 0.85 * 0.5 * std::min(pair.input_rate, pair.output_rate);
+        printf("%-6d %-6d %-10s %14.1f %8.1f %8.1f %8.1f %11.1f\n", pair.input_rate, pair.output_rate, pair.use,
+            now.cycles_per_sample, old.cycles_per_sample, MeasureSnr(pair, 3400), MeasureSnr(pair, band_edge),
+            old.allocations_per_frame);
+        if (now.allocations_per_frame != 0) {
+            printf("FAIL: %.1f allocations per frame\n", now.allocations_per_frame);
+            return 1;
+        }
+    }
+    return 0;
+}
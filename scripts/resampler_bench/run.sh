@@ -0,0 +1,10 @@
+#!/bin/sh
+# Builds the benchmark against main/audio/polyphase_resampler.cc and runs it
+set -e
+cd "$(dirname "$0")"
+ROOT=../..
+BUILD=$(mktemp -d)
+trap 'rm -rf "$BUILD"' EXIT
+${CXX:-c++} -std=c++17 -O2 -Wall -Wno-format -I../host_stubs -I$ROOT/main/audio \
+    -o "$BUILD/resampler_bench" resampler_bench.cc $ROOT/main/audio/polyphase_resampler.cc
+"$BUILD/resampler_bench" "$@"
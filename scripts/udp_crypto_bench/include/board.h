@@ -0,0 +1,29 @@
+#ifndef BOARD_HOST_H
+#define BOARD_HOST_H
+
+#include <memory>
+#include <string>
+
+#include "mqtt.h"
+#include "udp.h"
+
+class NetworkInterface {
+public:
+    std::unique_ptr<Mqtt> CreateMqtt(int) { return std::make_unique<Mqtt>(); }
+    std::unique_ptr<Udp> CreateUdp(int) { return std::make_unique<Udp>(); }
+};
+
+class Board {
+public:
+    static Board& GetInstance() {
+        static Board instance;
+        return instance;
+    }
+    NetworkInterface* GetNetwork() { return &network_; }
+    std::string GetUuid() { return "host"; }
+
+private:
+    NetworkInterface network_;
+};
+
+#endif
@@ -0,0 +1,51 @@
+// mbedtls AES-CTR on OpenSSL's block cipher, with the same counter and stream block handling as
+// mbedtls_aes_crypt_ctr(): one block encrypt per 16 bytes and a big-endian counter increment.
+// The firmware runs the same loop on the AES peripheral when CONFIG_MBEDTLS_HARDWARE_AES is set.
+#ifndef MBEDTLS_AES_HOST_H
+#define MBEDTLS_AES_HOST_H
+
+#include <openssl/aes.h>
+
+#include <cstddef>
+#include <cstring>
+
+typedef struct {
+    AES_KEY key;
+} mbedtls_aes_context;
+
+inline void mbedtls_aes_init(mbedtls_aes_context* ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+inline void mbedtls_aes_free(mbedtls_aes_context* ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+inline int mbedtls_aes_setkey_enc(mbedtls_aes_context* ctx, const unsigned char* key, unsigned int keybits) {
+    return AES_set_encrypt_key(key, keybits, &ctx->key) == 0 ? 0 : -0x0020;
+}
+
+inline int mbedtls_aes_crypt_ctr(mbedtls_aes_context* ctx, size_t length, size_t* nc_off,
+        unsigned char nonce_counter[16], unsigned char stream_block[16], const unsigned char* input,
+        unsigned char* output) {
+    size_t n = *nc_off;
+    if (n > 0x0F) {
+        return -0x0021;
+    }
+    while (length--) {
+        if (n == 0) {
+            AES_encrypt(nonce_counter, stream_block, &ctx->key);
+            for (int i = 16; i > 0; i--) {
+                if (++nonce_counter[i - 1] != 0) {
+                    break;
+                }
+            }
+        }
+        *output++ = *input++ ^ stream_block[n];
+        n = (n + 1) & 0x0F;
+    }
+    *nc_off = n;
+    return 0;
+}
+
+#endif
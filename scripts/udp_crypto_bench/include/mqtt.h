@@ -0,0 +1,42 @@
+// A connected MQTT client whose server answers the hello with the UDP key and nonce at once
+#ifndef MQTT_HOST_H
+#define MQTT_HOST_H
+
+#include <cstring>
+#include <functional>
+#include <string>
+
+// AES-128 key and the nonce template, type 0x01 first
+#define MQTT_HOST_KEY "000102030405060708090A0B0C0D0E0F"
+#define MQTT_HOST_NONCE "01000000A5A5A5A50000000000000000"
+
+class Mqtt {
+public:
+    void SetKeepAlive(int) {}
+    void OnConnected(std::function<void()> callback) {}
+    void OnDisconnected(std::function<void()> callback) {}
+    void OnMessage(std::function<void(const std::string&, const std::string&)> callback) {
+        on_message_ = callback;
+    }
+    bool Connect(const std::string&, int, const std::string&, const std::string&, const std::string&) {
+        connected_ = true;
+        return true;
+    }
+    bool IsConnected() { return connected_; }
+
+    bool Publish(const std::string& topic, const std::string& payload) {
+        if (strstr(payload.c_str(), "\"hello\"") != nullptr) {
+            on_message_("server-device", "{\"type\":\"hello\",\"transport\":\"udp\",\"session_id\":\"bench\","
+                "\"audio_params\":{\"sample_rate\":16000,\"frame_duration\":60},"
+                "\"udp\":{\"server\":\"host\",\"port\":8884,\"key\":\"" MQTT_HOST_KEY "\","
+                "\"nonce\":\"" MQTT_HOST_NONCE "\"}}");
+        }
+        return true;
+    }
+
+private:
+    bool connected_ = false;
+    std::function<void(const std::string&, const std::string&)> on_message_;
+};
+
+#endif
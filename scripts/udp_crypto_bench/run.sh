@@ -0,0 +1,29 @@
+#!/bin/sh
+# Builds the benchmark against the current main/protocols/mqtt_protocol.cc and against the one before
+# the reused crypto buffers and the replay window (or the given commit), and prints the cost per frame
+set -e
+cd "$(dirname "$0")"
+ROOT=$(cd ../.. && pwd)
+BASE=${1:-ec0fca3^}
+BUILD=$(mktemp -d)
+trap 'rm -rf "$BUILD"' EXIT
+# Copied out of main/, so their quoted includes find the stubs and not the firmware headers
+FILES="protocol.h protocol.cc mqtt_protocol.h mqtt_protocol.cc"
+mkdir -p "$BUILD/base" "$BUILD/current"
+for file in $FILES; do
+    git -C "$ROOT" show "$BASE:main/protocols/$file" > "$BUILD/base/$file"
+    cp "$ROOT/main/protocols/$file" "$BUILD/current/"
+done
+
+FLAGS="-std=c++17 -O2 -w -Iinclude -I../host_stubs"
+# Headers the copied files include but did not change
+INCLUDES="-I$ROOT/main -I$ROOT/main/audio -I$ROOT/main/protocols"
+for variant in base current; do
+    SRC="$BUILD/$variant"
+    ${CXX:-c++} $FLAGS -I"$SRC" $INCLUDES -o "$BUILD/bench_$variant" udp_crypto_bench.cc "$SRC/protocol.cc" \
+        "$SRC/mqtt_protocol.cc" $ROOT/main/protocols/control_message.cc ../host_stubs/cJSON.cc -lcrypto
+done
+echo "before ($(git -C "$ROOT" rev-parse --short "$BASE")):"
+"$BUILD/bench_base" || true
+echo "current:"
+"$BUILD/bench_current"
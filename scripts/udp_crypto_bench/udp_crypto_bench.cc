@@ -0,0 +1,240 @@
+// Throughput of the MQTT + UDP audio path in MqttProtocol: SendAudio() encrypts 60 ms Opus frames
+// with AES-128-CTR, the UDP receive callback runs the replay window and decrypts into pooled
+// packets. Prints frames per second, microseconds and heap allocations per frame, then feeds
+// reordered, duplicated, late and replayed datagrams through the receive path and counts what gets
+// through. AES runs on OpenSSL's software block cipher here, so the absolute figures are for
+// comparing builds, not a prediction for the AES peripheral. The block cipher dominates the time
+// per frame on the host, what the reused buffers save shows up in the allocs column.
+//
+//   ./run.sh [base commit]
+
+#include "mqtt_protocol.h"
+#include "heap_counter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define FRAMES 20000
+#define ROUNDS 5
+// Late datagrams are held back from the first ones, so all of them have later ones to overtake
+#define LATE_MARGIN 200
+// 60 ms of 16 kHz speech at the bitrates the encoder tuner picks
+static const size_t kPayloadSizes[] = {60, 120, 240};
+
+static int failures = 0;
+
+static void Check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static uint8_t PayloadByte(uint32_t frame, size_t index) {
+    return (uint8_t)(frame * 7 + index * 13);
+}
+
+struct Result {
+    double ns_per_frame = 1e18;
+    double allocations_per_frame = 0;
+};
+
+struct Received {
+    int accepted = 0;
+    int corrupted = 0;
+};
+
+static void PrintResult(const char* direction, size_t payload_size, const Result& result) {
+    printf("%-8s %-8zu %12.0f %12.2f %12.2f\n", direction, payload_size, 1e9 / result.ns_per_frame,
+        result.ns_per_frame / 1000, result.allocations_per_frame);
+}
+
+// A new channel starts over with sequence 1 on both sides
+static void Reopen(MqttProtocol& protocol) {
+    protocol.CloseAudioChannel();
+    if (!protocol.OpenAudioChannel()) {
+        printf("FAIL: could not open the audio channel\n");
+        exit(1);
+    }
+}
+
+static Result TimeSend(MqttProtocol& protocol, size_t payload_size) {
+    // Packets come from the pool and go back to it, their payloads keep their capacity
+    {
+        auto packet = GetAudioStreamPacketPool().Acquire();
+        packet->payload.resize(payload_size);
+    }
+
+    Result result;
+    for (int round = 0; round < ROUNDS; round++) {
+        uint64_t allocations = HeapCounter::allocations().load();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < FRAMES; i++) {
+            auto packet = GetAudioStreamPacketPool().Acquire();
+            packet->payload.resize(payload_size);
+            packet->payload[i % payload_size] = i;
+            packet->timestamp = i;
+            protocol.SendAudio(std::move(packet));
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        result.ns_per_frame = std::min(result.ns_per_frame, ns / FRAMES);
+        result.allocations_per_frame = (double)(HeapCounter::allocations().load() - allocations) / FRAMES;
+    }
+    return result;
+}
+
+// The datagrams of a FRAMES long stream, sequence 1 first, payloads the receiver can check
+static std::vector<std::string> CaptureStream(MqttProtocol& protocol, size_t payload_size) {
+    Reopen(protocol);
+    std::vector<std::string> datagrams;
+    datagrams.reserve(FRAMES);
+    Udp::capture = &datagrams;
+    for (int i = 0; i < FRAMES; i++) {
+        auto packet = GetAudioStreamPacketPool().Acquire();
+        packet->payload.resize(payload_size);
+        for (size_t j = 0; j < payload_size; j++) {
+            packet->payload[j] = PayloadByte(i, j);
+        }
+        packet->timestamp = i;
+        protocol.SendAudio(std::move(packet));
+    }
+    Udp::capture = nullptr;
+    return datagrams;
+}
+
+// Delivers the datagrams in the given order on a fresh channel. Each one is copied into the receive
+// buffer first, as lwIP hands over a new one per datagram.
+static Received Deliver(MqttProtocol& protocol, const std::vector<std::string>& datagrams,
+        const std::vector<int>& order) {
+    Reopen(protocol);
+    static std::string buffer;
+    buffer.reserve(datagrams[0].size() + 16);
+    Received received;
+    protocol.OnIncomingAudio([&received](AudioStreamPacketPtr packet) {
+        received.accepted++;
+        for (size_t j = 0; j < packet->payload.size(); j++) {
+            if (packet->payload[j] != PayloadByte(packet->timestamp, j)) {
+                received.corrupted++;
+                break;
+            }
+        }
+    });
+    for (int index : order) {
+        buffer.assign(datagrams[index]);
+        Udp::current->Deliver(buffer);
+    }
+    return received;
+}
+
+static Result TimeReceive(MqttProtocol& protocol, const std::vector<std::string>& datagrams) {
+    std::vector<int> order(datagrams.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    // The pool is warm after the capture, its packets come back as soon as the callback returns
+    Result result;
+    for (int round = 0; round < ROUNDS; round++) {
+        uint64_t allocations = HeapCounter::allocations().load();
+        auto start = std::chrono::steady_clock::now();
+        Received received = Deliver(protocol, datagrams, order);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        // Reopening the channel allocates, so allocations are counted over the whole round
+        result.ns_per_frame = std::min(result.ns_per_frame, ns / FRAMES);
+        result.allocations_per_frame = (double)(HeapCounter::allocations().load() - allocations) / FRAMES;
+        Check(received.accepted == FRAMES && received.corrupted == 0, "in order datagrams decrypt");
+    }
+    return result;
+}
+
+// Every tenth datagram arrives delay datagrams late
+static std::vector<int> Late(int delay) {
+    std::vector<std::pair<int, int>> keyed;
+    for (int i = 0; i < FRAMES; i++) {
+        bool late = i % 10 == 5 && i < FRAMES - LATE_MARGIN;
+        keyed.push_back({late ? i + delay : i, i});
+    }
+    std::stable_sort(keyed.begin(), keyed.end());
+    std::vector<int> order;
+    for (auto& [key, index] : keyed) {
+        order.push_back(index);
+    }
+    return order;
+}
+
+static int LateCount() {
+    int count = 0;
+    for (int i = 0; i < FRAMES; i++) {
+        count += i % 10 == 5 && i < FRAMES - LATE_MARGIN;
+    }
+    return count;
+}
+
+static void RunReplayScenarios(MqttProtocol& protocol, const std::vector<std::string>& datagrams) {
+    std::vector<int> in_order, swapped, duplicated, replayed;
+    for (int i = 0; i < FRAMES; i++) {
+        in_order.push_back(i);
+        swapped.push_back(i ^ 1);
+        duplicated.push_back(i);
+        duplicated.push_back(i);
+        replayed.push_back(i);
+    }
+    replayed.insert(replayed.end(), in_order.begin(), in_order.end());
+
+#ifdef MQTT_REPLAY_WINDOW_SIZE
+    static_assert(MQTT_REPLAY_WINDOW_SIZE > 32 && MQTT_REPLAY_WINDOW_SIZE < 100, "late delays straddle the window");
+    int late_dropped = LateCount();
+    int duplicates_accepted = 0;
+#else
+    // Without a replay window everything is accepted
+    int late_dropped = 0;
+    int duplicates_accepted = FRAMES;
+#endif
+    struct Scenario {
+        const char* name;
+        std::vector<int> order;
+        int expected;
+    } scenarios[] = {
+        {"in order", in_order, FRAMES},
+        {"pairs swapped", swapped, FRAMES},
+        {"late by 32", Late(32), FRAMES},
+        {"late by 100", Late(100), FRAMES - late_dropped},
+        {"duplicated", duplicated, FRAMES + duplicates_accepted},
+        {"replayed", replayed, FRAMES + duplicates_accepted},
+    };
+
+    printf("%-14s %10s %10s %10s %10s\n", "datagrams", "delivered", "accepted", "expected", "corrupted");
+    for (auto& scenario : scenarios) {
+        Received received = Deliver(protocol, datagrams, scenario.order);
+        printf("%-14s %10zu %10d %10d %10d\n", scenario.name, scenario.order.size(), received.accepted,
+            scenario.expected, received.corrupted);
+        Check(received.accepted == scenario.expected, scenario.name);
+        Check(received.corrupted == 0, "accepted datagrams decrypt");
+    }
+}
+
+int main() {
+    MqttProtocol protocol;
+    protocol.Start();
+    if (!protocol.OpenAudioChannel()) {
+        printf("FAIL: could not open the audio channel\n");
+        return 1;
+    }
+
+    printf("%-8s %-8s %12s %12s %12s\n", "path", "payload", "frames/s", "us/frame", "allocs");
+    std::vector<std::string> datagrams;
+    for (size_t payload_size : kPayloadSizes) {
+        Result send = TimeSend(protocol, payload_size);
+        PrintResult("send", payload_size, send);
+        datagrams = CaptureStream(protocol, payload_size);
+        Result receive = TimeReceive(protocol, datagrams);
+        PrintResult("receive", payload_size, receive);
+    }
+    printf("\n");
+    RunReplayScenarios(protocol, datagrams);
+
+    printf(failures == 0 ? "PASS\n" : "%d checks failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+/*
+ * Writes corpus.txt: 60 s of synthetic utterances for vad_bench, from a fixed seed.
+ *
+ * Utterances of one to eight syllables are separated by pauses of 0.3 to 2.5 s. A syllable is
+ * voiced (a pitched vowel) or a fricative (hiss, like "s" or "f"), with short gaps between
+ * syllables inside an utterance. Each utterance has its own level, spread over 12 dB.
+ *
+ * Format, times in ms:
+ *   u <start> <end>                               an utterance, the span labelled as speech
+ *   v <start> <duration> <pitch Hz> <level>       a voiced syllable
+ *   f <start> <duration> 0 <level>                a fricative
+ * Levels are mean absolute sample values.
+ */
+#include <cstdint>
+#include <cstdio>
+
+#define CORPUS_MS 60000
+#define LEAD_IN_MS 1000     // Noise only, the VAD learns the floor
+
+static uint32_t g_seed = 0x0fad0fad;
+
+static uint32_t Random(uint32_t low, uint32_t high) {
+    g_seed = g_seed * 1664525u + 1013904223u;
+    return low + (g_seed >> 8) % (high - low + 1);
+}
+
+int main() {
+    printf("# 16000 Hz, %d ms, generated by generate.cc\n", CORPUS_MS);
+    uint32_t time = LEAD_IN_MS;
+    while (true) {
+        int syllables = Random(1, 8);
+        // 1000 to 4000, about 12 dB
+        uint32_t level = Random(1000, 4000);
+        uint32_t pitch = Random(90, 260);
+
+        char lines[8][64];
+        uint32_t position = time;
+        uint32_t end = time;
+        for (int i = 0; i < syllables; i++) {
+            bool fricative = Random(0, 3) == 0;
+            uint32_t duration = fricative ? Random(60, 150) : Random(120, 300);
+            if (fricative) {
+                snprintf(lines[i], sizeof(lines[i]), "f %u %u 0 %u", position, duration, level / 2);
+            } else {
+                // The pitch drifts over the utterance
+                pitch = pitch * Random(90, 110) / 100;
+                snprintf(lines[i], sizeof(lines[i]), "v %u %u %u %u", position, duration, pitch, level);
+            }
+            end = position + duration;
+            position = end + Random(0, 60);
+        }
+        if (end + 300 > CORPUS_MS) {
+            break;
+        }
+        printf("u %u %u\n", time, end);
+        for (int i = 0; i < syllables; i++) {
+            printf("%s\n", lines[i]);
+        }
+        time = end + Random(300, 2500);
+    }
+    return 0;
+}
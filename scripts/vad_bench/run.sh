@@ -0,0 +1,17 @@
+#!/bin/sh
+# Rebuilds corpus.txt with generate.cc, fails if the committed copy is out of date, then runs
+# main/audio/processors/energy_vad.cc over it
+set -e
+cd "$(dirname "$0")"
+ROOT=../..
+BUILD=$(mktemp -d)
+trap 'rm -rf "$BUILD"' EXIT
+${CXX:-c++} -std=c++17 -O2 -Wall -o "$BUILD/generate" generate.cc
+${CXX:-c++} -std=c++17 -O2 -Wall -I$ROOT/main/audio/processors -o "$BUILD/vad_bench" vad_bench.cc \
+    $ROOT/main/audio/processors/energy_vad.cc
+"$BUILD/generate" > "$BUILD/corpus.txt"
+if [ "$1" = "--update" ]; then
+    cp "$BUILD/corpus.txt" corpus.txt
+fi
+diff -u corpus.txt "$BUILD/corpus.txt"
+"$BUILD/vad_bench" corpus.txt
@@ -0,0 +1,233 @@
+/*
+ * Accuracy and cost of main/audio/processors/energy_vad.cc on the utterances of corpus.txt, mixed
+ * with white noise at several SNRs and fed in 60 ms frames at 16 kHz like NoAudioProcessor does.
+ *
+ * Voiced syllables are a sawtooth at their pitch through two one-pole low-passes, fricatives are
+ * differentiated white noise, both with 20 ms ramps. The SNR is the mean power of the utterances
+ * over the mean power of the noise. A frame is labelled speech when most of it lies inside an
+ * utterance.
+ *
+ * recall       speech frames the VAD reports as speaking
+ * false alarm  frames outside the utterances it reports as speaking, not counting
+ *              ENERGY_VAD_HANGOVER_MS after an utterance, which the hangover keeps on by design
+ * onset        mean delay from the start of an utterance to speaking, in frames
+ * missed       utterances during which it never reports speaking
+ *
+ * Usage: ./run.sh [--update]   --update rewrites corpus.txt from generate.cc
+ */
+#include "energy_vad.h"
+
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define SAMPLE_RATE 16000
+#define FRAME_DURATION_MS 60
+#define FRAME_SAMPLES (SAMPLE_RATE / 1000 * FRAME_DURATION_MS)
+#define RAMP_SAMPLES (SAMPLE_RATE / 1000 * 20)
+
+struct Utterance {
+    int start;
+    int end;
+};
+
+struct Corpus {
+    std::vector<int16_t> speech;
+    std::vector<Utterance> utterances;    // In samples
+};
+
+static uint32_t g_seed;
+
+static int32_t Noise() {
+    g_seed = g_seed * 1664525u + 1013904223u;
+    return (int32_t)(g_seed >> 16) - 32768;
+}
+
+static bool LoadCorpus(const char* path, Corpus& corpus) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    int duration_ms = 0;
+    char line[128];
+    if (fgets(line, sizeof(line), file) == nullptr || sscanf(line, "# 16000 Hz, %d ms", &duration_ms) != 1) {
+        fclose(file);
+        return false;
+    }
+    corpus.speech.assign(duration_ms * (SAMPLE_RATE / 1000), 0);
+    g_seed = 0xf41ca7e5;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char kind;
+        int start, end, duration, pitch, level;
+        if (sscanf(line, "u %d %d", &start, &end) == 2) {
+            corpus.utterances.push_back({start * (SAMPLE_RATE / 1000), end * (SAMPLE_RATE / 1000)});
+            continue;
+        }
+        if (sscanf(line, "%c %d %d %d %d", &kind, &start, &duration, &pitch, &level) != 5) {
+            continue;
+        }
+        int first = start * (SAMPLE_RATE / 1000);
+        int count = duration * (SAMPLE_RATE / 1000);
+        uint32_t phase = 0;
+        int32_t low1 = 0, low2 = 0, last = 0;
+        for (int i = 0; i < count; i++) {
+            int32_t sample;
+            if (kind == 'v') {
+                phase = (phase + pitch * 65536 / SAMPLE_RATE) & 0xFFFF;
+                low1 += ((int32_t)phase - 32768 - low1) / 3;
+                low2 += (low1 - low2) / 3;
+                sample = low2;
+            } else {
+                int32_t noise = Noise();
+                sample = (noise - last) / 2;
+                last = noise;
+            }
+            // The waveforms have a mean absolute value of about 11000, scale that to the level
+            int32_t ramp = std::min({i, count - 1 - i, RAMP_SAMPLES});
+            sample = (int64_t)sample * level / 11000 * ramp / RAMP_SAMPLES;
+            corpus.speech[first + i] = std::clamp<int32_t>(sample, INT16_MIN, INT16_MAX);
+        }
+    }
+    fclose(file);
+    return !corpus.utterances.empty();
+}
+
+static double MeanPower(const std::vector<int16_t>& pcm, const std::vector<Utterance>& spans) {
+    double sum = 0;
+    size_t count = 0;
+    for (auto& span : spans) {
+        for (int i = span.start; i < span.end; i++) {
+            sum += (double)pcm[i] * pcm[i];
+        }
+        count += span.end - span.start;
+    }
+    return sum / count;
+}
+
+struct Result {
+    double recall;
+    double false_alarm;
+    double onset_frames;
+    int missed;
+    double ns_per_sample;
+    double cycles_per_sample;
+};
+
+static Result Run(const Corpus& corpus, double snr_db) {
+    // Uniform noise in [-a, a] has a power of a * a / 3
+    std::vector<int16_t> mixed = corpus.speech;
+    if (snr_db < 1000) {
+        double noise_power = MeanPower(corpus.speech, corpus.utterances) / std::pow(10.0, snr_db / 10);
+        int32_t amplitude = std::lround(std::sqrt(3 * noise_power));
+        g_seed = 0x7e57da7a;
+        for (auto& sample : mixed) {
+            int32_t noise = (int64_t)Noise() * amplitude / 32768;
+            sample = std::clamp<int32_t>(sample + noise, INT16_MIN, INT16_MAX);
+        }
+    }
+
+    size_t frames = mixed.size() / FRAME_SAMPLES;
+    // Frames partly inside an utterance or in its hangover count neither way
+    std::vector<bool> speech(frames, false), excluded(frames, false);
+    int hangover_frames = ENERGY_VAD_HANGOVER_MS / FRAME_DURATION_MS + 1;
+    for (auto& u : corpus.utterances) {
+        for (size_t f = 0; f < frames; f++) {
+            int begin = f * FRAME_SAMPLES;
+            int inside = std::min<int>(begin + FRAME_SAMPLES, u.end) - std::max(begin, u.start);
+            if (inside * 2 > FRAME_SAMPLES) {
+                speech[f] = true;
+            } else if (inside > 0) {
+                excluded[f] = true;
+            }
+        }
+        size_t end_frame = u.end / FRAME_SAMPLES;
+        for (size_t f = end_frame; f < std::min(frames, end_frame + hangover_frames); f++) {
+            excluded[f] = true;
+        }
+    }
+
+    EnergyVad vad;
+    std::vector<bool> speaking(frames);
+    std::vector<double> ns, cycles;
+    for (size_t f = 0; f < frames; f++) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t start_cycles = __rdtsc();
+        vad.Process(&mixed[f * FRAME_SAMPLES], FRAME_SAMPLES, FRAME_DURATION_MS);
+        uint64_t end_cycles = __rdtsc();
+        ns.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+        cycles.push_back(end_cycles - start_cycles);
+        speaking[f] = vad.speaking();
+    }
+
+    int speech_frames = 0, hits = 0, other_frames = 0, alarms = 0;
+    for (size_t f = 0; f < frames; f++) {
+        if (speech[f]) {
+            speech_frames++;
+            hits += speaking[f];
+        } else if (!excluded[f]) {
+            other_frames++;
+            alarms += speaking[f];
+        }
+    }
+    // Utterances the VAD never picks up, and how late it picks up the others
+    int missed = 0, detected = 0;
+    double onset_sum = 0;
+    for (auto& u : corpus.utterances) {
+        size_t first = u.start / FRAME_SAMPLES;
+        size_t last = std::min(frames, (size_t)u.end / FRAME_SAMPLES + 1);
+        size_t f = first;
+        while (f < last && !speaking[f]) {
+            f++;
+        }
+        if (f == last) {
+            missed++;
+        } else {
+            detected++;
+            onset_sum += f - first;
+        }
+    }
+
+    std::nth_element(ns.begin(), ns.begin() + frames / 2, ns.end());
+    std::nth_element(cycles.begin(), cycles.begin() + frames / 2, cycles.end());
+    return {100.0 * hits / speech_frames, 100.0 * alarms / other_frames, detected > 0 ? onset_sum / detected : 0,
+        missed, ns[frames / 2] / FRAME_SAMPLES, cycles[frames / 2] / FRAME_SAMPLES};
+}
+
+int main(int argc, char** argv) {
+    Corpus corpus;
+    const char* path = argc > 1 ? argv[1] : "corpus.txt";
+    if (!LoadCorpus(path, corpus)) {
+        printf("FAIL: cannot read %s\n", path);
+        return 1;
+    }
+    int speech_samples = 0;
+    for (auto& u : corpus.utterances) {
+        speech_samples += u.end - u.start;
+    }
+    printf("%zu utterances, %.1f s of speech in %.1f s\n", corpus.utterances.size(),
+        (double)speech_samples / SAMPLE_RATE, (double)corpus.speech.size() / SAMPLE_RATE);
+
+    printf("%-8s %8s %12s %8s %7s %10s %14s\n", "SNR dB", "recall %", "false alarm %", "onset", "missed",
+        "ns/sample", "cycles/sample");
+    int failures = 0;
+    for (double snr_db : {1e9, 30.0, 20.0, 10.0, 5.0}) {
+        Result result = Run(corpus, snr_db);
+        char snr[16];
+        snprintf(snr, sizeof(snr), snr_db < 1000 ? "%.0f" : "clean", snr_db);
+        printf("%-8s %8.1f %12.1f %8.2f %7d %10.2f %14.1f\n", snr, result.recall, result.false_alarm,
+            result.onset_frames, result.missed, result.ns_per_sample, result.cycles_per_sample);
+        // What the VAD did when this benchmark was committed, with some slack
+        double min_recall = snr_db >= 30 ? 99 : snr_db >= 20 ? 90 : 0;
+        if (result.recall < min_recall || result.false_alarm > 1) {
+            printf("FAIL: recall below %.0f%% or false alarms above 1%%\n", min_recall);
+            failures++;
+        }
+    }
+    printf(failures == 0 ? "PASS\n" : "%d checks failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
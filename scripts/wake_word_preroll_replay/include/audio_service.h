@@ -0,0 +1,7 @@
+// Only the frame duration of the firmware audio service
+#ifndef AUDIO_SERVICE_HOST_H
+#define AUDIO_SERVICE_HOST_H
+
+#define OPUS_FRAME_DURATION_MS 60
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef ESP_HEAP_CAPS_HOST_H
+#define ESP_HEAP_CAPS_HOST_H
+
+#include <cstdlib>
+
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+inline void* heap_caps_malloc(size_t size, int) {
+    return malloc(size);
+}
+
+inline void heap_caps_free(void* pointer) {
+    free(pointer);
+}
+
+#endif
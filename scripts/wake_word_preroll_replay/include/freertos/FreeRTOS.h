@@ -0,0 +1,57 @@
+// FreeRTOS tasks and notifications on std::thread, enough for WakeWordPreroll
+#ifndef FREERTOS_HOST_H
+#define FREERTOS_HOST_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+typedef int StackType_t;
+struct StaticTask_t {};
+
+#define portMAX_DELAY 0xffffffffu
+#define pdTRUE 1
+
+struct HostTask {
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t notifications = 0;
+};
+typedef HostTask* TaskHandle_t;
+
+inline HostTask*& CurrentHostTask() {
+    static thread_local HostTask* task = nullptr;
+    return task;
+}
+
+// The thread is detached and the task never deleted, the program exits with it still running
+inline TaskHandle_t xTaskCreateStatic(void (*function)(void*), const char*, int, void* arg, int, StackType_t*,
+        StaticTask_t*) {
+    auto task = new HostTask;
+    std::thread([=]() {
+        CurrentHostTask() = task;
+        function(arg);
+    }).detach();
+    return task;
+}
+
+inline void xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+    task->cv.notify_one();
+}
+
+inline uint32_t ulTaskNotifyTake(int, uint32_t) {
+    HostTask* task = CurrentHostTask();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    task->cv.wait(lock, [task]() { return task->notifications > 0; });
+    uint32_t notifications = task->notifications;
+    task->notifications = 0;
+    return notifications;
+}
+
+inline void vTaskDelete(void*) {
+}
+
+#endif
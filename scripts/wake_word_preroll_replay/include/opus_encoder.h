@@ -0,0 +1,37 @@
+// Stands in for the esp-opus-encoder wrapper. Like it, Encode() works on the pcm buffer in place
+// and leaves it with the caller. Each packet carries the first sample of its frame, and encoding
+// takes encode_us of busy time to model the device.
+#ifndef OPUS_ENCODER_HOST_H
+#define OPUS_ENCODER_HOST_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class OpusEncoderWrapper {
+public:
+    static inline int encode_us = 0;
+
+    OpusEncoderWrapper(int sample_rate, int channels, int duration_ms)
+        : frame_size_(sample_rate / 1000 * channels * duration_ms) {}
+
+    void SetComplexity(int) {}
+
+    bool Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus) {
+        if ((int)pcm.size() != frame_size_) {
+            return false;
+        }
+        auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(encode_us);
+        while (std::chrono::steady_clock::now() < end) {
+        }
+        opus.resize(sizeof(int16_t));
+        memcpy(opus.data(), pcm.data(), sizeof(int16_t));
+        return true;
+    }
+
+private:
+    int frame_size_;
+};
+
+#endif
@@ -0,0 +1,10 @@
+#!/bin/sh
+# Builds the replay against main/audio/wake_words/wake_word_preroll.cc and runs it
+set -e
+cd "$(dirname "$0")"
+ROOT=../..
+BUILD=$(mktemp -d)
+trap 'rm -rf "$BUILD"' EXIT
+${CXX:-c++} -std=c++17 -O2 -Wall -pthread -Iinclude -I../host_stubs -I$ROOT/main/audio/wake_words \
+    -o "$BUILD/wake_word_preroll_replay" wake_word_preroll_replay.cc $ROOT/main/audio/wake_words/wake_word_preroll.cc
+"$BUILD/wake_word_preroll_replay" "$@"
@@ -0,0 +1,141 @@
+// Replays microphone input into WakeWordPreroll in real time and measures the delay from the wake
+// word to the first and the last pre-roll packet. Every sample holds the number of its Opus frame,
+// so the packets show which frames made it into the pre-roll.
+//
+//   ./run.sh [--encode-us N] [--wake-ms N]
+
+#include "wake_word_preroll.h"
+#include "audio_service.h"
+#include "heap_counter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#define CHUNK_SAMPLES 512  // What the AFE hands to the wake word per fetch, 32 ms
+#define FRAME_SAMPLES (WAKE_WORD_PREROLL_SAMPLE_RATE / 1000 * OPUS_FRAME_DURATION_MS)
+#define PREROLL_PACKETS (WAKE_WORD_PREROLL_DURATION_MS / OPUS_FRAME_DURATION_MS)
+
+static int failures = 0;
+
+static void Check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static double MsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Feeds duration_ms of input from sample position, paced like the microphone
+static void FeedRealTime(WakeWordPreroll& preroll, uint32_t& position, int duration_ms) {
+    static int16_t chunk[CHUNK_SAMPLES];
+    auto next = std::chrono::steady_clock::now();
+    uint32_t end = position + duration_ms * (WAKE_WORD_PREROLL_SAMPLE_RATE / 1000);
+    while (position < end) {
+        // The chunk is handed over once it has been recorded, the wake word fires right after that
+        next += std::chrono::microseconds(CHUNK_SAMPLES * 1000000LL / WAKE_WORD_PREROLL_SAMPLE_RATE);
+        std::this_thread::sleep_until(next);
+        for (auto& sample : chunk) {
+            sample = (int16_t)(position++ / FRAME_SAMPLES);
+        }
+        preroll.Feed(chunk, CHUNK_SAMPLES);
+    }
+}
+
+// Flushes at the wake word and checks that the packets are the last complete frames fed
+static void Wake(WakeWordPreroll& preroll, uint32_t start, uint32_t position, int encode_us) {
+    auto wake_time = std::chrono::steady_clock::now();
+    preroll.Flush();
+
+    std::vector<uint8_t> opus;
+    std::vector<int> frames;
+    double first_ms = -1;
+    while (preroll.GetPacket(opus)) {
+        if (first_ms < 0) {
+            first_ms = MsSince(wake_time);
+        }
+        int16_t frame;
+        memcpy(&frame, opus.data(), sizeof(frame));
+        frames.push_back(frame);
+    }
+    double last_ms = MsSince(wake_time);
+
+    // Frames are cut from where the pre-roll started, the trailing partial frame is dropped
+    int complete_frames = (position - start) / FRAME_SAMPLES;
+    int expected = std::min(complete_frames, PREROLL_PACKETS);
+    int last_frame = (start + (complete_frames - 1) * FRAME_SAMPLES) / FRAME_SAMPLES;
+    printf("  %zu packets, wake to first packet %.2f ms, to last %.2f ms\n", frames.size(), first_ms, last_ms);
+    printf("  the encoder before the pre-roll took %d ms to encode them all after the wake word\n",
+        expected * encode_us / 1000);
+
+    Check((int)frames.size() == expected, "packet count");
+    bool consecutive = !frames.empty() && frames.back() == last_frame;
+    for (size_t i = 1; i < frames.size(); i++) {
+        consecutive = consecutive && frames[i] == frames[i - 1] + 1;
+    }
+    Check(consecutive, "packets are the last frames before the wake word, in order");
+    // At most the frame completed by the last chunk is left to encode after the wake word
+    Check(first_ms < 2.0 * encode_us / 1000 + 20, "first packet within two frame encodes");
+}
+
+int main(int argc, char** argv) {
+    int encode_us = 6000;
+    int wake_ms = 2500;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--encode-us") == 0) {
+            encode_us = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--wake-ms") == 0) {
+            wake_ms = atoi(argv[i + 1]);
+        }
+    }
+    OpusEncoderWrapper::encode_us = encode_us;
+
+    // Never deleted, its encode task keeps running until the program exits
+    auto preroll = new WakeWordPreroll();
+    Check(preroll->Initialize(), "initialize");
+
+    uint32_t position = 0;
+    printf("wake word after %d ms of input, %d us per frame encode\n", wake_ms, encode_us);
+    int warmup_ms = std::min(wake_ms, WAKE_WORD_PREROLL_DURATION_MS + 200);
+    FeedRealTime(*preroll, position, warmup_ms);
+    // Once the packet ring is full, rolling on reuses its buffers and the frame buffer
+    uint64_t allocations = HeapCounter::allocations().load();
+    FeedRealTime(*preroll, position, wake_ms - warmup_ms);
+    uint64_t rolling_allocations = HeapCounter::allocations().load() - allocations;
+    printf("  %llu allocations while rolling for %d ms\n", (unsigned long long)rolling_allocations,
+        wake_ms - warmup_ms);
+    Check(rolling_allocations == 0, "no allocations while rolling");
+    Wake(*preroll, 0, position, encode_us);
+
+    // Detection runs again, the next pre-roll starts with the next input
+    printf("wake word again 1000 ms later\n");
+    uint32_t start = position;
+    FeedRealTime(*preroll, position, 1000);
+    Wake(*preroll, start, position, encode_us);
+
+    // Without a flush, GetPacket() gives up instead of blocking the caller
+    printf("no flush\n");
+    FeedRealTime(*preroll, position, 200);
+    std::vector<uint8_t> opus;
+    auto get_time = std::chrono::steady_clock::now();
+    bool got = preroll->GetPacket(opus);
+    double waited_ms = MsSince(get_time);
+    printf("  GetPacket() returned %s after %.0f ms\n", got ? "a packet" : "none", waited_ms);
+    Check(!got && waited_ms >= WAKE_WORD_PREROLL_FLUSH_TIMEOUT_MS &&
+        waited_ms < WAKE_WORD_PREROLL_FLUSH_TIMEOUT_MS + 200, "GetPacket() times out without a flush");
+
+    if (failures == 0) {
+        printf("PASS\n");
+    } else {
+        printf("%d checks failed\n", failures);
+    }
+    fflush(stdout);
+    _Exit(failures == 0 ? 0 : 1);
+}
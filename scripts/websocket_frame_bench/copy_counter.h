@@ -0,0 +1,43 @@
+// Counts the bytes every memcpy / memmove / memset call of the program writes, including those
+// of libstdc++. Build the code under test with -fno-builtin so its copies are calls. Include it
+// in exactly one translation unit.
+#ifndef COPY_COUNTER_H
+#define COPY_COUNTER_H
+
+#include <dlfcn.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+struct CopyCounter {
+    static std::atomic<uint64_t>& bytes() {
+        static std::atomic<uint64_t> count{0};
+        return count;
+    }
+};
+
+template <typename F>
+static F NextSymbol(const char* name) {
+    return reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+}
+
+extern "C" void* memcpy(void* destination, const void* source, size_t size) {
+    static auto next = NextSymbol<void* (*)(void*, const void*, size_t)>("memcpy");
+    CopyCounter::bytes().fetch_add(size, std::memory_order_relaxed);
+    return next(destination, source, size);
+}
+
+extern "C" void* memmove(void* destination, const void* source, size_t size) {
+    static auto next = NextSymbol<void* (*)(void*, const void*, size_t)>("memmove");
+    CopyCounter::bytes().fetch_add(size, std::memory_order_relaxed);
+    return next(destination, source, size);
+}
+
+extern "C" void* memset(void* destination, int value, size_t size) {
+    static auto next = NextSymbol<void* (*)(void*, int, size_t)>("memset");
+    CopyCounter::bytes().fetch_add(size, std::memory_order_relaxed);
+    return next(destination, value, size);
+}
+
+#endif
@@ -0,0 +1,26 @@
+// Only what websocket_protocol.cc calls, scheduled tasks run at once
+#ifndef APPLICATION_HOST_H
+#define APPLICATION_HOST_H
+
+#define OPUS_FRAME_DURATION_MS 60
+
+class Application {
+public:
+    static Application& GetInstance() {
+        static Application instance;
+        return instance;
+    }
+
+    template <typename F>
+    void Schedule(F&& callback, int priority = 0) { callback(); }
+
+    struct AudioServiceStub {
+        int GetEncoderComplexity() const { return 0; }
+    };
+    AudioServiceStub& GetAudioService() { return audio_service_; }
+
+private:
+    AudioServiceStub audio_service_;
+};
+
+#endif
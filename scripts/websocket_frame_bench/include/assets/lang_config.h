@@ -0,0 +1,12 @@
+#ifndef LANG_CONFIG_HOST_H
+#define LANG_CONFIG_HOST_H
+
+namespace Lang {
+namespace Strings {
+constexpr const char* SERVER_TIMEOUT = "SERVER_TIMEOUT";
+constexpr const char* SERVER_NOT_CONNECTED = "SERVER_NOT_CONNECTED";
+constexpr const char* SERVER_ERROR = "SERVER_ERROR";
+}
+}
+
+#endif
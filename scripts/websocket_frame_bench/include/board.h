@@ -0,0 +1,27 @@
+#ifndef BOARD_HOST_H
+#define BOARD_HOST_H
+
+#include <memory>
+#include <string>
+
+#include "web_socket.h"
+
+class NetworkInterface {
+public:
+    std::unique_ptr<WebSocket> CreateWebSocket(int) { return std::make_unique<WebSocket>(); }
+};
+
+class Board {
+public:
+    static Board& GetInstance() {
+        static Board instance;
+        return instance;
+    }
+    NetworkInterface* GetNetwork() { return &network_; }
+    std::string GetUuid() { return "host"; }
+
+private:
+    NetworkInterface network_;
+};
+
+#endif
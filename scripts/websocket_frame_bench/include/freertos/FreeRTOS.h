@@ -0,0 +1,15 @@
+#ifndef FREERTOS_HOST_H
+#define FREERTOS_HOST_H
+
+#include <cstdint>
+
+typedef uint32_t EventBits_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdMS_TO_TICKS(ms) (ms)
+#define portMAX_DELAY 0xffffffffu
+
+#endif
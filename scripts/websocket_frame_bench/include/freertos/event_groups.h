@@ -0,0 +1,52 @@
+// Event groups on a mutex and a condition variable, ticks are milliseconds
+#ifndef EVENT_GROUPS_HOST_H
+#define EVENT_GROUPS_HOST_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "FreeRTOS.h"
+
+struct HostEventGroup {
+    std::mutex mutex;
+    std::condition_variable cv;
+    EventBits_t bits = 0;
+};
+typedef HostEventGroup* EventGroupHandle_t;
+
+inline EventGroupHandle_t xEventGroupCreate() {
+    return new HostEventGroup();
+}
+
+inline void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+inline EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->cv.notify_all();
+    return group->bits;
+}
+
+inline EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear,
+        BaseType_t all, TickType_t timeout) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto done = [&]() { return all ? (group->bits & bits) == bits : (group->bits & bits) != 0; };
+    group->cv.wait_for(lock, std::chrono::milliseconds(timeout), done);
+    EventBits_t result = group->bits;
+    if (done() && clear) {
+        group->bits &= ~bits;
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,20 @@
+// The protocol version comes from Settings::version, set by the benchmark
+#ifndef SETTINGS_HOST_H
+#define SETTINGS_HOST_H
+
+#include <string>
+
+class Settings {
+public:
+    static inline int version = 1;
+
+    Settings(const std::string&, bool = false) {}
+    std::string GetString(const std::string& key, const std::string& default_value = "") {
+        return key == "url" ? "ws://host/" : default_value;
+    }
+    int GetInt(const std::string& key, int default_value = 0) {
+        return key == "version" ? version : default_value;
+    }
+};
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef SYSTEM_INFO_HOST_H
+#define SYSTEM_INFO_HOST_H
+
+#include <string>
+
+class SystemInfo {
+public:
+    static std::string GetMacAddress() { return "00:00:00:00:00:00"; }
+};
+
+#endif
@@ -0,0 +1,51 @@
+// A connected WebSocket that answers the hello at once and only counts what is sent
+#ifndef WEB_SOCKET_HOST_H
+#define WEB_SOCKET_HOST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+
+class WebSocket {
+public:
+    static inline uint64_t frames_sent = 0;
+    static inline uint64_t bytes_sent = 0;
+    static inline uint32_t checksum = 0;
+
+    void SetHeader(const char*, const char*) {}
+    void OnData(std::function<void(const char*, size_t, bool)> callback) { on_data_ = callback; }
+    void OnDisconnected(std::function<void()> callback) {}
+    bool IsConnected() const { return connected_; }
+    bool Connect(const char*) {
+        connected_ = true;
+        return true;
+    }
+
+    bool Send(const std::string& text) {
+        if (strstr(text.c_str(), "\"hello\"") != nullptr) {
+            static const char hello[] = "{\"type\":\"hello\",\"transport\":\"websocket\",\"session_id\":\"bench\","
+                "\"audio_params\":{\"sample_rate\":16000,\"frame_duration\":60}}";
+            on_data_(hello, sizeof(hello) - 1, false);
+        }
+        return true;
+    }
+
+    // The network component copies the frame into its TLS record, touch every byte like it would
+    bool Send(const void* data, size_t size, bool binary) {
+        auto bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            checksum = checksum * 31 + bytes[i];
+        }
+        frames_sent++;
+        bytes_sent += size;
+        return true;
+    }
+
+private:
+    bool connected_ = false;
+    std::function<void(const char*, size_t, bool)> on_data_;
+};
+
+#endif
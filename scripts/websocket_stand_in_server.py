@@ -0,0 +1,200 @@
+import argparse
+import asyncio
+import base64
+import hashlib
+import json
+import struct
+import uuid
+
+
+'''
+  A stand-in for the websocket chat server, to check the persistent connection of
+  main/protocols/websocket_protocol.cc without the real backend (see docs/websocket.md).
+
+  Point the device (or a host build of the protocol) to ws://<host>:<port>/ and open a few
+  conversations. Every websocket handshake, session hello and keepalive ping is counted, and the
+  counts are printed after each change:
+
+    connections=1 sessions=3 pings=2
+
+  With the persistent feature, one connection carries every session until it is idle for the
+  protocol timeout. Options make the server misbehave the way a real one can:
+    --greet N          send a sentence_start and N audio frames when a session opens
+    --server-goodbye S end each session from the server after S seconds
+    --late-frames      after each goodbye, send a "tts start" and an audio frame that belong
+                       to no session; the device must drop them and stay idle
+    --blackhole        after each goodbye, ignore everything on the connection but keep it open,
+                       like a NAT that dropped it silently; the device must not wait long for
+                       its next hello or keepalive ping before connecting again
+
+  Only the standard library is used.
+'''
+
+GUID = '258EAFA5-E914-47DA-95CA-C5AB0DC85B11'
+
+
+class Stats:
+    def __init__(self):
+        self.connections = 0
+        self.sessions = 0
+        self.pings = 0
+
+    def print(self):
+        print(f'connections={self.connections} sessions={self.sessions} pings={self.pings}', flush=True)
+
+
+async def read_frame(reader):
+    head = await reader.readexactly(2)
+    opcode = head[0] & 0x0F
+    length = head[1] & 0x7F
+    if length == 126:
+        length = struct.unpack('>H', await reader.readexactly(2))[0]
+    elif length == 127:
+        length = struct.unpack('>Q', await reader.readexactly(8))[0]
+    mask = await reader.readexactly(4) if head[1] & 0x80 else b'\0\0\0\0'
+    payload = bytearray(await reader.readexactly(length))
+    for i in range(length):
+        payload[i] ^= mask[i & 3]
+    return opcode, bytes(payload)
+
+
+def frame(opcode, payload):
+    if len(payload) < 126:
+        head = struct.pack('>BB', 0x80 | opcode, len(payload))
+    elif len(payload) < 65536:
+        head = struct.pack('>BBH', 0x80 | opcode, 126, len(payload))
+    else:
+        head = struct.pack('>BBQ', 0x80 | opcode, 127, len(payload))
+    return head + payload
+
+
+def audio_frame(version):
+    # An Opus silence frame, with the header of the binary protocol version
+    payload = b'\xf8\xff\xfe'
+    if version == 2:
+        return struct.pack('>HHIII', 2, 0, 0, 0, len(payload)) + payload
+    if version == 3:
+        return struct.pack('>BBH', 0, 0, len(payload)) + payload
+    return payload
+
+
+class Connection:
+    def __init__(self, args, stats, reader, writer, version):
+        self.args = args
+        self.stats = stats
+        self.reader = reader
+        self.writer = writer
+        self.version = version
+        self.session_id = None
+        self.goodbye_task = None
+        self.blackholed = False
+
+    async def send_json(self, message):
+        self.writer.write(frame(1, json.dumps(message).encode()))
+        await self.writer.drain()
+
+    async def send_audio(self):
+        self.writer.write(frame(2, audio_frame(self.version)))
+        await self.writer.drain()
+
+    async def send_late_frames(self):
+        if self.args.late_frames:
+            await self.send_json({'session_id': self.session_id, 'type': 'tts', 'state': 'start'})
+            await self.send_audio()
+
+    async def open_session(self, hello):
+        self.session_id = uuid.uuid4().hex[:8]
+        self.stats.sessions += 1
+        self.stats.print()
+        persistent = hello.get('features', {}).get('persistent', False) and not self.args.no_persistent
+        await self.send_json({
+            'type': 'hello',
+            'transport': 'websocket',
+            'session_id': self.session_id,
+            'features': {'persistent': persistent},
+            'audio_params': {'format': 'opus', 'sample_rate': 24000, 'channels': 1, 'frame_duration': 60},
+        })
+        if self.args.greet > 0:
+            await self.send_json({'session_id': self.session_id, 'type': 'tts', 'state': 'sentence_start', 'text': 'hello'})
+            for _ in range(self.args.greet):
+                await self.send_audio()
+        if self.args.server_goodbye > 0:
+            self.goodbye_task = asyncio.create_task(self.server_goodbye(self.session_id))
+
+    async def server_goodbye(self, session_id):
+        await asyncio.sleep(self.args.server_goodbye)
+        if self.session_id == session_id:
+            await self.send_json({'session_id': session_id, 'type': 'goodbye'})
+            await self.end_session()
+
+    async def end_session(self):
+        await self.send_late_frames()
+        self.session_id = None
+        self.blackholed = self.args.blackhole
+
+    async def run(self):
+        while True:
+            opcode, payload = await read_frame(self.reader)
+            if opcode == 8:
+                return
+            if opcode != 1 or self.blackholed:
+                continue
+            message = json.loads(payload)
+            if message.get('type') == 'hello':
+                await self.open_session(message)
+            elif message.get('type') == 'goodbye':
+                await self.end_session()
+            elif message.get('type') == 'ping':
+                self.stats.pings += 1
+                self.stats.print()
+                await self.send_json({'type': 'pong'})
+
+
+async def handle(args, stats, reader, writer):
+    request = await reader.readuntil(b'\r\n\r\n')
+    headers = {}
+    for line in request.decode().split('\r\n')[1:]:
+        if ':' in line:
+            key, value = line.split(':', 1)
+            headers[key.strip().lower()] = value.strip()
+    accept = base64.b64encode(hashlib.sha1((headers['sec-websocket-key'] + GUID).encode()).digest()).decode()
+    writer.write(('HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n'
+                  f'Sec-WebSocket-Accept: {accept}\r\n\r\n').encode())
+    await writer.drain()
+
+    stats.connections += 1
+    stats.print()
+    connection = Connection(args, stats, reader, writer, int(headers.get('protocol-version', '1')))
+    try:
+        await connection.run()
+    except (asyncio.IncompleteReadError, ConnectionError):
+        pass
+    finally:
+        if connection.goodbye_task is not None:
+            connection.goodbye_task.cancel()
+        writer.close()
+
+
+async def main():
+    parser = argparse.ArgumentParser(description='Stand-in websocket chat server that counts handshakes')
+    parser.add_argument('--host', default='0.0.0.0')
+    parser.add_argument('--port', type=int, default=8765)
+    parser.add_argument('--no-persistent', action='store_true', help='answer like a server without the persistent feature')
+    parser.add_argument('--greet', type=int, default=0, help='audio frames sent when a session opens')
+    parser.add_argument('--server-goodbye', type=float, default=0, help='end each session after this many seconds')
+    parser.add_argument('--late-frames', action='store_true', help='send a tts start and audio after each goodbye')
+    parser.add_argument('--blackhole', action='store_true', help='stop answering on the connection after each goodbye')
+    args = parser.parse_args()
+
+    stats = Stats()
+    server = await asyncio.start_server(lambda r, w: handle(args, stats, r, w), args.host, args.port)
+    print(f'Listening on ws://{args.host}:{args.port}/', flush=True)
+    async with server:
+        await server.serve_forever()
+
+
+if __name__ == '__main__':
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass